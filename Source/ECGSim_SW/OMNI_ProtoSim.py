@@ -31,7 +31,7 @@ except Exception:
 
 import serial.tools.list_ports
 
-from ecg_uart_uploader import ECGUARTUploader, normalize_ecg_endpoints, ecg_to_dac_3mVpp, set_dac_pp_voltage
+from ecg_uart_uploader import ECGUARTUploader, normalize_ecg_endpoints, ecg_to_normalized_codes, choose_codec
 
 
 class ConfigWindow(tk.Toplevel):
@@ -362,9 +362,7 @@ class App:
         minimumLength = int(required_len / 4)
         isolated_ecg = ecg[minimumLength:-minimumLength]
         normalized_ecg = normalize_ecg_endpoints(isolated_ecg)
-        set_dac_pp_voltage(amplitude)
-        dac_ecg = ecg_to_dac_3mVpp(normalized_ecg)
-        return dac_ecg
+        return ecg_to_normalized_codes(normalized_ecg)
 
     def _download_thread(self, hr, amplitude):
         # Stop benchmark if it's running
@@ -378,6 +376,12 @@ class App:
             total = len(dac_ecg)
             self.root.after(0, lambda: self.progress.configure(maximum=total))
 
+            # Slow rates make long beats, store them packed so they fit a device bank
+            codec = choose_codec(dac_ecg)
+            if codec is None:
+                self.log_msg(f"{total} samples do not fit the device, choose a higher heart rate")
+                return
+
             # Create uploader and connect (suppress noisy prints coming from uploader)
             self.log_msg(f"Connecting to {self.selected_port} @ {self.baudrate}...")
             uploader = ECGUARTUploader(port=self.selected_port, baudrate=self.baudrate, timeout=2.0)
@@ -398,8 +402,8 @@ class App:
             time.sleep(0.3)
 
             # Step 2: initiate download
-            self.log_msg(f"Initiating download (size={total})...")
-            if not self._silent_call(uploader.initiate_ecg_download, total):
+            self.log_msg(f"Initiating download (size={total}, codec={codec})...")
+            if not self._silent_call(uploader.initiate_ecg_download, total, codec):
                 self.log_msg("Initiate download failed")
                 self._silent_call(uploader.disconnect)
                 self.sending = False
@@ -429,6 +433,8 @@ class App:
                 self.root.after(0, lambda p=percent: self.progress_label.config(text=f"{p}%"))
 
             self.log_msg("Download finished (check device response)")
+            if not self._silent_call(uploader.set_amplitude, amplitude):
+                self.log_msg("Setting amplitude failed")
             self._silent_call(uploader.disconnect)
 
         except Exception as e:
@@ -1,6 +1,9 @@
 import serial
 import time
+import re
+import struct
 import sys
+import zlib
 import numpy as np
 import matplotlib.pyplot as plt
 
@@ -11,40 +14,47 @@ DAC_MID = DAC_MAX // 2               # 2047
 
 DIVIDER_RATIO = 10.0 / (10000.0 + 10.0)   # ≈ 0.000999
 
-ECG_OFFSET_MV = -0.24    # Calibration offset in mV (adjust to match measured output)
+# The device corrects its DAC outputs with a stored calibration, see calibrate()
+CAL_KNOT_COUNT = 17                  # one knot every 256 codes plus full scale
 
-# Global DAC settings (will be initialized by set_dac_pp_voltage)
-ECG_PP_MV = None
-DAC_PP_V = None
-DAC_PP_CODES = None
-DAC_HALF_SWING = None
+# Uploaded beats are normalized, the device scales them with SetAmplitude/SetOffset
+ECG_NORMALIZED_MID = 2048
+ECG_NORMALIZED_HALF_SWING = 2047
 
-def set_dac_pp_voltage(ecg_pp_mv):
+# SetBaudRate rates, highest first. The device boots at 115200 and falls
+# back to the old rate unless ConfirmBaud arrives within a second
+BAUD_RATES = (1000000, 921600, 460800, 230400, 115200)
+BAUD_CONFIRM_TIMEOUT = 1.0
+
+# GetBlockCrcs block size for delta uploads, 64 samples is 128 bytes of binary frame
+DELTA_BLOCK_SAMPLES = 64
+
+# The device refuses a new upload until the last one takes over at its loop
+# boundary, at most one beat of the slowest rate (20 bpm)
+UPLOAD_START_TIMEOUT = 4.0
+
+# Codecs that store uploaded codes exactly, VerifyEcg can confirm their upload
+LOSSLESS_CODECS = (None, "raw", "pack12", "delta")
+
+# Each of the two waveform banks on the device holds this many coded bytes:
+# 1024 samples raw, 1365 pack12, up to 4093 delta depending on the waveform
+ECG_BANK_SIZE_BYTES = 2048
+
+# StreamEcgData carries up to 42 samples per line, 2 characters of 6 bits each
+STREAM_CHUNK_SAMPLES = 42
+
+def amplitude_to_uv(ecg_pp_mv):
     """
-    Set the desired DAC peak-to-peak voltage and recalculate dependent values.
-    
-    Args:
-        ecg_pp_mv: Desired ECG peak-to-peak voltage in millivolts
+    Convert a requested ECG peak-to-peak amplitude to the microvolt value
+    for SetAmplitude.
     """
-    global ECG_PP_MV, DAC_PP_V, DAC_PP_CODES, DAC_HALF_SWING
-    
-    if ecg_pp_mv <= 1.5:
-        ECG_PP_MV = ecg_pp_mv 
-    else:
-        ECG_PP_MV = ecg_pp_mv + ECG_OFFSET_MV
-    DAC_PP_V = (ECG_PP_MV * 1e-3) / DIVIDER_RATIO
-    DAC_PP_CODES = (DAC_PP_V / DAC_VREF) * DAC_MAX
-    DAC_HALF_SWING = DAC_PP_CODES / 2.0
-    
-    print(f"DAC settings updated: ECG_PP_MV={ECG_PP_MV:.1f}mV, DAC_PP_V={DAC_PP_V:.3f}V, DAC_HALF_SWING={DAC_HALF_SWING:.1f}")
+    return int(round(ecg_pp_mv * 1000.0))
 
-# Initialize with default value (3.0 mV + calibration offset)
-# set_dac_pp_voltage(3.0 + ECG_OFFSET_MV)
-
-def ecg_to_dac_3mVpp(ecg):
+def ecg_to_normalized_codes(ecg):
     """
-    Convert ecgsyn ECG waveform to 12-bit DAC codes that produce
-    ~3 mV p-p ECG after 10k–10Ω–10k resistor network.
+    Convert an ecgsyn ECG waveform to normalized 12-bit codes spanning the
+    full range around ECG_NORMALIZED_MID. Amplitude and baseline are applied
+    on the device, so a new amplitude does not need a new upload.
 
     Parameters
     ----------
@@ -53,37 +63,126 @@ def ecg_to_dac_3mVpp(ecg):
 
     Returns
     -------
-    dac : np.ndarray (uint16)
-        DAC codes ready for MCP4725
+    codes : np.ndarray (uint16)
     """
 
     ecg = np.asarray(ecg, dtype=np.float64)
 
-    # 1️⃣ Find min and max
     vmin = ecg.min()
     vmax = ecg.max()
     vrange = vmax - vmin
 
     if vrange < 1e-12:
-        return np.full_like(ecg, DAC_MID, dtype=np.uint16)
+        return np.full_like(ecg, ECG_NORMALIZED_MID, dtype=np.uint16)
 
-    # 2️⃣ Normalize to [-1, +1]
+    # Normalize to [-1, +1]
     ecg_norm = 2.0 * (ecg - vmin) / vrange - 1.0
 
-    # 3️⃣ Calculate optimal DAC midpoint based on valid range for this amplitude
-    # The valid range is constrained by: [DAC_HALF_SWING, DAC_MAX - DAC_HALF_SWING]
-    # Position optimally within this range
-    valid_min = DAC_HALF_SWING
-    valid_max = DAC_MAX - DAC_HALF_SWING
-    dac_mid_target = (valid_min + valid_max) / 2.0
+    codes = np.round(ECG_NORMALIZED_MID + ecg_norm * ECG_NORMALIZED_HALF_SWING)
+    return np.clip(codes, 0, DAC_MAX).astype(np.uint16)
 
-    # 4️⃣ Scale to DAC
-    dac = dac_mid_target + ecg_norm * DAC_HALF_SWING
+def interleave_leads(leads):
+    """
+    Interleave equal length per-lead code arrays into one frame-ordered
+    array, lead 0 first, for multi-lead uploads and streams. The device
+    finds the R peak on lead 0.
+    """
+    leads = [np.asarray(lead, dtype=np.uint16) for lead in leads]
+    if len({len(lead) for lead in leads}) != 1:
+        raise ValueError("All leads must have the same length")
+    return np.stack(leads, axis=1).reshape(-1)
 
-    # 5️⃣ Clamp and convert
-    dac = np.clip(dac, 0, DAC_MAX)
+def capture_crc(frames):
+    """
+    CRC-32 the capture backend reports for a run of output frames, so a
+    capture can be checked against the host rendering of the same waveform.
 
-    return dac.astype(np.uint16)
+    Args:
+        frames: Sequence of frames, each a sequence of one 12-bit code per
+                DAC channel
+    """
+    data = bytearray()
+    for frame in frames:
+        for code in frame:
+            data += int(code).to_bytes(2, "little")
+    return zlib.crc32(bytes(data))
+
+def cobs_encode(data):
+    """COBS-encode bytes, the result holds no zero byte and gets no delimiter."""
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 254:
+                out.append(255)
+                out += block
+                block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+def cobs_decode(data):
+    """Decode one COBS-encoded frame without its delimiter, None when malformed."""
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code < 255 and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+def binary_upload_frame(sequence, samples):
+    """One BinaryUpload frame: sequence, samples and CRC-32, COBS-encoded and zero-terminated."""
+    payload = struct.pack(f"<H{len(samples)}H", sequence & 0xFFFF, *(int(v) for v in samples))
+    return cobs_encode(payload + struct.pack("<I", zlib.crc32(payload))) + b"\x00"
+
+def block_crcs(samples, block_size=DELTA_BLOCK_SAMPLES):
+    """CRC-32 of each block of samples as GetBlockCrcs reports it, the last block may be short."""
+    return [zlib.crc32(struct.pack(f"<{len(block)}H", *(int(v) for v in block)))
+            for block in (samples[start:start + block_size] for start in range(0, len(samples), block_size))]
+
+def codec_size(samples, codec):
+    """Bytes the device codec stores samples in, counted the way WaveformCodec.c writes them."""
+    if codec in (None, "raw"):
+        nibbles = 4 * len(samples)
+    elif codec == "pack12":
+        nibbles = 3 * len(samples)
+    elif codec == "adpcm":
+        nibbles = 6 + len(samples)
+    elif codec == "delta":
+        nibbles = 0
+        previous = None
+        for value in samples:
+            value = min(max(int(value), 0), 4095)
+            if previous is not None and -7 <= value - previous <= 6:
+                nibbles += 1
+            elif previous is not None and -128 <= value - previous <= 127:
+                nibbles += 3
+            else:
+                nibbles += 4
+            previous = value
+    else:
+        raise ValueError(f"Unknown codec {codec}")
+    return (nibbles + 1) // 2
+
+def choose_codec(samples):
+    """
+    The cheapest lossless codec whose encoding of samples fits a device bank,
+    None when even 'delta' does not fit and the waveform must be shortened.
+    """
+    for codec in ("raw", "pack12", "delta"):
+        if codec_size(samples, codec) <= ECG_BANK_SIZE_BYTES:
+            return codec
+    return None
 
 def normalize_ecg_endpoints(ecg):
     """
@@ -124,8 +223,16 @@ class ECGUARTUploader:
         self.timeout = timeout
         self.ser = None
         
-    def connect(self):
-        """Establish UART connection."""
+    def connect(self, link_baudrate=None):
+        """
+        Establish UART connection at the boot rate, then optionally move the
+        link to a faster one.
+
+        Args:
+            link_baudrate: Rate to switch to with set_baud_rate, or "auto" to
+                probe for the fastest reliable one. The link stays at the boot
+                rate if the switch fails.
+        """
         try:
             self.ser = serial.Serial(
                 port=self.port,
@@ -136,10 +243,73 @@ class ECGUARTUploader:
                 stopbits=serial.STOPBITS_ONE
             )
             print(f"Connected to {self.port} at {self.baudrate} baud")
-            return True
         except serial.SerialException as e:
             print(f"Failed to connect: {e}")
             return False
+
+        if link_baudrate == "auto":
+            self.probe_baud_rate()
+        elif link_baudrate and not self.set_baud_rate(link_baudrate):
+            print(f"WARNING: Staying at {self.ser.baudrate} baud")
+        return True
+
+    def _link_alive(self):
+        self.ser.write(b"GetSampleRate\r")
+        reply = self._read_stream_reply(b"\n", timeout=0.3) or b""
+        return re.search(rb"Rate: \d+ Hz Overruns: \d+\n", reply) is not None
+
+    def set_baud_rate(self, baud_rate):
+        """
+        Switch the command link: the device acks at the old rate, both sides
+        switch and the host confirms at the new one. Unconfirmed, the device
+        falls back by itself.
+
+        Returns:
+            True when the link runs at baud_rate
+        """
+        old_rate = self.ser.baudrate
+        self.ser.reset_input_buffer()
+        self.ser.write(f"SetBaudRate {int(baud_rate)}\r".encode())
+        if not self._read_stream_reply(b"ok"):
+            print(f"ERROR: Device refused {baud_rate} baud")
+            return False
+
+        self.ser.baudrate = baud_rate
+        time.sleep(0.02)
+        self.ser.reset_input_buffer()
+        self.ser.write(b"ConfirmBaud\r")
+        if self._read_stream_reply(b"ok", timeout=0.5):
+            print(f"Link at {baud_rate} baud")
+            return True
+
+        # Wait out the confirmation window, then find the side the device ended on
+        time.sleep(BAUD_CONFIRM_TIMEOUT + 0.2)
+        for rate in (old_rate, baud_rate):
+            self.ser.baudrate = rate
+            self.ser.reset_input_buffer()
+            if self._link_alive():
+                return rate == baud_rate
+        self.ser.baudrate = old_rate
+        return False
+
+    def probe_baud_rate(self, candidates=BAUD_RATES, checks=20):
+        """
+        Move the link to the fastest rate that answers every one of checks
+        status queries, stepping down through candidates.
+
+        Returns:
+            The rate the link ended on
+        """
+        boot_rate = self.ser.baudrate
+        for rate in candidates:
+            if rate != self.ser.baudrate and not self.set_baud_rate(rate):
+                continue
+            if all(self._link_alive() for _ in range(checks)):
+                return rate
+            print(f"Link unreliable at {rate} baud")
+            if not self.set_baud_rate(boot_rate):
+                self.ser.baudrate = boot_rate
+        return self.ser.baudrate
     
     def disconnect(self):
         """Close UART connection."""
@@ -217,18 +387,39 @@ class ECGUARTUploader:
         print("SUCCESS: Firmware info received")
         return True
     
-    def initiate_ecg_download(self, data_size):
-        """Send InitiateEcgDownload command with data size."""
-        print(f"\n[Step 2] Initiating ECG Download (size={data_size})...")
-        self.send_command(f"InitiateEcgDownload {data_size}\r")
-        response = self.read_response(wait_for="ok")
+    def initiate_ecg_download(self, data_size, codec=None):
+        """
+        Send InitiateEcgDownload command with data size.
 
-        if response is None or "ok" not in response.lower():
-            print(f"ERROR: Expected 'ok' response, got: {repr(response)}")
+        Args:
+            data_size: Number of samples to be uploaded
+            codec: Optional on-device storage codec ('raw', 'pack12', 'delta', 'adpcm').
+                   A bank holds 1024 'raw', 1365 'pack12' and about 4090 'adpcm'
+                   samples, 'delta' up to 4093 depending on the waveform.
+        """
+        print(f"\n[Step 2] Initiating ECG Download (size={data_size}, codec={codec or 'raw'})...")
+        command = f"InitiateEcgDownload {data_size} {codec}\r" if codec else f"InitiateEcgDownload {data_size}\r"
+        if not self._start_upload(command, "Download initiation"):
             return False
-        
+
         print("SUCCESS: Download initiated")
         return True
+
+    def _start_upload(self, command, what):
+        """
+        Send an upload start command, retrying while the previous upload
+        still waits to take over on the device.
+        """
+        deadline = time.time() + UPLOAD_START_TIMEOUT
+        while True:
+            self.send_command(command)
+            response = self.read_response(wait_for="ok")
+            if response is not None and "ok" in response.lower():
+                return True
+            if time.time() > deadline:
+                print(f"ERROR: {what} failed, got: {repr(response)}")
+                return False
+            time.sleep(0.2)
     
     def send_ecg_data(self, ecg_data):
         """
@@ -261,16 +452,665 @@ class ECGUARTUploader:
         print(f"SUCCESS: All {len(ecg_data)} samples sent")
         return True
     
-    def upload_ecg(self, ecg_data):
+    def send_ecg_data_binary(self, samples, retries=3):
+        """
+        Send the samples of the upload just initiated as binary frames of up
+        to a few hundred samples. Frames go out within the device's ack
+        window, and a CRC error or lost frame is resent from where the device
+        asks for it.
+
+        Args:
+            samples: 12-bit codes, the rest of the upload or the next run of it
+            retries: Resends of the window after silence from the device
+
+        Returns:
+            True if the device took every sample
+        """
+        self.ser.write(f"BinaryUpload {len(samples)}\r".encode())
+        match = re.search(rb"Binary: (\d+) (\d+)", self._read_stream_reply(b"\n") or b"")
+        if not match:
+            print("ERROR: Device refused the binary upload")
+            return False
+
+        chunk, window = int(match.group(1)), int(match.group(2))
+        frames = [binary_upload_frame(seq, samples[start:start + chunk])
+                  for seq, start in enumerate(range(0, len(samples), chunk))]
+        base = 0
+        next_frame = 0
+        silent = 0
+        replies = b""
+
+        while True:
+            while next_frame < len(frames) and next_frame - base < window:
+                self.ser.write(frames[next_frame])
+                next_frame += 1
+
+            # Well inside the device's idle timeout, so a resend still finds it listening
+            reply = self._read_stream_reply(b"\n", timeout=0.5)
+            if reply is None:
+                silent += 1
+                if silent > retries:
+                    print(f"ERROR: No acknowledgement after frame {base}")
+                    self.ser.write(binary_upload_frame(base, []))
+                    return False
+                next_frame = base
+                continue
+
+            silent = 0
+            replies += reply
+            lines = replies.split(b"\n")
+            replies = lines.pop()
+            for line in lines:
+                if line.startswith(b"Ack "):
+                    base = max(base, int(line[4:]) + 1)
+                elif line.startswith(b"Nak "):
+                    base = next_frame = int(line[4:])
+                elif line.startswith(b"Done"):
+                    print(f"SUCCESS: All {len(samples)} samples sent in {len(frames)} frames")
+                    return True
+                elif line.startswith((b"Fail", b"Abort", b"Raw mode timeout")):
+                    print(f"ERROR: Binary upload ended with {line!r}")
+                    return False
+
+    def set_heart_rate(self, heart_rate):
+        """
+        Retime the stored beat on the device without a new upload.
+
+        Args:
+            heart_rate: Beats per minute (20-300), 0 plays the beat as uploaded
+        """
+        self.send_command(f"SetHeartRate {int(heart_rate)}\r")
+        response = self.read_response(wait_for="ok")
+
+        if response is None or "ok" not in response.lower():
+            print(f"ERROR: Heart rate {heart_rate} rejected, got: {repr(response)}")
+            return False
+        return True
+
+    def _expect_ok(self, command, what):
+        self.send_command(command)
+        response = self.read_response(wait_for="ok")
+
+        if response is None or "ok" not in response.lower():
+            print(f"ERROR: {what} failed, got: {repr(response)}")
+            return False
+        return True
+
+    def _fit_codec(self, samples, codec):
+        """
+        The codec to upload samples with: codec if they fit a device bank with
+        it, the cheapest lossless one when codec is None. None if they do not fit.
+        """
+        if codec is None:
+            codec = choose_codec(samples)
+            if codec is None:
+                print(f"ERROR: {len(samples)} samples do not fit a {ECG_BANK_SIZE_BYTES} byte bank, even as 'delta'")
+            return codec
+
+        size = codec_size(samples, codec)
+        if size > ECG_BANK_SIZE_BYTES:
+            print(f"ERROR: {len(samples)} samples take {size} bytes as '{codec}', a bank holds {ECG_BANK_SIZE_BYTES}")
+            return None
+        return codec
+
+    def send_markers(self, markers, per_command=10):
+        """
+        Annotate the template being uploaded, send after the initiate command
+        and before the last sample.
+
+        Args:
+            markers: Sequence of (type, frame) tuples in frame order, type is
+                     'R' (R peak), 'P' (pace) or 'S' (sync). Every marker type
+                     enabled with set_marker_trigger opens a latency window.
+        """
+        tokens = [f"{kind}:{int(frame)}" for kind, frame in markers]
+        for start in range(0, len(tokens), per_command):
+            chunk = " ".join(tokens[start:start + per_command])
+            if not self._expect_ok(f"AddMarkers {chunk}\r", "Markers"):
+                return False
+        return True
+
+    def set_marker_trigger(self, types="R"):
+        """Choose the marker types ('R', 'P', 'S') that open a latency window."""
+        return self._expect_ok(f"SetMarkerTrigger {types}\r", "Marker trigger")
+
+    def get_marker_stats(self):
+        """Return the device's marker and measurement window counts as text."""
+        self.send_command("GetMarkerStats\r")
+        return self.read_response(wait_for="Mask")
+
+    def upload_templates(self, templates, codec=None, markers=None, binary=True):
+        """
+        Upload a set of beat templates and make them live in one step.
+
+        Args:
+            templates: Dict of beat symbol ('N', 'V', 'A', 'P') to sample list.
+                       'N' is required, missing beats fall back to it.
+            codec: Optional on-device storage codec, see initiate_ecg_download
+            markers: Optional dict of beat symbol to markers, see send_markers.
+                     Templates without markers get one R marker at their peak.
+            binary: Send samples as binary frames, False for one command per sample
+        """
+        for beat, samples in templates.items():
+            command = f"InitiateTemplateDownload {beat} {len(samples)}"
+            if codec:
+                command += f" {codec}"
+            if not self._start_upload(command + "\r", f"Template {beat} download"):
+                return False
+            if markers and markers.get(beat) and not self.send_markers(markers[beat]):
+                return False
+            sent = self.send_ecg_data_binary(samples) if binary else self.send_ecg_data(samples)
+            if not sent:
+                return False
+
+        return self._expect_ok("CommitTemplates\r", "Template commit")
+
+    def set_rhythm(self, steps, per_command=10):
+        """
+        Load a rhythm script into the sequencer.
+
+        Args:
+            steps: Sequence of beat symbols or (symbol, rr_ms) tuples, e.g.
+                   ['N', ('V', 550), ('N', 1250), 'D']. Empty stops the sequencer.
+            per_command: Steps sent per command line, the rest is appended
+        """
+        tokens = [s if isinstance(s, str) else f"{s[0]}:{int(s[1])}" for s in steps]
+        if not tokens:
+            return self._expect_ok("SetRhythm\r", "Rhythm stop")
+
+        for start in range(0, len(tokens), per_command):
+            command = "SetRhythm" if start == 0 else "AppendRhythm"
+            chunk = " ".join(tokens[start:start + per_command])
+            if not self._expect_ok(f"{command} {chunk}\r", "Rhythm load"):
+                return False
+        return True
+
+    def set_amplitude(self, ecg_pp_mv):
+        """Set the ECG peak-to-peak amplitude at RA-LA in mV, takes effect immediately."""
+        return self._expect_ok(f"SetAmplitude {amplitude_to_uv(ecg_pp_mv)}\r", "Amplitude")
+
+    def set_offset(self, offset_uv):
+        """Shift the ECG baseline at RA-LA by a signed number of microvolts."""
+        return self._expect_ok(f"SetOffset {int(offset_uv)}\r", "Offset")
+
+    def save_waveform(self, slot, name):
+        """
+        Store the waveform now playing in on-device flash slot 0-2 under a
+        short name. A slot takes 4064 bytes of templates, markers and encoded
+        samples; a bigger waveform is refused with "Too large: <needed> <limit>".
+        """
+        return self._expect_ok(f"SaveWaveform {int(slot)} {name[:12]}\r", "Waveform save")
+
+    def select_waveform(self, slot):
+        """Play a saved waveform now and load it automatically at every boot."""
+        return self._expect_ok(f"SelectWaveform {int(slot)}\r", "Waveform select")
+
+    def erase_waveform(self, slot):
+        """Erase a flash library slot."""
+        return self._expect_ok(f"EraseWaveform {int(slot)}\r", "Waveform erase")
+
+    def list_waveforms(self):
+        """Return the device's flash library listing as text."""
+        self.send_command("ListWaveforms\r")
+        return self.read_response(max_wait=1.0)
+
+    def _read_stream_reply(self, terminator, timeout=1.0):
+        """Read raw bytes up to terminator without logging, for the stream hot path."""
+        deadline = time.time() + timeout
+        response = b""
+        while time.time() < deadline and terminator not in response:
+            response += self.ser.read(self.ser.in_waiting or 1)
+        return response if terminator in response else None
+
+    def _stream_credits(self, command, terminator=b"ok"):
+        self.ser.write(command.encode())
+        response = self._read_stream_reply(terminator)
+        match = re.search(rb"Credits: (\d+)", response or b"")
+        return int(match.group(1)) if match else None
+
+    @staticmethod
+    def encode_stream_samples(samples):
+        """Encode 12-bit samples as StreamEcgData characters."""
+        return "".join(chr(48 + (int(v) >> 6)) + chr(48 + (int(v) & 0x3F)) for v in samples)
+
+    def stream_ecg(self, samples, prefill=0, progress=None):
+        """
+        Play a recording of any length by streaming it into the device's
+        jitter buffer. Sends only as many samples as the device has granted
+        credits for, so the buffer never overruns.
+
+        Args:
+            samples: Normalized 12-bit codes (see ecg_to_normalized_codes)
+            prefill: Samples buffered before playback starts, 0 for half the buffer
+            progress: Optional callback(sent, total)
+
+        Returns:
+            True when every sample was accepted
+        """
+        credits = self._stream_credits(f"StartStream {int(prefill)}\r")
+        if credits is None:
+            print("ERROR: Device refused to start streaming")
+            return False
+
+        sent = 0
+        total = len(samples)
+        try:
+            while sent < total:
+                count = min(STREAM_CHUNK_SAMPLES, total - sent)
+                if credits < count:
+                    # Let playback drain a chunk's worth before asking again
+                    time.sleep(0.02)
+                    credits = self._stream_credits("GetStreamStats\r", terminator=b"Overruns")
+                    if credits is None:
+                        print("ERROR: No stream status from device")
+                        return False
+                    continue
+
+                payload = self.encode_stream_samples(samples[sent:sent + count])
+                credits = self._stream_credits(f"StreamEcgData {payload}\r")
+                if credits is None:
+                    print(f"ERROR: No acknowledgement for samples {sent}-{sent + count}")
+                    return False
+                sent += count
+                if progress:
+                    progress(sent, total)
+
+            # Wait for the buffer to drain before giving playback back
+            while True:
+                self.ser.write(b"GetStreamStats\r")
+                status = self._read_stream_reply(b"Overruns") or b""
+                match = re.search(rb"Fill: (\d+)", status)
+                if not match or int(match.group(1)) == 0:
+                    break
+                time.sleep(0.05)
+            return True
+        finally:
+            self.ser.write(b"StopStream\r")
+            self._read_stream_reply(b"ok")
+
+    def get_stream_stats(self):
+        """Return the device's stream fill, credits, underrun and overrun counts as text."""
+        self.send_command("GetStreamStats\r")
+        return self.read_response(wait_for="Overruns")
+
+    def set_channels(self, channel_count):
+        """Set how many interleaved leads the next upload or stream carries."""
+        return self._expect_ok(f"SetChannels {int(channel_count)}\r", "Channel count")
+
+    def get_dac_skew(self, reset=False):
+        """Return the device's inter-channel DAC skew statistics as text."""
+        self.send_command("GetDacSkew reset\r" if reset else "GetDacSkew\r")
+        return self.read_response(wait_for="Errors")
+
+    def set_i2c_speed(self, clock_speed):
+        """Select the DAC bus speed: 100000 (standard) or 400000 (fast) Hz."""
+        return self._expect_ok(f"SetI2cSpeed {int(clock_speed)}\r", "I2C speed")
+
+    def dac_self_test(self, speed_count=2):
+        """
+        Run the on-device DAC self-test. Playback pauses for about 0.1 s per speed.
+
+        Returns:
+            Dict of bus speed in Hz to complete frames per second, the highest
+            sample rate the DAC bus keeps up with at that speed
+        """
+        self.send_command("DacSelfTest\r")
+        results = {}
+        for _ in range(speed_count):
+            response = self.read_response(wait_for="Errors")
+            if not response:
+                break
+            match = re.search(r"I2C: (\d+) Hz Frames: (\d+)/s", response)
+            if match:
+                results[int(match.group(1))] = int(match.group(2))
+        return results
+
+    def set_continuous(self, enable):
+        """
+        Switch continuous output on or off. Lead 0 then streams as one open
+        I2C transaction paced by the bus clock instead of the sample clock;
+        needs a one-lead waveform.
+        """
+        return self._expect_ok(f"SetContinuous {1 if enable else 0}\r", "Continuous output")
+
+    def get_continuous(self):
+        """Return (enabled, achieved rate in Hz) of continuous output."""
+        self.send_command("SetContinuous\r")
+        response = self.read_response(wait_for="Hz")
+        match = re.search(r"Continuous: (\d) Rate: (\d+) Hz", response or "")
+        if not match:
+            return None
+        return match.group(1) == "1", int(match.group(2))
+
+    def set_output(self, backend):
+        """Select the output backend: 'dac' (MCP4725), 'pwm' (TIM4 + RC) or 'capture'."""
+        if backend not in ("dac", "pwm", "capture"):
+            raise ValueError(f"Unknown output backend: {backend}")
+        return self._expect_ok(f"SetOutput {backend}\r", "Output backend")
+
+    def get_output(self):
+        """Return the output backend in use and its capabilities as text."""
+        self.send_command("SetOutput\r")
+        return self.read_response(wait_for="Flags")
+
+    def get_capture(self, reset=False):
+        """
+        Read the capture backend counters.
+
+        Returns:
+            (frames, crc) or None; compare crc with capture_crc() of the
+            frames the host expects
+        """
+        self.send_command("GetCapture reset\r" if reset else "GetCapture\r")
+        response = self.read_response(wait_for="Last")
+        match = re.search(r"Captured: (\d+) Crc: ([0-9a-fA-F]{8})", response or "")
+        if not match:
+            return None
+        return int(match.group(1)), int(match.group(2), 16)
+
+    def benchmark(self, frame_count):
+        """
+        Render frame_count frames into the output backend as fast as it takes
+        them. Playback pauses meanwhile.
+
+        Returns:
+            Frames per second, or None on failure
+        """
+        self.send_command(f"Benchmark {int(frame_count)}\r")
+        response = self.read_response(wait_for="Cycles", max_wait=max(self.timeout, 30))
+        match = re.search(r"Rate: (\d+)/s", response or "")
+        return int(match.group(1)) if match else None
+
+    def get_i2c_health(self, reset=False):
+        """
+        Read the DAC bus error counters. Counters that keep growing during a
+        soak run mean degraded output even when playback never stopped.
+
+        Returns:
+            dict of counter name to value, or None
+        """
+        self.send_command("GetI2cHealth reset\r" if reset else "GetI2cHealth\r")
+        response = self.read_response(wait_for="Pending")
+        pairs = re.findall(r"(\w+): (\d+)", response or "")
+        if not pairs:
+            return None
+        return {name: int(value) for name, value in pairs}
+
+    def calibrate(self, measure_mv, channels=(0, 1), knots=range(CAL_KNOT_COUNT)):
+        """
+        Calibrate the DAC outputs of this unit and store the result on the
+        device. Playback pauses meanwhile.
+
+        Args:
+            measure_mv: Called as measure_mv(channel, code) once the device
+                drives code on channel, returns the RA-LA voltage in mV read
+                from a meter
+            channels: Leads to calibrate, the others keep the ideal transfer
+            knots: Knots to measure, 0 and 16 are required and every other
+                one refines the INL correction
+
+        Returns:
+            True when the calibration was stored
+        """
+        if not self._expect_ok("CalStart\r", "Calibration start"):
+            return False
+
+        for channel in channels:
+            for knot in knots:
+                self.send_command(f"CalPoint {channel} {knot}\r")
+                match = re.search(r"Code: (\d+)", self.read_response(wait_for="Code") or "")
+                if not match:
+                    self._expect_ok("CalEnd\r", "Calibration abort")
+                    return False
+
+                measured_nv = int(round(measure_mv(channel, int(match.group(1))) * 1e6))
+                if not self._expect_ok(f"CalPoint {channel} {knot} {measured_nv}\r", "Calibration point"):
+                    self._expect_ok("CalEnd\r", "Calibration abort")
+                    return False
+
+        return self._expect_ok("CalEnd save\r", "Calibration save")
+
+    def get_calibration(self, clear=False, channel_count=2):
+        """
+        Read the calibration in use, clear erases it from the device.
+
+        Returns:
+            List of dicts per channel with calibrated, offset_nv, gain_pv and
+            max_inl_nv
+        """
+        self.send_command("GetCal clear\r" if clear else "GetCal\r")
+        results = []
+        for _ in range(channel_count):
+            response = self.read_response(wait_for=" nV\n")
+            if not response:
+                break
+            match = re.search(r"Cal: (\d) Offset: (-?\d+) nV Gain: (-?\d+) pV Inl: (\d+) nV", response)
+            if match:
+                results.append({"calibrated": match.group(1) == "1", "offset_nv": int(match.group(2)),
+                                "gain_pv": int(match.group(3)), "max_inl_nv": int(match.group(4))})
+        return results
+
+    def get_block_crcs(self, block_size=DELTA_BLOCK_SAMPLES):
+        """
+        Read the CRC-32 of each block of the waveform the device is playing.
+
+        Returns:
+            (sample count, list of CRCs), or None when nothing is playing
+        """
+        self.ser.write(f"GetBlockCrcs {int(block_size)}\r".encode())
+        reply = b""
+        while True:
+            line = self._read_stream_reply(b"\n")
+            if line is None:
+                return None
+            reply += line
+            match = re.search(rb"Blocks: (\d+) Samples: (\d+)\n((?:[0-9A-F]{8}\n)*)", reply)
+            if match and len(match.group(3)) // 9 >= int(match.group(1)):
+                break
+
+        crcs = [int(value, 16) for value in match.group(3).split()]
+        return int(match.group(2)), crcs[:int(match.group(1))]
+
+    def upload_ecg_delta(self, ecg_data, codec=None, markers=None, block_size=DELTA_BLOCK_SAMPLES):
+        """
+        Upload a waveform sending only the blocks that differ from the one the
+        device is playing, the rest is copied on the device with KeepEcgData.
+        Meant for tuning a waveform in place: with the 'adpcm' codec the
+        stored beat is lossy, so its blocks never match and all are sent.
+
+        Args:
+            ecg_data: 12-bit codes, interleaved when more than one lead is set
+            codec, markers: As for upload_ecg, markers are always sent again
+            block_size: Samples per compared block
+
+        Returns:
+            True if upload successful, False otherwise
+        """
+        codec = self._fit_codec(ecg_data, codec)
+        if codec is None:
+            return False
+
+        playing = self.get_block_crcs(block_size)
+        device_crcs = playing[1] if playing else []
+        changed = [i >= len(device_crcs) or crc != device_crcs[i]
+                   for i, crc in enumerate(block_crcs(ecg_data, block_size))]
+        print(f"Delta upload: {sum(changed)}/{len(changed)} blocks changed")
+
+        if playing and playing[0] == len(ecg_data) and not any(changed) and not markers:
+            return True
+
+        if not self.initiate_ecg_download(len(ecg_data), codec):
+            return False
+        if markers and not self.send_markers(markers):
+            return False
+
+        block = 0
+        while block < len(changed):
+            run_end = block
+            while run_end < len(changed) and changed[run_end] == changed[block]:
+                run_end += 1
+            run = ecg_data[block * block_size:run_end * block_size]
+
+            if changed[block]:
+                if not self.send_ecg_data_binary(run):
+                    return False
+            elif not self._expect_ok(f"KeepEcgData {len(run)}\r", "Keeping unchanged blocks"):
+                return False
+            block = run_end
+
+        if not self.verify_upload(ecg_data, codec):
+            return False
+        print("\n✓ ECG delta upload completed successfully!")
+        return True
+
+    def verify_ecg(self):
+        """
+        Read the length, R peak frame and CRC-32 of the normal beat the
+        device plays, or is about to play after an upload.
+
+        Returns:
+            dict with length, peak and crc, or None
+        """
+        self.ser.write(b"VerifyEcg\r")
+        match = re.search(rb"Length: (\d+) Peak: (-?\d+) Crc: ([0-9A-F]{8})", self._read_stream_reply(b"\n") or b"")
+        if not match:
+            return None
+        return {"length": int(match.group(1)), "peak": int(match.group(2)), "crc": int(match.group(3), 16)}
+
+    def verify_upload(self, samples, codec=None):
+        """
+        Confirm a whole upload with one CRC. Lossy codecs only have their
+        length checked.
+        """
+        result = self.verify_ecg()
+        if result is None or result["length"] != len(samples):
+            print(f"ERROR: Device holds {result and result['length']} samples, expected {len(samples)}")
+            return False
+        if codec in LOSSLESS_CODECS and result["crc"] != block_crcs(samples, len(samples))[0]:
+            print(f"ERROR: Device CRC {result['crc']:08X} does not match the upload")
+            return False
+        return True
+
+    def read_ecg(self, start=0, count=None):
+        """
+        Read back decoded samples of the normal beat the device plays, to
+        capture device state for regression runs.
+
+        Args:
+            start: First sample, interleaved when more than one lead is set
+            count: Samples to read, None for the rest of the beat
+
+        Returns:
+            List of 12-bit codes, or None on a corrupt, missing or short readback
+        """
+        command = f"ReadEcg {int(start)}" + (f" {int(count)}" if count is not None else "")
+        self.ser.write((command + "\r").encode())
+        reply = b""
+        while b"\n" not in reply:
+            part = self._read_stream_reply(b"\n")
+            if part is None:
+                return None
+            reply += part
+        header, _, reply = reply.partition(b"\n")
+        match = re.search(rb"Readback: (\d+) (\d+)", header)
+        if not match:
+            return None
+
+        total = int(match.group(1))
+        samples = []
+        frames = 0
+        crc = 0
+        while True:
+            while b"\x00" not in reply:
+                part = self._read_stream_reply(b"\x00")
+                if part is None:
+                    print(f"ERROR: Readback cut off at sample {start + len(samples)}")
+                    return None
+                reply += part
+            encoded, _, reply = reply.partition(b"\x00")
+
+            # The trailer ends the readback, the device counts the frames it sent
+            trailer = re.match(rb"End: (\d+) ([0-9A-F]{8})", encoded)
+            if trailer:
+                break
+
+            frame = cobs_decode(encoded)
+            if (frame is None or len(frame) < 6 or len(frame) % 2 != 0 or
+                    zlib.crc32(frame[:-4]) != struct.unpack("<I", frame[-4:])[0]):
+                print(f"ERROR: Corrupt readback frame at sample {start + len(samples)}")
+                return None
+            if struct.unpack("<H", frame[:2])[0] != (start + len(samples)) & 0xFFFF:
+                print(f"ERROR: Readback lost frames at sample {start + len(samples)}")
+                return None
+            samples += struct.unpack(f"<{(len(frame) - 6) // 2}H", frame[2:-4])
+            crc = zlib.crc32(frame[2:-4], crc)
+            frames += 1
+
+        sent = int(trailer.group(1))
+        if sent != frames:
+            print(f"ERROR: Readback lost frames, device sent {sent}, received {frames}")
+            return None
+        if len(samples) != total:
+            print(f"ERROR: Readback short, device stopped at sample {start + len(samples)} of {start + total}")
+            return None
+        if int(trailer.group(2), 16) != crc:
+            print("ERROR: Readback CRC does not match the device")
+            return None
+        return samples
+
+    def set_hrv(self, sdnn_ms, lf_hf_ratio=1.5, resp_rate=15, amplitude_depth_pct=0):
+        """
+        Configure on-device heart rate variability and respiratory modulation.
+
+        Args:
+            sdnn_ms: RR standard deviation (0-250 ms), 0 with depth 0 turns it off
+            lf_hf_ratio: LF/HF power ratio (0.1-10)
+            resp_rate: Breaths per minute (6-40), sets the RSA frequency
+            amplitude_depth_pct: Respiratory beat amplitude modulation (0-50 %)
+        """
+        command = (f"SetHrv {int(sdnn_ms)} {int(round(lf_hf_ratio * 100))} "
+                   f"{int(resp_rate)} {int(amplitude_depth_pct)}\r")
+        return self._expect_ok(command, "HRV configuration")
+
+    def set_artifact(self, artifact, amplitude_uv, parameter=None):
+        """
+        Enable, scale or disable one on-device recording artifact.
+
+        Args:
+            artifact: 'powerline', 'wander', 'emg' or 'motion'
+            amplitude_uv: Peak level at RA-LA (0-1600 uV), 0 turns it off
+            parameter: powerline Hz (40-70), wander Hz (0.05-1.0) or motion
+                steps per minute (1-120); None keeps the device setting
+        """
+        if artifact not in ("powerline", "wander", "emg", "motion"):
+            raise ValueError(f"Unknown artifact: {artifact}")
+
+        command = f"SetArtifact {artifact} {int(amplitude_uv)}"
+        if parameter is not None:
+            if artifact == "wander":
+                parameter = round(parameter * 100)
+            command += f" {int(parameter)}"
+        return self._expect_ok(command + "\r", "Artifact configuration")
+
+    def upload_ecg(self, ecg_data, codec=None, markers=None, binary=True):
         """
         Complete ECG upload sequence.
         
         Args:
             ecg_data: List or array of float values
+            codec: Optional on-device storage codec, see initiate_ecg_download. By default
+                   the cheapest lossless one the samples fit a bank with.
+            markers: Optional annotation track, see send_markers. Without it
+                     the device marks the single largest sample as the R peak.
+            binary: Send samples as binary frames, False for one command per sample
             
         Returns:
             True if upload successful, False otherwise
         """
+        codec = self._fit_codec(ecg_data, codec)
+        if codec is None:
+            return False
+
         try:
             # Step 1: Get firmware info
             if not self.get_firmware_info():
@@ -279,13 +1119,17 @@ class ECGUARTUploader:
             time.sleep(0.5)
             
             # Step 2: Initiate download
-            if not self.initiate_ecg_download(len(ecg_data)):
+            if not self.initiate_ecg_download(len(ecg_data), codec):
+                return False
+
+            if markers and not self.send_markers(markers):
                 return False
             
             time.sleep(0.5)
             
             # Step 3: Send data
-            if not self.send_ecg_data(ecg_data):
+            sent = self.send_ecg_data_binary(ecg_data) if binary else self.send_ecg_data(ecg_data)
+            if not sent or not self.verify_upload(ecg_data, codec):
                 return False
             
             print("\n✓ ECG upload completed successfully!")
@@ -309,7 +1153,7 @@ if __name__ == "__main__":
     minimumLength = int(required_len / 4)
     isolated_ecg = ecg[minimumLength:-minimumLength]
     normalized_ecg = normalize_ecg_endpoints(isolated_ecg)
-    dac_ecg = ecg_to_dac_3mVpp(normalized_ecg)
+    dac_ecg = ecg_to_normalized_codes(normalized_ecg)
     print(f"Generated {len(dac_ecg)} ECG samples\n")
     
     # Configure your COM port here
@@ -320,9 +1164,10 @@ if __name__ == "__main__":
     # Create uploader and connect
     uploader = ECGUARTUploader(port=COM_PORT, baudrate=BAUD_RATE, timeout=2.0)
     
-    if uploader.connect():
+    if uploader.connect(link_baudrate="auto"):
         # Upload ECG data
         uploader.upload_ecg(dac_ecg)
+        uploader.set_amplitude(3.0)
         uploader.disconnect()
     else:
         print("Failed to connect to device")
@@ -0,0 +1,343 @@
+/*
+ * DacCalibration.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "DacCalibration.h"
+#include "Crc32/Crc32.h"
+#include "main.h"
+#include <stddef.h>
+
+#define DAC_CALIBRATION_MAGIC				0x4C414344UL	//"DCAL"
+#define DAC_CALIBRATION_PAGE_SIZE			1024UL
+
+/* Provided by STM32F103C8TX_FLASH.ld */
+extern uint8_t _sdaccal[];
+
+typedef struct{
+	int32_t measuredNv[DAC_CHANNEL_COUNT][DAC_CALIBRATION_KNOT_COUNT];
+	uint32_t knotMask[DAC_CHANNEL_COUNT];
+	bool active;
+}dacCalibrationSession_t;
+
+static dacCalibrationTable_t g_dacCalibrationTable;
+static dacCalibrationSession_t g_dacCalibrationSession;
+
+//Corrected code at every ideal knot code, in 1/256 codes
+static int32_t g_dacCalibrationLut[DAC_CHANNEL_COUNT][DAC_CALIBRATION_KNOT_COUNT];
+
+uint16_t DacCalibrationGetKnotCode(uint8_t knot)
+{
+	uint32_t code = (uint32_t)knot << DAC_CALIBRATION_KNOT_SHIFT;
+	return (code > DAC_MAX_CODE) ? DAC_MAX_CODE : code;
+}
+
+static void setIdealChannel(dacCalibrationTable_t* table, uint8_t channel)
+{
+	table->channelMask &= ~(1UL << channel);
+	table->offsetNv[channel] = 0;
+	table->gainPvPerCode[channel] = DAC_CALIBRATION_IDEAL_PV_PER_CODE;
+	for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+	{
+		table->inlNv[channel][k] = 0;
+	}
+}
+
+static void setIdentityLut(void)
+{
+	for(int i = 0; i < DAC_CHANNEL_COUNT; i++)
+	{
+		for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+		{
+			g_dacCalibrationLut[i][k] = (k << DAC_CALIBRATION_KNOT_SHIFT) << DAC_CALIBRATION_LUT_FRACTION_BITS;
+		}
+	}
+}
+
+static int64_t getLineNv(const dacCalibrationTable_t* table, uint8_t channel, uint8_t knot)
+{
+	return table->offsetNv[channel] +
+			((int64_t)table->gainPvPerCode[channel] * DacCalibrationGetKnotCode(knot)) / 1000;
+}
+
+/**
+ * @brief Inverts the measured curve of a channel: for the ideal voltage of
+ * every knot, the code that gives it. Between knots the curve is linear.
+ * @return false if the measured curve does not rise from knot to knot
+ */
+static bool buildChannelLut(const dacCalibrationTable_t* table, uint8_t channel)
+{
+	int64_t measured[DAC_CALIBRATION_KNOT_COUNT];
+	int32_t lut[DAC_CALIBRATION_KNOT_COUNT];
+
+	for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+	{
+		measured[k] = getLineNv(table, channel, k) + table->inlNv[channel][k];
+		if(k > 0 && measured[k] <= measured[k - 1])
+		{
+			return false;
+		}
+	}
+
+	int segment = 0;
+	for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+	{
+		//Ideal knots run to 4096, past full scale, so the last segment interpolates up to the clamp
+		int64_t targetNv = ((int64_t)(k << DAC_CALIBRATION_KNOT_SHIFT) * DAC_CALIBRATION_IDEAL_PV_PER_CODE) / 1000;
+		while(segment < DAC_CALIBRATION_KNOT_COUNT - 2 && targetNv > measured[segment + 1])
+		{
+			segment++;
+		}
+
+		int64_t segmentCodes = DacCalibrationGetKnotCode(segment + 1) - DacCalibrationGetKnotCode(segment);
+		lut[k] = (int32_t)(((int64_t)DacCalibrationGetKnotCode(segment) << DAC_CALIBRATION_LUT_FRACTION_BITS) +
+				((targetNv - measured[segment]) * (segmentCodes << DAC_CALIBRATION_LUT_FRACTION_BITS)) /
+				(measured[segment + 1] - measured[segment]));
+	}
+
+	for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+	{
+		g_dacCalibrationLut[channel][k] = lut[k];
+	}
+	return true;
+}
+
+static bool buildLut(const dacCalibrationTable_t* table)
+{
+	setIdentityLut();
+	for(int i = 0; i < DAC_CHANNEL_COUNT; i++)
+	{
+		if((table->channelMask & (1UL << i)) && !buildChannelLut(table, i))
+		{
+			setIdentityLut();
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t getTableCrc(const dacCalibrationTable_t* table)
+{
+	return Crc32Update(CRC32_INITIAL_VALUE, (const uint8_t*)table, offsetof(dacCalibrationTable_t, crc));
+}
+
+/**
+ * @brief Loads the stored table, a unit that was never calibrated uses the
+ * ideal transfer
+ */
+void DacCalibrationInit(void)
+{
+	const dacCalibrationTable_t* stored = (const dacCalibrationTable_t*)_sdaccal;
+
+	g_dacCalibrationSession.active = false;
+	if(stored->magic == DAC_CALIBRATION_MAGIC && getTableCrc(stored) == stored->crc)
+	{
+		g_dacCalibrationTable = *stored;
+		if(buildLut(&g_dacCalibrationTable))
+		{
+			return;
+		}
+	}
+
+	g_dacCalibrationTable = (dacCalibrationTable_t){0};
+	for(int i = 0; i < DAC_CHANNEL_COUNT; i++)
+	{
+		setIdealChannel(&g_dacCalibrationTable, i);
+	}
+	setIdentityLut();
+}
+
+/**
+ * @brief Ideal code to corrected code, runs for every sample: two table
+ * reads and one multiply
+ */
+uint16_t DacCalibrationApply(uint8_t channel, uint16_t code)
+{
+	const int32_t* lut = g_dacCalibrationLut[channel];
+	uint32_t knot = code >> DAC_CALIBRATION_KNOT_SHIFT;
+	int32_t fraction = code & ((1 << DAC_CALIBRATION_KNOT_SHIFT) - 1);
+	int32_t value = lut[knot] + (((lut[knot + 1] - lut[knot]) * fraction) >> DAC_CALIBRATION_KNOT_SHIFT);
+
+	value = (value + (1 << (DAC_CALIBRATION_LUT_FRACTION_BITS - 1))) >> DAC_CALIBRATION_LUT_FRACTION_BITS;
+	if(value < 0)
+	{
+		return 0;
+	}
+	return (value > DAC_MAX_CODE) ? DAC_MAX_CODE : (uint16_t)value;
+}
+
+/**
+ * @brief Starts a calibration run. The correction is off until it ends so
+ * the measured points are of raw codes.
+ */
+bool DacCalibrationBegin(void)
+{
+	g_dacCalibrationSession = (dacCalibrationSession_t){0};
+	g_dacCalibrationSession.active = true;
+	setIdentityLut();
+	return true;
+}
+
+/**
+ * @brief Stores the RA–LA voltage measured with the knot code on the channel
+ */
+bool DacCalibrationRecord(uint8_t channel, uint8_t knot, int32_t measuredNv)
+{
+	if(!g_dacCalibrationSession.active || channel >= DAC_CHANNEL_COUNT || knot >= DAC_CALIBRATION_KNOT_COUNT)
+	{
+		return false;
+	}
+
+	g_dacCalibrationSession.measuredNv[channel][knot] = measuredNv;
+	g_dacCalibrationSession.knotMask[channel] |= 1UL << knot;
+	return true;
+}
+
+/**
+ * @brief Fits one channel: the end knots give offset and gain, every
+ * measured knot its INL and knots in between are interpolated
+ * @return false if the channel has points but not both end knots
+ */
+static bool fitChannel(dacCalibrationTable_t* table, uint8_t channel)
+{
+	const int32_t* measured = g_dacCalibrationSession.measuredNv[channel];
+	uint32_t mask = g_dacCalibrationSession.knotMask[channel];
+	int last = DAC_CALIBRATION_KNOT_COUNT - 1;
+
+	if(mask == 0)
+	{
+		setIdealChannel(table, channel);
+		return true;
+	}
+	if(!(mask & 1UL) || !(mask & (1UL << last)))
+	{
+		return false;
+	}
+
+	table->channelMask |= 1UL << channel;
+	table->offsetNv[channel] = measured[0];
+	table->gainPvPerCode[channel] = (int32_t)(((int64_t)(measured[last] - measured[0]) * 1000) / DAC_MAX_CODE);
+
+	int previous = 0;
+	for(int k = 0; k <= last; k++)
+	{
+		if(!(mask & (1UL << k)))
+		{
+			continue;
+		}
+
+		table->inlNv[channel][k] = (int32_t)(measured[k] - getLineNv(table, channel, k));
+		for(int gap = previous + 1; gap < k; gap++)
+		{
+			table->inlNv[channel][gap] = table->inlNv[channel][previous] +
+					((table->inlNv[channel][k] - table->inlNv[channel][previous]) * (gap - previous)) / (k - previous);
+		}
+		previous = k;
+	}
+	return true;
+}
+
+static bool eraseTablePage(void)
+{
+	FLASH_EraseInitTypeDef erase = {
+			.TypeErase = FLASH_TYPEERASE_PAGES,
+			.PageAddress = (uint32_t)_sdaccal,
+			.NbPages = 1
+	};
+	uint32_t pageError;
+
+	HAL_FLASH_Unlock();
+	bool status = (HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK);
+	HAL_FLASH_Lock();
+	return status;
+}
+
+/**
+ * @brief Programs the table, magic last so a cut write reads as uncalibrated
+ */
+static bool storeTable(const dacCalibrationTable_t* table)
+{
+	const uint16_t* halfWords = (const uint16_t*)table;
+	uint32_t magicHalfWords = sizeof(table->magic) / sizeof(uint16_t);
+	uint32_t count = sizeof(*table) / sizeof(uint16_t);
+	bool status;
+
+	if(!eraseTablePage())
+	{
+		return false;
+	}
+
+	HAL_FLASH_Unlock();
+	status = true;
+	for(uint32_t i = magicHalfWords; i < count && status; i++)
+	{
+		status = (HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uint32_t)_sdaccal + i * 2, halfWords[i]) == HAL_OK);
+	}
+	for(uint32_t i = 0; i < magicHalfWords && status; i++)
+	{
+		status = (HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uint32_t)_sdaccal + i * 2, halfWords[i]) == HAL_OK);
+	}
+	HAL_FLASH_Lock();
+	return status;
+}
+
+/**
+ * @brief Ends a calibration run. With save the points are fitted, stored and
+ * applied; otherwise, or if they do not fit, the previous table comes back.
+ */
+bool DacCalibrationEnd(bool save)
+{
+	dacCalibrationTable_t table = {0};
+
+	if(!g_dacCalibrationSession.active)
+	{
+		return false;
+	}
+	g_dacCalibrationSession.active = false;
+
+	bool status = save;
+	for(int i = 0; i < DAC_CHANNEL_COUNT && status; i++)
+	{
+		status = fitChannel(&table, i);
+	}
+	if(status)
+	{
+		table.magic = DAC_CALIBRATION_MAGIC;
+		table.crc = getTableCrc(&table);
+		status = buildLut(&table) && storeTable(&table);
+	}
+	if(status)
+	{
+		g_dacCalibrationTable = table;
+		return true;
+	}
+
+	buildLut(&g_dacCalibrationTable);
+	return !save;
+}
+
+bool DacCalibrationIsActive(void)
+{
+	return g_dacCalibrationSession.active;
+}
+
+/**
+ * @brief Erases the stored table, the outputs go back to the ideal transfer
+ */
+bool DacCalibrationClear(void)
+{
+	if(g_dacCalibrationSession.active || !eraseTablePage())
+	{
+		return false;
+	}
+
+	DacCalibrationInit();
+	return true;
+}
+
+void DacCalibrationGetTable(dacCalibrationTable_t* table)
+{
+	*table = g_dacCalibrationTable;
+}
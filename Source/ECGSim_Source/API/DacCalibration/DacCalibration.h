@@ -0,0 +1,48 @@
+/*
+ * DacCalibration.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Per unit correction of the DAC outputs, measured at RA–LA through the
+ *  divider. Every channel has an end point offset and gain plus the INL at
+ *  17 knots, one every 256 codes. The table lives in the DACCAL flash page
+ *  and is turned into a fixed point map from the ideal code the generator
+ *  asks for to the code that really gives that voltage.
+ */
+
+#ifndef API_DACCALIBRATION_DACCALIBRATION_H_
+#define API_DACCALIBRATION_DACCALIBRATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CommonConfigurations.h"
+
+#define DAC_CALIBRATION_KNOT_SHIFT			8
+#define DAC_CALIBRATION_KNOT_COUNT			((DAC_MAX_CODE >> DAC_CALIBRATION_KNOT_SHIFT) + 2)	//17, the last one at full scale
+#define DAC_CALIBRATION_LUT_FRACTION_BITS	8
+
+/* Ideal RA–LA step of one code in picovolts, about 805060 */
+#define DAC_CALIBRATION_IDEAL_PV_PER_CODE	((DAC_VREF_UV * 1000000LL * DIVIDER_BOTTOM_OHMS) / \
+											((DIVIDER_TOP_OHMS + DIVIDER_BOTTOM_OHMS) * DAC_MAX_CODE))
+
+typedef struct{
+	uint32_t magic;
+	uint32_t channelMask;		//channels that were measured, the others use the ideal line
+	int32_t offsetNv[DAC_CHANNEL_COUNT];		//RA–LA at code 0
+	int32_t gainPvPerCode[DAC_CHANNEL_COUNT];	//end point slope
+	int32_t inlNv[DAC_CHANNEL_COUNT][DAC_CALIBRATION_KNOT_COUNT];	//deviation from that line at each knot
+	uint32_t crc;				//CRC-32 of everything before it
+}dacCalibrationTable_t;
+
+void DacCalibrationInit(void);
+uint16_t DacCalibrationApply(uint8_t channel, uint16_t code);
+uint16_t DacCalibrationGetKnotCode(uint8_t knot);
+bool DacCalibrationBegin(void);
+bool DacCalibrationRecord(uint8_t channel, uint8_t knot, int32_t measuredNv);
+bool DacCalibrationEnd(bool save);
+bool DacCalibrationIsActive(void);
+bool DacCalibrationClear(void);
+void DacCalibrationGetTable(dacCalibrationTable_t* table);
+
+#endif /* API_DACCALIBRATION_DACCALIBRATION_H_ */
@@ -0,0 +1,201 @@
+/*
+ * I2cBus.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "I2cBus.h"
+#include "i2c.h"
+
+
+#define I2C_BUS_SCL_PIN		GPIO_PIN_6
+#define I2C_BUS_SDA_PIN		GPIO_PIN_7
+#define I2C_BUS_PORT		GPIOB
+
+i2cBusHealth_t g_i2cBusHealth;
+uint32_t g_i2cBusConsecutiveNacks = 0;
+I2cBusServiceRequest_t g_i2cBusServiceRequest = NULL;
+
+/**
+ * @brief Sets the function that wakes the task running I2cBusIsStuck and
+ * I2cBusRecover; it is called from interrupt context too
+ */
+void I2cBusSetServiceRequest(I2cBusServiceRequest_t request)
+{
+	g_i2cBusServiceRequest = request;
+}
+
+static void requestService(void)
+{
+	if(g_i2cBusServiceRequest != NULL)
+	{
+		g_i2cBusServiceRequest();
+	}
+}
+
+/**
+ * @brief Counts the causes in a HAL_I2C_ERROR_* mask. Anything but a NACK
+ * means the bus state is suspect and asks for a recovery; NACKs only do
+ * once they keep coming.
+ */
+void I2cBusRecordError(uint32_t halErrorCode)
+{
+	if(halErrorCode & HAL_I2C_ERROR_AF)
+	{
+		g_i2cBusHealth.nacks++;
+		if(++g_i2cBusConsecutiveNacks >= I2C_BUS_NACK_RECOVERY_THRESHOLD)
+		{
+			I2cBusRequestRecovery();
+		}
+	}
+	if(halErrorCode & HAL_I2C_ERROR_TIMEOUT)
+	{
+		g_i2cBusHealth.timeouts++;
+		I2cBusRequestRecovery();
+	}
+	if(halErrorCode & HAL_I2C_ERROR_ARLO)
+	{
+		g_i2cBusHealth.arbitrationLosses++;
+		I2cBusRequestRecovery();
+	}
+	if(halErrorCode & (HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_OVR | HAL_I2C_ERROR_DMA))
+	{
+		g_i2cBusHealth.busErrors++;
+		I2cBusRequestRecovery();
+	}
+}
+
+void I2cBusRecordSuccess(void)
+{
+	g_i2cBusConsecutiveNacks = 0;
+}
+
+static void delayUs(uint32_t us)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t cycles = us * (SystemCoreClock / 1000000UL);
+	while(DWT->CYCCNT - start < cycles);
+}
+
+/**
+ * @brief True when BUSY is set with the peripheral idle, checked without
+ * waiting: a stop condition still finishing or a stuck line. Asks the task
+ * to tell them apart with I2cBusIsStuck; safe from interrupt context.
+ */
+bool I2cBusIsBusy(void)
+{
+	if(hi2c1.State != HAL_I2C_STATE_READY || __HAL_I2C_GET_FLAG(&hi2c1, I2C_FLAG_BUSY) != SET)
+	{
+		return false;
+	}
+	requestService();
+	return true;
+}
+
+/**
+ * @brief True when BUSY stays set with the peripheral idle, i.e. a slave is
+ * holding SDA or SCL low. Waits out the stop condition of the last transfer
+ * first; a stuck bus is counted and flagged for recovery.
+ * @note Task context, busy-waits up to I2C_BUS_STUCK_BUSY_US. A transfer the
+ * sample clock starts meanwhile ends the probe.
+ */
+bool I2cBusIsStuck(void)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t cycles = I2C_BUS_STUCK_BUSY_US * (SystemCoreClock / 1000000UL);
+
+	while(hi2c1.State == HAL_I2C_STATE_READY && __HAL_I2C_GET_FLAG(&hi2c1, I2C_FLAG_BUSY) == SET)
+	{
+		if(DWT->CYCCNT - start > cycles)
+		{
+			g_i2cBusHealth.busy++;
+			I2cBusRequestRecovery();
+			return true;
+		}
+	}
+	return false;
+}
+
+void I2cBusRequestRecovery(void)
+{
+	g_i2cBusHealth.recoveryPending = true;
+	requestService();
+}
+
+bool I2cBusRecoveryPending(void)
+{
+	return g_i2cBusHealth.recoveryPending;
+}
+
+/**
+ * @brief Releases the pins from the peripheral, clocks SCL until the slave
+ * lets SDA go (at most 9 clocks), sends a stop and re-initialises hi2c1 at
+ * its current speed
+ * @note Task context, no transfer may be in flight
+ * @return true if the bus came back idle
+ */
+bool I2cBusRecover(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	g_i2cBusHealth.recoveryPending = false;
+	g_i2cBusConsecutiveNacks = 0;
+
+	HAL_I2C_DeInit(&hi2c1);
+
+	HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SCL_PIN | I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+	GPIO_InitStruct.Pin = I2C_BUS_SCL_PIN | I2C_BUS_SDA_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+	HAL_GPIO_Init(I2C_BUS_PORT, &GPIO_InitStruct);
+	delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+
+	for(int i = 0; i < I2C_BUS_RECOVERY_CLOCKS; i++)
+	{
+		if(HAL_GPIO_ReadPin(I2C_BUS_PORT, I2C_BUS_SDA_PIN) == GPIO_PIN_SET)
+		{
+			break;
+		}
+		HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+		delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+		HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+		delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+	}
+
+	//Stop: SDA rises while SCL is high
+	HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+	delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_RESET);
+	delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+	delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_BUS_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+	delayUs(I2C_BUS_RECOVERY_HALF_PERIOD_US);
+
+	bool linesHigh = HAL_GPIO_ReadPin(I2C_BUS_PORT, I2C_BUS_SCL_PIN) == GPIO_PIN_SET &&
+			HAL_GPIO_ReadPin(I2C_BUS_PORT, I2C_BUS_SDA_PIN) == GPIO_PIN_SET;
+
+	//MspInit gives the pins back to the peripheral, HAL_I2C_Init resets it with SWRST
+	if(HAL_I2C_Init(&hi2c1) != HAL_OK || !linesHigh || __HAL_I2C_GET_FLAG(&hi2c1, I2C_FLAG_BUSY) == SET)
+	{
+		g_i2cBusHealth.failedRecoveries++;
+		return false;
+	}
+
+	g_i2cBusHealth.recovered++;
+	return true;
+}
+
+void I2cBusGetHealth(i2cBusHealth_t* health)
+{
+	*health = g_i2cBusHealth;
+}
+
+void I2cBusResetHealth(void)
+{
+	bool recoveryPending = g_i2cBusHealth.recoveryPending;
+
+	g_i2cBusHealth = (i2cBusHealth_t){0};
+	g_i2cBusHealth.recoveryPending = recoveryPending;
+}
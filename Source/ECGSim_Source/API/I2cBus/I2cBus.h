@@ -0,0 +1,48 @@
+/*
+ * I2cBus.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Health counters and recovery for I2C1. Errors are recorded from the
+ *  transfer paths (interrupt context too); a bus that is stuck or keeps
+ *  failing is flagged, and the probe and recovery run later from a task,
+ *  woken through the service request callback.
+ */
+
+#ifndef API_I2CBUS_I2CBUS_H_
+#define API_I2CBUS_I2CBUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define I2C_BUS_NACK_RECOVERY_THRESHOLD		8		//consecutive NACKs before a recovery is tried
+#define I2C_BUS_STUCK_BUSY_US				100		//BUSY longer than this with no transfer means a stuck line
+#define I2C_BUS_RECOVERY_CLOCKS				9		//enough for a slave to finish any byte and release SDA
+#define I2C_BUS_RECOVERY_HALF_PERIOD_US		5		//100 kHz
+
+typedef struct{
+	uint32_t nacks;
+	uint32_t timeouts;
+	uint32_t arbitrationLosses;
+	uint32_t busErrors;
+	uint32_t busy;				//BUSY stuck with the peripheral idle
+	uint32_t recovered;
+	uint32_t failedRecoveries;
+	bool recoveryPending;
+}i2cBusHealth_t;
+
+typedef void (*I2cBusServiceRequest_t)(void);
+
+void I2cBusSetServiceRequest(I2cBusServiceRequest_t request);
+void I2cBusRecordError(uint32_t halErrorCode);
+void I2cBusRecordSuccess(void);
+bool I2cBusIsBusy(void);
+bool I2cBusIsStuck(void);
+void I2cBusRequestRecovery(void);
+bool I2cBusRecoveryPending(void);
+bool I2cBusRecover(void);
+void I2cBusGetHealth(i2cBusHealth_t* health);
+void I2cBusResetHealth(void);
+
+#endif /* API_I2CBUS_I2CBUS_H_ */
@@ -0,0 +1,66 @@
+/*
+ * SampleClock.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "SampleClock.h"
+#include "tim.h"
+
+
+static SampleClockCallback_t g_sampleClockCallback = NULL;
+static uint32_t g_sampleClockRate = SAMPLE_CLOCK_DEFAULT_RATE_HZ;
+
+
+bool SampleClockInit(SampleClockCallback_t callback)
+{
+	if(!IS_VALID_PNTR(callback))
+	{
+		return false;
+	}
+
+	g_sampleClockCallback = callback;
+	return SampleClockSetRate(g_sampleClockRate);
+}
+
+bool SampleClockStart(void)
+{
+	__HAL_TIM_CLEAR_FLAG(&htim3, TIM_FLAG_UPDATE);
+	return HAL_TIM_Base_Start_IT(&htim3) == HAL_OK;
+}
+
+void SampleClockStop(void)
+{
+	HAL_TIM_Base_Stop_IT(&htim3);
+}
+
+/**
+ * @brief Retunes the sample clock. ARR is preloaded, so the new period takes
+ * effect on the next update event without a short or long sample.
+ */
+bool SampleClockSetRate(uint32_t rateHz)
+{
+	if(rateHz < SAMPLE_CLOCK_MIN_RATE_HZ || rateHz > SAMPLE_CLOCK_MAX_RATE_HZ)
+	{
+		return false;
+	}
+
+	uint32_t period = (SAMPLE_CLOCK_TIMER_FREQUENCY_HZ + rateHz / 2) / rateHz;
+	__HAL_TIM_SET_AUTORELOAD(&htim3, period - 1);
+	g_sampleClockRate = SAMPLE_CLOCK_TIMER_FREQUENCY_HZ / period;
+	return true;
+}
+
+uint32_t SampleClockGetRate(void)
+{
+	return g_sampleClockRate;
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	if(htim->Instance == TIM3 && g_sampleClockCallback != NULL)
+	{
+		g_sampleClockCallback();
+	}
+}
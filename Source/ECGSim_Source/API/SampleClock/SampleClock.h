@@ -0,0 +1,30 @@
+/*
+ * SampleClock.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#ifndef API_SAMPLECLOCK_SAMPLECLOCK_H_
+#define API_SAMPLECLOCK_SAMPLECLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* TIM3 runs off the 36 MHz APB1 timer clock with a prescaler of 36 */
+#define SAMPLE_CLOCK_TIMER_FREQUENCY_HZ		1000000UL
+
+#define SAMPLE_CLOCK_MIN_RATE_HZ			250UL
+#define SAMPLE_CLOCK_MAX_RATE_HZ			8000UL
+#define SAMPLE_CLOCK_DEFAULT_RATE_HZ		1000UL
+
+/* Called from the TIM3 update interrupt, keep it short and non-blocking */
+typedef void (*SampleClockCallback_t)(void);
+
+bool SampleClockInit(SampleClockCallback_t callback);
+bool SampleClockStart(void);
+void SampleClockStop(void);
+bool SampleClockSetRate(uint32_t rateHz);
+uint32_t SampleClockGetRate(void);
+
+#endif /* API_SAMPLECLOCK_SAMPLECLOCK_H_ */
@@ -0,0 +1,75 @@
+/*
+ * CaptureBackend.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "VoltageControllerBackend.h"
+#include "Crc32/Crc32.h"
+
+
+voltageControllerCaptureStats_t g_captureStats;
+
+static bool captureInit(void)
+{
+	VoltageControllerResetCapture();
+	return true;
+}
+
+static bool captureWrite(const uint16_t* frame)
+{
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		uint8_t code[2] = {(uint8_t)frame[i], (uint8_t)(frame[i] >> 8)};
+		g_captureStats.crc = Crc32Update(g_captureStats.crc, code, sizeof(code));
+		g_captureStats.lastFrame[i] = frame[i];
+	}
+	g_captureStats.frames++;
+	return true;
+}
+
+static uint32_t captureWriteBlock(const uint16_t* frames, uint32_t frameCount)
+{
+	for(uint32_t i = 0; i < frameCount; i++)
+	{
+		captureWrite(&frames[i * VOLTAGE_CONTROLLER_CHANNEL_COUNT]);
+	}
+	return frameCount;
+}
+
+static void captureFlush(void)
+{
+}
+
+static void captureGetCapabilities(voltageBackendCapabilities_t* capabilities)
+{
+	capabilities->channelCount = VOLTAGE_CONTROLLER_CHANNEL_COUNT;
+	capabilities->resolutionBits = DAC_BITS;
+	capabilities->maxRateHz = 0;
+	capabilities->flags = VOLTAGE_BACKEND_FLAG_NO_OUTPUT;
+}
+
+const voltageBackend_t g_captureBackend = {
+		.name = "capture",
+		.init = captureInit,
+		.write = captureWrite,
+		.writeBlock = captureWriteBlock,
+		.flush = captureFlush,
+		.getCapabilities = captureGetCapabilities
+};
+
+/**
+ * @brief Snapshot of the capture sink; the sample interrupt may add a frame
+ * between fields, read it with the sample clock stopped for an exact match
+ */
+void VoltageControllerGetCaptureStats(voltageControllerCaptureStats_t* stats)
+{
+	*stats = g_captureStats;
+}
+
+void VoltageControllerResetCapture(void)
+{
+	g_captureStats = (voltageControllerCaptureStats_t){0};
+	g_captureStats.crc = CRC32_INITIAL_VALUE;
+}
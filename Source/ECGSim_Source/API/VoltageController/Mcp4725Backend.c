@@ -0,0 +1,451 @@
+/*
+ * Mcp4725Backend.c
+ *
+ *  Created on: 26-Dec-2025
+ *      Author: mohammed
+ */
+
+#include "VoltageControllerBackend.h"
+#include "i2c.h"
+#include "MCP4725.h"
+#include "I2cBus/I2cBus.h"
+#include "DacCalibration/DacCalibration.h"
+
+
+static const MCP4725Ax_ADDRESS g_voltageControllerAddresses[VOLTAGE_CONTROLLER_CHANNEL_COUNT] = {
+		MCP4725A0_ADDR_A00,
+		MCP4725A0_ADDR_A01
+};
+
+MCP4725 VoltageControllerDevices[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+voltageControllerSkewStats_t g_voltageControllerSkew;
+
+//Async frame: channels are chained from the write completion interrupt
+uint16_t g_voltageControllerFrame[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+volatile uint8_t g_voltageControllerFrameChannel;
+volatile bool g_voltageControllerFrameBusy = false;
+uint32_t g_voltageControllerFrameFirstWrite;
+uint32_t g_voltageControllerFrameStart;
+
+//Continuous output
+uint8_t g_voltageControllerRing[VOLTAGE_CONTROLLER_STREAM_RING_WRITES * MCP4725_FAST_WRITE_BYTES];
+VoltageControllerFrameSource_t g_voltageControllerSource = NULL;
+VoltageControllerStreamStopped_t g_voltageControllerStopped = NULL;
+uint32_t g_voltageControllerStreamRate = 0;
+uint32_t g_voltageControllerSpeedBeforeStream;
+
+/**
+ * @brief Worst case skew of a frame: every write after the first one at the
+ * configured bus speed, plus preemption margin
+ */
+static uint32_t getSkewLimitUs(void)
+{
+	uint32_t bitTimeNs = 1000000000UL / hi2c1.Init.ClockSpeed;
+	return ((VOLTAGE_CONTROLLER_CHANNEL_COUNT - 1) * VOLTAGE_CONTROLLER_FAST_WRITE_BITS * bitTimeNs) / 1000UL +
+			VOLTAGE_CONTROLLER_SKEW_MARGIN_US;
+}
+
+static bool mcp4725Init(void)
+{
+	MX_I2C1_Init();
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		VoltageControllerDevices[i] = MCP4725_init(&hi2c1, g_voltageControllerAddresses[i], REF_VOLTAGE);
+	}
+
+	VoltageControllerResetSkewStats();
+	return true;
+}
+
+/**
+ * @brief True when every channel answers
+ */
+bool VoltageControllerProbe()
+{
+	for(uint8_t i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		if(!VoltageControllerProbeChannel(i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool VoltageControllerProbeChannel(uint8_t channel)
+{
+	if(channel >= VOLTAGE_CONTROLLER_CHANNEL_COUNT)
+	{
+		return false;
+	}
+	return MCP4725_isConnected(&VoltageControllerDevices[channel]);
+}
+
+static void recordFrameSkew(uint32_t firstWrite, uint32_t lastWrite)
+{
+	uint32_t skewUs = (lastWrite - firstWrite) / (SystemCoreClock / 1000000UL);
+	g_voltageControllerSkew.frames++;
+	g_voltageControllerSkew.lastSkewUs = skewUs;
+	if(skewUs > g_voltageControllerSkew.maxSkewUs)
+	{
+		g_voltageControllerSkew.maxSkewUs = skewUs;
+	}
+	if(skewUs > g_voltageControllerSkew.limitUs)
+	{
+		g_voltageControllerSkew.overLimit++;
+	}
+}
+
+/**
+ * @brief Write completion of one channel, runs from the I2C interrupt and
+ * starts the next channel of the frame
+ */
+static void frameWriteComplete(MCP4725* device, uint8_t success)
+{
+	uint32_t now = DWT->CYCCNT;
+	uint8_t channel = g_voltageControllerFrameChannel;
+
+	if(!success)
+	{
+		g_voltageControllerSkew.writeErrors++;
+		I2cBusRecordError(device->hi2c->ErrorCode);
+	}
+	else
+	{
+		I2cBusRecordSuccess();
+	}
+	if(channel == 0)
+	{
+		g_voltageControllerFrameFirstWrite = now;
+	}
+
+	channel++;
+	g_voltageControllerFrameChannel = channel;
+	if(channel < VOLTAGE_CONTROLLER_CHANNEL_COUNT)
+	{
+		if(MCP4725_setValueAsync(&VoltageControllerDevices[channel], g_voltageControllerFrame[channel],
+				MCP4725_POWER_DOWN_OFF, frameWriteComplete))
+		{
+			return;
+		}
+		g_voltageControllerSkew.writeErrors++;
+		I2cBusRecordError(hi2c1.ErrorCode);
+	}
+	else
+	{
+		recordFrameSkew(g_voltageControllerFrameFirstWrite, now);
+	}
+	g_voltageControllerFrameBusy = false;
+}
+
+/**
+ * @brief Starts a frame write with DMA and returns at once, the remaining
+ * channels are chained from the completion interrupt
+ * @param values one raw DAC code per channel, channel 0 first
+ * @return false if the previous frame is still in flight, the bus refused
+ * the transfer or it waits for recovery; the frame is dropped
+ * @note Call from the I2C interrupt priority (the sample clock tick)
+ */
+static bool startFrame(const uint16_t* values)
+{
+	if(g_voltageControllerFrameBusy)
+	{
+		//A frame that never completes means a slave holds the bus
+		if(!I2cBusRecoveryPending() && DWT->CYCCNT - g_voltageControllerFrameStart >
+				VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS * (SystemCoreClock / 1000UL))
+		{
+			I2cBusRecordError(HAL_I2C_ERROR_TIMEOUT);
+		}
+		return false;
+	}
+	//A busy bus is left to the task to probe, the tick never waits on it
+	if(I2cBusRecoveryPending() || I2cBusIsBusy())
+	{
+		g_voltageControllerSkew.writeErrors++;
+		return false;
+	}
+
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		g_voltageControllerFrame[i] = values[i];
+	}
+	g_voltageControllerFrameChannel = 0;
+	g_voltageControllerFrameStart = DWT->CYCCNT;
+	g_voltageControllerFrameBusy = true;
+
+	if(!MCP4725_setValueAsync(&VoltageControllerDevices[0], g_voltageControllerFrame[0],
+			MCP4725_POWER_DOWN_OFF, frameWriteComplete))
+	{
+		g_voltageControllerFrameBusy = false;
+		g_voltageControllerSkew.writeErrors++;
+		I2cBusRecordError(hi2c1.ErrorCode);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Backend write: the codes go through the calibration of the unit
+ * first, so they give the voltage the generator asked for
+ */
+static bool mcp4725Write(const uint16_t* values)
+{
+	uint16_t codes[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		codes[i] = DacCalibrationApply(i, values[i]);
+	}
+	return startFrame(codes);
+}
+
+/**
+ * @brief Waits up to timeoutMs for the async frame in flight to complete
+ */
+static bool waitForIdle(uint32_t timeoutMs)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t timeout = timeoutMs * (SystemCoreClock / 1000UL);
+
+	while(g_voltageControllerFrameBusy)
+	{
+		if(DWT->CYCCNT - start > timeout)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Writes frames one after another, each as soon as the last completed
+ */
+static uint32_t mcp4725WriteBlock(const uint16_t* frames, uint32_t frameCount)
+{
+	uint32_t written = 0;
+
+	for(uint32_t i = 0; i < frameCount; i++)
+	{
+		if(!waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS))
+		{
+			break;
+		}
+		if(mcp4725Write(&frames[i * VOLTAGE_CONTROLLER_CHANNEL_COUNT]))
+		{
+			written++;
+		}
+	}
+	return written;
+}
+
+static void mcp4725Flush(void)
+{
+	waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS);
+}
+
+static void mcp4725GetCapabilities(voltageBackendCapabilities_t* capabilities)
+{
+	capabilities->channelCount = VOLTAGE_CONTROLLER_CHANNEL_COUNT;
+	capabilities->resolutionBits = MCP4725_RESOLUTION;
+	capabilities->maxRateHz = hi2c1.Init.ClockSpeed / (VOLTAGE_CONTROLLER_CHANNEL_COUNT * VOLTAGE_CONTROLLER_FAST_WRITE_BITS);
+	capabilities->flags = VOLTAGE_BACKEND_FLAG_ASYNC | VOLTAGE_BACKEND_FLAG_I2C;
+}
+
+const voltageBackend_t g_mcp4725Backend = {
+		.name = "dac",
+		.init = mcp4725Init,
+		.write = mcp4725Write,
+		.writeBlock = mcp4725WriteBlock,
+		.flush = mcp4725Flush,
+		.getCapabilities = mcp4725GetCapabilities
+};
+
+/**
+ * @brief Switches the bus between standard and fast mode
+ * @note The sample clock must be stopped so no frame starts during the switch
+ */
+bool VoltageControllerSetBusSpeed(uint32_t clockSpeed)
+{
+	if((clockSpeed != VOLTAGE_CONTROLLER_BUS_SPEED_STANDARD && clockSpeed != VOLTAGE_CONTROLLER_BUS_SPEED_FAST) ||
+			MCP4725_isStreaming())
+	{
+		return false;
+	}
+	if(!waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS) || I2C1_SetClockSpeed(clockSpeed) != HAL_OK)
+	{
+		return false;
+	}
+
+	g_voltageControllerSkew.limitUs = getSkewLimitUs();
+	return true;
+}
+
+uint32_t VoltageControllerGetBusSpeed(void)
+{
+	return hi2c1.Init.ClockSpeed;
+}
+
+/**
+ * @brief Self-test: writes frames back-to-back through the async path for
+ * windowMs and reports how many completed per second at the current speed.
+ * The last frame is rewritten so the outputs hold still.
+ * @note The sample clock must be stopped
+ */
+void VoltageControllerMeasureUpdateRate(uint32_t windowMs, voltageControllerRateTest_t* result)
+{
+	uint16_t frame[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+	uint32_t window = windowMs * (SystemCoreClock / 1000UL);
+	uint32_t framesBefore = g_voltageControllerSkew.frames;
+	uint32_t errorsBefore = g_voltageControllerSkew.writeErrors;
+
+	waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS);
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		frame[i] = g_voltageControllerFrame[i];
+	}
+
+	uint32_t start = DWT->CYCCNT;
+	while(DWT->CYCCNT - start < window)
+	{
+		if(!g_voltageControllerFrameBusy)
+		{
+			startFrame(frame);
+		}
+	}
+	waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS);
+
+	result->clockSpeed = hi2c1.Init.ClockSpeed;
+	result->framesPerSecond = ((g_voltageControllerSkew.frames - framesBefore) * 1000UL) / windowMs;
+	result->writeErrors = g_voltageControllerSkew.writeErrors - errorsBefore;
+}
+
+/**
+ * @brief Fills part of the ring with fast writes of lead 0, runs from the
+ * DMA interrupt for the half that was just sent
+ */
+static void fillStreamRing(uint8_t* buffer, uint16_t length)
+{
+	uint16_t frame[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+
+	for(uint16_t i = 0; i < length; i += MCP4725_FAST_WRITE_BYTES)
+	{
+		if(g_voltageControllerSource(frame))
+		{
+			g_voltageControllerFrame[0] = DacCalibrationApply(0, frame[0]);
+		}
+		MCP4725_packFastWrite(&buffer[i], g_voltageControllerFrame[0], MCP4725_POWER_DOWN_OFF);
+	}
+}
+
+static void streamRefill(MCP4725* device, uint8_t* buffer, uint16_t length)
+{
+	fillStreamRing(buffer, length);
+}
+
+static void streamStopped(MCP4725* device, uint8_t success)
+{
+	//A DMA error stops the stream without an I2C error code
+	I2cBusRecordError(hi2c1.ErrorCode != HAL_I2C_ERROR_NONE ? hi2c1.ErrorCode : HAL_I2C_ERROR_DMA);
+	g_voltageControllerSkew.writeErrors++;
+	g_voltageControllerStreamRate = 0;
+	I2C1_SetClockSpeed(g_voltageControllerSpeedBeforeStream);
+	if(g_voltageControllerStopped != NULL)
+	{
+		g_voltageControllerStopped();
+	}
+}
+
+/**
+ * @brief Achieved update rate, from the SCL the CCR divider really gives
+ */
+static uint32_t getStreamRate(void)
+{
+	uint32_t ccr = hi2c1.Instance->CCR & I2C_CCR_CCR;
+	uint32_t divider = (hi2c1.Instance->CCR & I2C_CCR_FS) ? 3 : 2;
+	return HAL_RCC_GetPCLK1Freq() / (divider * ccr * MCP4725_STREAM_BITS_PER_WRITE);
+}
+
+/**
+ * @brief Switches to continuous output at rateHz: the bus is reclocked to
+ * 18 SCL clocks per sample and lead 0 streams without start, address and stop
+ * @note The sample clock must be stopped; the other channels hold their value
+ */
+bool VoltageControllerStartStream(uint32_t rateHz, VoltageControllerFrameSource_t source, VoltageControllerStreamStopped_t stopped)
+{
+	uint32_t clockSpeed = rateHz * MCP4725_STREAM_BITS_PER_WRITE;
+
+	if(source == NULL || MCP4725_isStreaming() || VoltageControllerGetBackend() != VOLTAGE_BACKEND_MCP4725 ||
+			clockSpeed < VOLTAGE_CONTROLLER_STREAM_MIN_SCL_HZ || clockSpeed > VOLTAGE_CONTROLLER_BUS_SPEED_FAST)
+	{
+		return false;
+	}
+	if(!waitForIdle(VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS))
+	{
+		return false;
+	}
+
+	g_voltageControllerSpeedBeforeStream = hi2c1.Init.ClockSpeed;
+	g_voltageControllerSource = source;
+	g_voltageControllerStopped = stopped;
+	fillStreamRing(g_voltageControllerRing, sizeof(g_voltageControllerRing));
+
+	if(I2C1_SetClockSpeed(clockSpeed) != HAL_OK ||
+			!MCP4725_startStream(&VoltageControllerDevices[0], g_voltageControllerRing, sizeof(g_voltageControllerRing),
+					streamRefill, streamStopped))
+	{
+		I2C1_SetClockSpeed(g_voltageControllerSpeedBeforeStream);
+		return false;
+	}
+
+	g_voltageControllerStreamRate = getStreamRate();
+	return true;
+}
+
+void VoltageControllerStopStream(void)
+{
+	if(!MCP4725_isStreaming())
+	{
+		return;
+	}
+
+	MCP4725_stopStream();
+	g_voltageControllerStreamRate = 0;
+	I2C1_SetClockSpeed(g_voltageControllerSpeedBeforeStream);
+}
+
+bool VoltageControllerIsStreaming(void)
+{
+	return MCP4725_isStreaming();
+}
+
+uint32_t VoltageControllerGetStreamRate(void)
+{
+	return g_voltageControllerStreamRate;
+}
+
+/**
+ * @brief Frees a stuck or failing bus: drops the transfer in flight, clocks
+ * the slaves free and re-initialises I2C1 at the speed it had
+ * @note The sample clock must be stopped
+ */
+bool VoltageControllerRecoverBus(void)
+{
+	VoltageControllerStopStream();
+	MCP4725_abortAsync();
+	g_voltageControllerFrameBusy = false;
+
+	bool recovered = I2cBusRecover();
+	g_voltageControllerSkew.limitUs = getSkewLimitUs();
+	return recovered;
+}
+
+void VoltageControllerGetSkewStats(voltageControllerSkewStats_t* stats)
+{
+	*stats = g_voltageControllerSkew;
+}
+
+void VoltageControllerResetSkewStats(void)
+{
+	g_voltageControllerSkew = (voltageControllerSkewStats_t){0};
+	g_voltageControllerSkew.limitUs = getSkewLimitUs();
+}
@@ -0,0 +1,87 @@
+/*
+ * PwmBackend.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "VoltageControllerBackend.h"
+#include "tim.h"
+
+
+#define PWM_BACKEND_SHIFT		(DAC_BITS - VOLTAGE_CONTROLLER_PWM_RESOLUTION_BITS)
+
+static const uint32_t g_pwmBackendChannels[VOLTAGE_CONTROLLER_CHANNEL_COUNT] = {
+		TIM_CHANNEL_3,
+		TIM_CHANNEL_4
+};
+
+/**
+ * @brief Timer clock of TIM4, doubled by the APB1 prescaler when it divides
+ */
+static uint32_t getTimerClock(void)
+{
+	uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+	return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2 * pclk1;
+}
+
+static bool pwmInit(void)
+{
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		if(HAL_TIM_PWM_Start(&htim4, g_pwmBackendChannels[i]) != HAL_OK &&
+				TIM_CHANNEL_STATE_GET(&htim4, g_pwmBackendChannels[i]) != HAL_TIM_CHANNEL_STATE_BUSY)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Compare registers are preloaded, so every channel switches together
+ * on the next carrier period and no bus time is spent
+ */
+static bool pwmWrite(const uint16_t* frame)
+{
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		__HAL_TIM_SET_COMPARE(&htim4, g_pwmBackendChannels[i], frame[i] >> PWM_BACKEND_SHIFT);
+	}
+	return true;
+}
+
+/**
+ * @brief One frame per carrier period
+ */
+static uint32_t pwmWriteBlock(const uint16_t* frames, uint32_t frameCount)
+{
+	for(uint32_t i = 0; i < frameCount; i++)
+	{
+		__HAL_TIM_CLEAR_FLAG(&htim4, TIM_FLAG_UPDATE);
+		pwmWrite(&frames[i * VOLTAGE_CONTROLLER_CHANNEL_COUNT]);
+		while(__HAL_TIM_GET_FLAG(&htim4, TIM_FLAG_UPDATE) == RESET);
+	}
+	return frameCount;
+}
+
+static void pwmFlush(void)
+{
+}
+
+static void pwmGetCapabilities(voltageBackendCapabilities_t* capabilities)
+{
+	capabilities->channelCount = VOLTAGE_CONTROLLER_CHANNEL_COUNT;
+	capabilities->resolutionBits = VOLTAGE_CONTROLLER_PWM_RESOLUTION_BITS;
+	capabilities->maxRateHz = getTimerClock() / ((htim4.Instance->PSC + 1) * (htim4.Instance->ARR + 1));
+	capabilities->flags = 0;
+}
+
+const voltageBackend_t g_pwmBackend = {
+		.name = "pwm",
+		.init = pwmInit,
+		.write = pwmWrite,
+		.writeBlock = pwmWriteBlock,
+		.flush = pwmFlush,
+		.getCapabilities = pwmGetCapabilities
+};
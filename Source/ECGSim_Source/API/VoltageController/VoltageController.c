@@ -5,30 +5,142 @@
  *      Author: mohammed
  */
 
-#include "VoltageController.h"
-#include "i2c.h"
-#include "MCP4725.h"
+#include "VoltageControllerBackend.h"
+#include "main.h"
+#include <string.h>
 
 
-MCP4725 VoltageControllerDevice;
+static const voltageBackend_t* const g_voltageControllerBackends[VOLTAGE_BACKEND_COUNT] = {
+		&g_mcp4725Backend,
+		&g_pwmBackend,
+		&g_captureBackend
+};
 
-void VoltageControllerInit()
+const voltageBackend_t* g_voltageBackend = NULL;
+voltageBackendType_t g_voltageBackendType = VOLTAGE_CONTROLLER_DEFAULT_BACKEND;
+uint16_t g_voltageControllerLastFrame[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+
+/**
+ * @brief Selects and initialises the output backend. Writes in flight on the
+ * previous backend are flushed first; it keeps its last output.
+ * @note Stop the sample clock around a switch
+ */
+bool VoltageControllerInit(voltageBackendType_t backend)
+{
+	if(backend >= VOLTAGE_BACKEND_COUNT)
+	{
+		return false;
+	}
+
+	//Cycle counter timestamps writes and benchmarks
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	if(g_voltageBackend != NULL)
+	{
+		g_voltageBackend->flush();
+	}
+	if(!g_voltageControllerBackends[backend]->init())
+	{
+		return false;
+	}
+
+	g_voltageBackend = g_voltageControllerBackends[backend];
+	g_voltageBackendType = backend;
+	return true;
+}
+
+voltageBackendType_t VoltageControllerGetBackend(void)
+{
+	return g_voltageBackendType;
+}
+
+const char* VoltageControllerGetBackendName(voltageBackendType_t backend)
+{
+	if(backend >= VOLTAGE_BACKEND_COUNT)
+	{
+		return "";
+	}
+	return g_voltageControllerBackends[backend]->name;
+}
+
+bool VoltageControllerBackendFromName(const char* name, voltageBackendType_t* backend)
 {
-	 MX_I2C1_Init();
-	 VoltageControllerDevice = MCP4725_init(&hi2c1, MCP4725A0_ADDR_A00, REF_VOLTAGE);
+	for(int i = 0; i < VOLTAGE_BACKEND_COUNT; i++)
+	{
+		if(strcmp(name, g_voltageControllerBackends[i]->name) == 0)
+		{
+			*backend = (voltageBackendType_t)i;
+			return true;
+		}
+	}
+	return false;
 }
 
-bool VoltageControllerProbe()
+void VoltageControllerGetCapabilities(voltageBackendCapabilities_t* capabilities)
 {
-	return MCP4725_isConnected(&VoltageControllerDevice);
+	g_voltageBackend->getCapabilities(capabilities);
 }
 
+/**
+ * @brief Sets lead 0, the other channels keep their last value
+ */
 void VoltageControllerSetRawVoltage(uint16_t value)
 {
-	MCP4725_setValue(&VoltageControllerDevice, value, MCP4725_FAST_MODE, MCP4725_POWER_DOWN_OFF);
+	g_voltageControllerLastFrame[0] = value;
+	VoltageControllerWriteBlock(g_voltageControllerLastFrame, 1);
 }
 
 void VoltageControllerSetVoltage(float value)
 {
-	MCP4725_setVoltage(&VoltageControllerDevice, value, MCP4725_FAST_MODE, MCP4725_POWER_DOWN_OFF);
+	if(value <= 0)
+	{
+		VoltageControllerSetRawVoltage(0);
+	}
+	else if(value >= REF_VOLTAGE)
+	{
+		VoltageControllerSetRawVoltage(DAC_MAX_CODE);
+	}
+	else
+	{
+		VoltageControllerSetRawVoltage((uint16_t)(value * (DAC_MAX_CODE + 1) / REF_VOLTAGE));
+	}
+}
+
+/**
+ * @brief Hands one frame to the backend without waiting for the output
+ * @param values one 12-bit code per channel, channel 0 first
+ * @return false if the backend dropped the frame (still busy with the last)
+ * @note Called from the sample clock interrupt
+ */
+bool VoltageControllerWriteFrameAsync(const uint16_t* values)
+{
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		g_voltageControllerLastFrame[i] = values[i];
+	}
+	return g_voltageBackend->write(values);
+}
+
+/**
+ * @brief Writes consecutive frames as fast as the backend updates, for
+ * benchmarks and one-off writes from task context
+ * @return frames written
+ */
+uint32_t VoltageControllerWriteBlock(const uint16_t* frames, uint32_t frameCount)
+{
+	if(frameCount == 0)
+	{
+		return 0;
+	}
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		g_voltageControllerLastFrame[i] = frames[(frameCount - 1) * VOLTAGE_CONTROLLER_CHANNEL_COUNT + i];
+	}
+	return g_voltageBackend->writeBlock(frames, frameCount);
+}
+
+void VoltageControllerFlush(void)
+{
+	g_voltageBackend->flush();
 }
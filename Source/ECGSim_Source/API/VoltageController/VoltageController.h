@@ -10,12 +10,120 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "CommonConfigurations.h"
 
 #define REF_VOLTAGE			3.30
 
-void VoltageControllerInit(void);
-bool VoltageControllerProbe(void);
+/*
+ * Output backends, chosen at init. Every backend takes frames of 12-bit codes,
+ * one per channel, and scales them to its own resolution.
+ */
+typedef enum{
+	VOLTAGE_BACKEND_MCP4725 = 0,	//one MCP4725 per lead on I2C1
+	VOLTAGE_BACKEND_PWM,			//TIM4 CH3/CH4 on PB8/PB9 into an RC filter
+	VOLTAGE_BACKEND_CAPTURE,		//in-memory sink, no output
+	VOLTAGE_BACKEND_COUNT
+}voltageBackendType_t;
+
+#ifndef VOLTAGE_CONTROLLER_DEFAULT_BACKEND
+#define VOLTAGE_CONTROLLER_DEFAULT_BACKEND		VOLTAGE_BACKEND_MCP4725
+#endif
+
+#define VOLTAGE_BACKEND_FLAG_ASYNC				0x01	//write returns before the output changes, flush waits
+#define VOLTAGE_BACKEND_FLAG_I2C				0x02	//bus speed, self-test and continuous output apply
+#define VOLTAGE_BACKEND_FLAG_NO_OUTPUT			0x04
+
+typedef struct{
+	uint8_t channelCount;
+	uint8_t resolutionBits;
+	uint32_t maxRateHz;		//highest frame rate, 0 when unbounded
+	uint32_t flags;
+}voltageBackendCapabilities_t;
+
+/*
+ * PWM backend: 10-bit at the 36 MHz timer clock gives a 35 kHz carrier, and
+ * a new duty takes effect on the next period. Two RC poles around 1 kHz keep
+ * the carrier ripple under one code.
+ */
+#define VOLTAGE_CONTROLLER_PWM_RESOLUTION_BITS	10
+
+/* Capture backend: counts and checksums every frame, so output can be compared with the host */
+typedef struct{
+	uint32_t frames;
+	uint32_t crc;			//CRC-32 over the frames as little-endian 16-bit codes
+	uint16_t lastFrame[DAC_CHANNEL_COUNT];
+}voltageControllerCaptureStats_t;
+
+/*
+ * One MCP4725 per lead on the same bus. A frame updates every channel
+ * back-to-back; the DAC output changes on the last data byte of its write,
+ * so the skew between leads is the time between the first and last write.
+ */
+#define VOLTAGE_CONTROLLER_CHANNEL_COUNT		DAC_CHANNEL_COUNT
+#define VOLTAGE_CONTROLLER_FAST_WRITE_BITS		29		//start, address, 2 data bytes with acks, stop
+#define VOLTAGE_CONTROLLER_SKEW_MARGIN_US		50		//interrupt latency between chained writes
+
+/*
+ * Bus speeds selectable at runtime. The MCP4725 also accepts high-speed mode
+ * (master code 0x08 at fast speed, then up to 3.4 MHz) but the F1 I2C master
+ * stops at 400 kHz, so that entry is not offered on this bus.
+ */
+#define VOLTAGE_CONTROLLER_BUS_SPEED_STANDARD	100000UL
+#define VOLTAGE_CONTROLLER_BUS_SPEED_FAST		400000UL
+#define VOLTAGE_CONTROLLER_BUS_IDLE_TIMEOUT_MS	10
+
+/*
+ * Continuous output: lead 0 is streamed as one open transaction of fast
+ * writes, the bus clock is set to 18 SCL clocks per sample and paces the
+ * output in place of the sample clock. The other channels hold their value.
+ */
+#define VOLTAGE_CONTROLLER_STREAM_RING_WRITES	64		//refilled a half at a time from the DMA interrupt
+#define VOLTAGE_CONTROLLER_STREAM_MIN_SCL_HZ	4500UL	//12-bit CCR limit at 36 MHz PCLK1
+
+/* Produces the next frame from the DMA interrupt, false repeats the last one */
+typedef bool (*VoltageControllerFrameSource_t)(uint16_t* values);
+/* A bus error ended the stream, runs from interrupt context */
+typedef void (*VoltageControllerStreamStopped_t)(void);
+
+typedef struct{
+	uint32_t clockSpeed;
+	uint32_t framesPerSecond;	//complete frames, the highest usable sample rate
+	uint32_t writeErrors;
+}voltageControllerRateTest_t;
+
+typedef struct{
+	uint32_t frames;
+	uint32_t lastSkewUs;
+	uint32_t maxSkewUs;
+	uint32_t limitUs;		//expected worst case for the bus speed
+	uint32_t overLimit;		//frames whose skew exceeded limitUs
+	uint32_t writeErrors;
+}voltageControllerSkewStats_t;
+
+bool VoltageControllerInit(voltageBackendType_t backend);
+voltageBackendType_t VoltageControllerGetBackend(void);
+const char* VoltageControllerGetBackendName(voltageBackendType_t backend);
+bool VoltageControllerBackendFromName(const char* name, voltageBackendType_t* backend);
+void VoltageControllerGetCapabilities(voltageBackendCapabilities_t* capabilities);
 void VoltageControllerSetRawVoltage(uint16_t value);
 void VoltageControllerSetVoltage(float value);
+bool VoltageControllerWriteFrameAsync(const uint16_t* values);
+uint32_t VoltageControllerWriteBlock(const uint16_t* frames, uint32_t frameCount);
+void VoltageControllerFlush(void);
+void VoltageControllerGetCaptureStats(voltageControllerCaptureStats_t* stats);
+void VoltageControllerResetCapture(void);
+
+bool VoltageControllerProbe(void);
+bool VoltageControllerProbeChannel(uint8_t channel);
+bool VoltageControllerSetBusSpeed(uint32_t clockSpeed);
+uint32_t VoltageControllerGetBusSpeed(void);
+void VoltageControllerMeasureUpdateRate(uint32_t windowMs, voltageControllerRateTest_t* result);
+bool VoltageControllerStartStream(uint32_t rateHz, VoltageControllerFrameSource_t source, VoltageControllerStreamStopped_t stopped);
+void VoltageControllerStopStream(void);
+bool VoltageControllerIsStreaming(void);
+uint32_t VoltageControllerGetStreamRate(void);
+bool VoltageControllerRecoverBus(void);
+void VoltageControllerGetSkewStats(voltageControllerSkewStats_t* stats);
+void VoltageControllerResetSkewStats(void);
 
 #endif /* API_VOLTAGECONTROLLER_VOLTAGECONTROLLER_H_ */
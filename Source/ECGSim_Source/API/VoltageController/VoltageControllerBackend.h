@@ -0,0 +1,28 @@
+/*
+ * VoltageControllerBackend.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Interface each output backend implements, private to VoltageController.
+ */
+
+#ifndef API_VOLTAGECONTROLLER_VOLTAGECONTROLLERBACKEND_H_
+#define API_VOLTAGECONTROLLER_VOLTAGECONTROLLERBACKEND_H_
+
+#include "VoltageController.h"
+
+typedef struct{
+	const char* name;
+	bool (*init)(void);
+	bool (*write)(const uint16_t* frame);		//non-blocking, false drops the frame
+	uint32_t (*writeBlock)(const uint16_t* frames, uint32_t frameCount);	//paced by the backend, returns frames written
+	void (*flush)(void);						//waits for writes in flight
+	void (*getCapabilities)(voltageBackendCapabilities_t* capabilities);
+}voltageBackend_t;
+
+extern const voltageBackend_t g_mcp4725Backend;
+extern const voltageBackend_t g_pwmBackend;
+extern const voltageBackend_t g_captureBackend;
+
+#endif /* API_VOLTAGECONTROLLER_VOLTAGECONTROLLERBACKEND_H_ */
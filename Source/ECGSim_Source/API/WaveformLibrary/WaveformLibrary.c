@@ -0,0 +1,262 @@
+/*
+ * WaveformLibrary.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "WaveformLibrary.h"
+#include "Crc32/Crc32.h"
+#include "main.h"
+#include <stddef.h>
+
+#define WAVEFORM_LIBRARY_MAGIC				0x564C4345UL	//"ECLV"
+
+/* Selection page: a log of half words, the last programmed one wins */
+#define SELECTION_RECORD_MARKER				0xA500
+#define SELECTION_RECORD_MASK				0xFF00
+#define SELECTION_RECORD_ERASED				0xFFFF
+#define SELECTION_RECORD_COUNT				(WAVEFORM_LIBRARY_PAGE_SIZE / sizeof(uint16_t))
+
+/* Provided by STM32F103C8TX_FLASH.ld */
+extern uint8_t _swavelib[];
+extern uint8_t _ewavelib[];
+
+typedef struct{
+	uint8_t slot;
+	uint32_t address;
+	uint32_t length;
+	uint32_t crc;
+	uint8_t pendingByte;
+	bool pending;
+	bool active;
+}waveformLibrarySave_t;
+
+static waveformLibrarySave_t g_librarySave;
+
+static uint32_t getSelectionAddress(void)
+{
+	return (uint32_t)_swavelib;
+}
+
+static uint32_t getSlotAddress(uint8_t slot)
+{
+	return (uint32_t)_swavelib + WAVEFORM_LIBRARY_PAGE_SIZE + slot * WAVEFORM_LIBRARY_SLOT_SIZE;
+}
+
+static bool eraseFlashPages(uint32_t address, uint32_t pages)
+{
+	FLASH_EraseInitTypeDef erase = {
+			.TypeErase = FLASH_TYPEERASE_PAGES,
+			.PageAddress = address,
+			.NbPages = pages
+	};
+	uint32_t pageError;
+
+	HAL_FLASH_Unlock();
+	bool status = (HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK);
+	HAL_FLASH_Lock();
+	return status;
+}
+
+static bool programHalfWords(uint32_t address, const uint16_t* data, uint32_t count)
+{
+	bool status = true;
+
+	HAL_FLASH_Unlock();
+	for(uint32_t i = 0; i < count && status; i++)
+	{
+		status = (HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + i * 2, data[i]) == HAL_OK);
+	}
+	HAL_FLASH_Lock();
+	return status;
+}
+
+/**
+ * @brief Erases a slot and opens it for WaveformLibraryWrite
+ */
+bool WaveformLibraryBeginSave(uint8_t slot)
+{
+	if(slot >= WAVEFORM_LIBRARY_SLOT_COUNT || getSlotAddress(slot + 1) > (uint32_t)_ewavelib)
+	{
+		return false;
+	}
+
+	g_librarySave.active = false;
+	if(!eraseFlashPages(getSlotAddress(slot), WAVEFORM_LIBRARY_SLOT_PAGES))
+	{
+		return false;
+	}
+
+	g_librarySave.slot = slot;
+	g_librarySave.address = getSlotAddress(slot) + sizeof(waveformLibraryHeader_t);
+	g_librarySave.length = 0;
+	g_librarySave.crc = CRC32_INITIAL_VALUE;
+	g_librarySave.pending = false;
+	g_librarySave.active = true;
+	return true;
+}
+
+/**
+ * @brief Appends payload bytes to the slot opened by WaveformLibraryBeginSave
+ */
+bool WaveformLibraryWrite(const uint8_t* data, uint32_t length)
+{
+	if(!g_librarySave.active || g_librarySave.length + length > WAVEFORM_LIBRARY_MAX_PAYLOAD)
+	{
+		return false;
+	}
+
+	g_librarySave.crc = Crc32Update(g_librarySave.crc, data, length);
+	g_librarySave.length += length;
+
+	//Flash is programmed in half words, an odd byte waits for its partner
+	while(length > 0)
+	{
+		if(!g_librarySave.pending)
+		{
+			g_librarySave.pendingByte = *data++;
+			g_librarySave.pending = true;
+			length--;
+			continue;
+		}
+
+		uint16_t halfWord = g_librarySave.pendingByte | ((uint16_t)*data++ << 8);
+		length--;
+		g_librarySave.pending = false;
+		if(!programHalfWords(g_librarySave.address, &halfWord, 1))
+		{
+			g_librarySave.active = false;
+			return false;
+		}
+		g_librarySave.address += 2;
+	}
+	return true;
+}
+
+/**
+ * @brief Completes a save. The header is programmed after the payload and
+ * its magic last, which is what makes the slot valid.
+ * @param header name and playback details, length and CRC are filled in here
+ */
+bool WaveformLibraryEndSave(const waveformLibraryHeader_t* header)
+{
+	if(!g_librarySave.active)
+	{
+		return false;
+	}
+	g_librarySave.active = false;
+
+	if(g_librarySave.pending)
+	{
+		uint16_t halfWord = g_librarySave.pendingByte | 0xFF00;
+		if(!programHalfWords(g_librarySave.address, &halfWord, 1))
+		{
+			return false;
+		}
+	}
+
+	waveformLibraryHeader_t entry = *header;
+	entry.magic = WAVEFORM_LIBRARY_MAGIC;
+	entry.length = g_librarySave.length;
+	entry.crc = g_librarySave.crc;
+
+	uint32_t address = getSlotAddress(g_librarySave.slot);
+	const uint16_t* halfWords = (const uint16_t*)&entry;
+	uint32_t magicHalfWords = sizeof(entry.magic) / sizeof(uint16_t);
+
+	return programHalfWords(address + sizeof(entry.magic), halfWords + magicHalfWords,
+					sizeof(entry) / sizeof(uint16_t) - magicHalfWords) &&
+			programHalfWords(address, halfWords, magicHalfWords);
+}
+
+/**
+ * @brief Header of a saved waveform, its payload is checked against the CRC
+ * @return NULL for an empty or damaged slot
+ */
+const waveformLibraryHeader_t* WaveformLibraryGetEntry(uint8_t slot)
+{
+	if(slot >= WAVEFORM_LIBRARY_SLOT_COUNT)
+	{
+		return NULL;
+	}
+
+	const waveformLibraryHeader_t* header = (const waveformLibraryHeader_t*)getSlotAddress(slot);
+	if(header->magic != WAVEFORM_LIBRARY_MAGIC || header->length > WAVEFORM_LIBRARY_MAX_PAYLOAD)
+	{
+		return NULL;
+	}
+
+	if(Crc32Update(CRC32_INITIAL_VALUE, WaveformLibraryGetPayload(slot), header->length) != header->crc)
+	{
+		return NULL;
+	}
+	return header;
+}
+
+const uint8_t* WaveformLibraryGetPayload(uint8_t slot)
+{
+	return (const uint8_t*)(getSlotAddress(slot) + sizeof(waveformLibraryHeader_t));
+}
+
+bool WaveformLibraryErase(uint8_t slot)
+{
+	if(slot >= WAVEFORM_LIBRARY_SLOT_COUNT)
+	{
+		return false;
+	}
+
+	if(WaveformLibraryGetSelected() == slot && !WaveformLibrarySelect(WAVEFORM_LIBRARY_NO_SELECTION))
+	{
+		return false;
+	}
+	return eraseFlashPages(getSlotAddress(slot), WAVEFORM_LIBRARY_SLOT_PAGES);
+}
+
+/**
+ * @brief Records the waveform to load at boot. Appends to the selection log
+ * and only erases the page once it is full.
+ * @param slot library slot, or WAVEFORM_LIBRARY_NO_SELECTION
+ */
+bool WaveformLibrarySelect(uint8_t slot)
+{
+	if(slot >= WAVEFORM_LIBRARY_SLOT_COUNT && slot != WAVEFORM_LIBRARY_NO_SELECTION)
+	{
+		return false;
+	}
+
+	const uint16_t* records = (const uint16_t*)getSelectionAddress();
+	uint16_t record = SELECTION_RECORD_MARKER | slot;
+	uint32_t index = 0;
+
+	while(index < SELECTION_RECORD_COUNT && records[index] != SELECTION_RECORD_ERASED)
+	{
+		index++;
+	}
+
+	if(index == SELECTION_RECORD_COUNT)
+	{
+		if(!eraseFlashPages(getSelectionAddress(), 1))
+		{
+			return false;
+		}
+		index = 0;
+	}
+	return programHalfWords(getSelectionAddress() + index * sizeof(uint16_t), &record, 1);
+}
+
+uint8_t WaveformLibraryGetSelected(void)
+{
+	const uint16_t* records = (const uint16_t*)getSelectionAddress();
+	uint8_t selected = WAVEFORM_LIBRARY_NO_SELECTION;
+
+	for(uint32_t index = 0; index < SELECTION_RECORD_COUNT && records[index] != SELECTION_RECORD_ERASED; index++)
+	{
+		if((records[index] & SELECTION_RECORD_MASK) == SELECTION_RECORD_MARKER)
+		{
+			selected = (uint8_t)(records[index] & ~SELECTION_RECORD_MASK);
+		}
+	}
+
+	return (selected < WAVEFORM_LIBRARY_SLOT_COUNT) ? selected : WAVEFORM_LIBRARY_NO_SELECTION;
+}
@@ -0,0 +1,50 @@
+/*
+ * WaveformLibrary.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Waveform store in the WAVELIB flash region reserved by the linker script.
+ *  The region starts with one selection page followed by fixed size slots.
+ *  A slot is a header and a payload; the header magic is programmed last so
+ *  a save cut short by a reset leaves an empty slot, not a corrupt one.
+ *  Flash erase and program stall instruction fetch, so playback skips
+ *  samples while a save or erase is running.
+ */
+
+#ifndef API_WAVEFORMLIBRARY_WAVEFORMLIBRARY_H_
+#define API_WAVEFORMLIBRARY_WAVEFORMLIBRARY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WAVEFORM_LIBRARY_PAGE_SIZE			1024UL
+#define WAVEFORM_LIBRARY_SLOT_PAGES			4
+#define WAVEFORM_LIBRARY_SLOT_COUNT			3
+#define WAVEFORM_LIBRARY_SLOT_SIZE			(WAVEFORM_LIBRARY_SLOT_PAGES * WAVEFORM_LIBRARY_PAGE_SIZE)
+#define WAVEFORM_LIBRARY_NAME_LENGTH		12
+#define WAVEFORM_LIBRARY_NO_SELECTION		0xFF
+
+typedef struct{
+	uint32_t magic;
+	char name[WAVEFORM_LIBRARY_NAME_LENGTH];	//NUL padded, not terminated when full
+	uint32_t length;		//payload bytes
+	uint32_t crc;			//CRC-32 of the payload
+	uint16_t sampleCount;
+	uint16_t sampleRate;
+	uint16_t peakIndex;
+	uint16_t format;		//payload layout version, owned by the caller
+}waveformLibraryHeader_t;
+
+#define WAVEFORM_LIBRARY_MAX_PAYLOAD		(WAVEFORM_LIBRARY_SLOT_SIZE - sizeof(waveformLibraryHeader_t))
+
+bool WaveformLibraryBeginSave(uint8_t slot);
+bool WaveformLibraryWrite(const uint8_t* data, uint32_t length);
+bool WaveformLibraryEndSave(const waveformLibraryHeader_t* header);
+const waveformLibraryHeader_t* WaveformLibraryGetEntry(uint8_t slot);
+const uint8_t* WaveformLibraryGetPayload(uint8_t slot);
+bool WaveformLibraryErase(uint8_t slot);
+bool WaveformLibrarySelect(uint8_t slot);
+uint8_t WaveformLibraryGetSelected(void);
+
+#endif /* API_WAVEFORMLIBRARY_WAVEFORMLIBRARY_H_ */
@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "customUART.h"
+#include "main.h"
 
 
 /**
@@ -41,6 +42,7 @@
 #define COMMAND_BAD_ERROR_STRING "Command Bad\n"
 #define COMMAND_EXECUTED_STRING "Command Executed\n"
 #define COMMAND_TOO_LONG "Command length too long"
+#define RAW_MODE_TIMEOUT_STRING "Raw mode timeout\n"
 #define COMMAND_END_CHARACTER '\r'
 #define COMMAND_ARG_SEPARATOR ' '
 
@@ -64,6 +66,13 @@ struct argument{
 	char *list[COMMAND_MAX_ARGS];
 }g_arguments;
 
+struct rawMode{
+	CliRawHandlerFn_t handler;
+	CliRawTimeoutFn_t timeoutHandler;
+	uint32_t idleTimeoutMs;
+	uint32_t lastByteTick;
+}g_rawMode;
+
 bool g_argumentFound = true;
 extern const CommandLineEntry_t g_commandTable[];
 
@@ -83,6 +92,7 @@ static CommandStatus_t executeCommand();
 static void printStatus(CommandStatus_t status);
 static void printCLIInfo();
 static void resetArgumentCount();
+static void processRawMode();
 
 //CLI Comm functions
 static bool getCharacter(char *receivedCharacter);
@@ -165,6 +175,35 @@ CommandStatus_t executeCommand()
 	return E_COMMAND_ARG_OK;
 }
 
+/**
+ * @brief Hands received bytes to the raw handler until it returns false or
+ * the line stays idle for the timeout, then the command parser takes over
+ */
+void processRawMode()
+{
+	char receivedCharacter;
+
+	while(getCharacter(&receivedCharacter))
+	{
+		g_rawMode.lastByteTick = HAL_GetTick();
+		if(!g_rawMode.handler((uint8_t)receivedCharacter))
+		{
+			g_rawMode.handler = NULL;
+			return;
+		}
+	}
+
+	if(HAL_GetTick() - g_rawMode.lastByteTick > g_rawMode.idleTimeoutMs)
+	{
+		g_rawMode.handler = NULL;
+		if(g_rawMode.timeoutHandler != NULL)
+		{
+			g_rawMode.timeoutHandler();
+		}
+		CLI_PrintLine(RAW_MODE_TIMEOUT_STRING);
+	}
+}
+
 /**
  * @brief Function is used to reset the command buffer
  * @return NONE
@@ -249,7 +288,8 @@ bool getCharacter(char *receivedCharacter)
 }
 
 /**
- * @brief Function to send data over serial
+ * @brief Function to send data over serial, waits for room in the transmit
+ * queue so bulk replies are not cut short
  * @param data Pointer to the data to be send of type uint8_t
  * @param size Size of message
  * @return Status of function call
@@ -258,7 +298,7 @@ bool getCharacter(char *receivedCharacter)
  */
 bool sendData(char *data,uint32_t size)
 {
-	return UART_Write(DEBUG_UART, (uint8_t*)data, size);
+	return UART_WriteBlocking(DEBUG_UART, (uint8_t*)data, size) == size;
 }
 
 /**@}*/ // SERIAL_CLI_PVT_FUNCS
@@ -295,6 +335,12 @@ void CLI_Process()
 {
 	CommandStatus_t status;
 
+	if(g_rawMode.handler != NULL)
+	{
+		processRawMode();
+		return;
+	}
+
 	if(constructCommand() != E_NEW_COMMAND)
 	{
 		return;
@@ -309,6 +355,22 @@ void CLI_Process()
 	resetArgumentCount();
 }
 
+/**
+ * @brief Routes the received bytes to handler instead of the command parser,
+ * for binary transfers started by a command
+ * @param handler called per byte, returns false to give the line back
+ * @param idleTimeoutMs the parser also takes the line back after this long
+ * without a byte
+ * @param timeoutHandler called on that timeout, may be NULL
+ */
+void CLI_EnterRawMode(CliRawHandlerFn_t handler, uint32_t idleTimeoutMs, CliRawTimeoutFn_t timeoutHandler)
+{
+	g_rawMode.idleTimeoutMs = idleTimeoutMs;
+	g_rawMode.timeoutHandler = timeoutHandler;
+	g_rawMode.lastByteTick = HAL_GetTick();
+	g_rawMode.handler = handler;
+}
+
 /**
  * @brief Function is used to print null terminated string
  * @param a_string Pointer to the null terminated string
@@ -46,6 +46,9 @@ typedef enum CommandStatus{
 
 typedef int (*CommandHandlerFn_t)(int argc, char *argv[]);
 
+typedef bool (*CliRawHandlerFn_t)(uint8_t data);
+typedef void (*CliRawTimeoutFn_t)(void);
+
 
 typedef struct{
 	const char *commandName;
@@ -73,6 +76,11 @@ void CLI_PrintLine(const char * string);
  */
 void CLI_Print(char* data,uint32_t size);
 
+/**
+ * @brief Function hands the received bytes to a handler until it is done
+ */
+void CLI_EnterRawMode(CliRawHandlerFn_t handler, uint32_t idleTimeoutMs, CliRawTimeoutFn_t timeoutHandler);
+
 
 
 #endif /* CLIAPPLICATION_CLIAPPLICATION_H_ */
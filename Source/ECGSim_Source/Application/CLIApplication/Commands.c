@@ -12,6 +12,15 @@
 #include "CLIApplication.h"
 #include "ECGGeneratorApplication.h"
 #include "Stopwatch.h"
+#include "OsApplication.h"
+#include "SampleClock/SampleClock.h"
+#include "WaveformLibrary/WaveformLibrary.h"
+#include "VoltageController.h"
+#include "I2cBus/I2cBus.h"
+#include "DacCalibration/DacCalibration.h"
+#include "Encoder/COBS/cobs.h"
+#include "Crc32/Crc32.h"
+#include "customUART.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
@@ -40,6 +49,81 @@
 #define COMMAND_INITIATE_ECG_DOWNLOAD 	"InitiateEcgDownload"
 #define COMMAND_DOWNLOAD_ECG_DATA 		"DownloadEcgData"
 #define COMMAND_GET_AVG_TRIGGER_TIME	"GetAvgTriggerTime"
+#define COMMAND_SET_SAMPLE_RATE			"SetSampleRate"
+#define COMMAND_GET_SAMPLE_RATE			"GetSampleRate"
+#define COMMAND_SET_HEART_RATE			"SetHeartRate"
+#define COMMAND_INITIATE_TEMPLATE_DOWNLOAD	"InitiateTemplateDownload"
+#define COMMAND_COMMIT_TEMPLATES		"CommitTemplates"
+#define COMMAND_SET_RHYTHM				"SetRhythm"
+#define COMMAND_APPEND_RHYTHM			"AppendRhythm"
+#define COMMAND_SET_HRV					"SetHrv"
+#define COMMAND_SET_AMPLITUDE			"SetAmplitude"
+#define COMMAND_SET_OFFSET				"SetOffset"
+#define COMMAND_SAVE_WAVEFORM			"SaveWaveform"
+#define COMMAND_LIST_WAVEFORMS			"ListWaveforms"
+#define COMMAND_SELECT_WAVEFORM			"SelectWaveform"
+#define COMMAND_ERASE_WAVEFORM			"EraseWaveform"
+#define COMMAND_START_STREAM			"StartStream"
+#define COMMAND_STREAM_ECG_DATA			"StreamEcgData"
+#define COMMAND_STOP_STREAM				"StopStream"
+#define COMMAND_GET_STREAM_STATS		"GetStreamStats"
+#define COMMAND_SET_ARTIFACT			"SetArtifact"
+#define COMMAND_SET_CHANNELS			"SetChannels"
+#define COMMAND_GET_DAC_SKEW			"GetDacSkew"
+#define COMMAND_ADD_MARKERS				"AddMarkers"
+#define COMMAND_SET_MARKER_TRIGGER		"SetMarkerTrigger"
+#define COMMAND_GET_MARKER_STATS		"GetMarkerStats"
+#define COMMAND_SET_I2C_SPEED			"SetI2cSpeed"
+#define COMMAND_DAC_SELF_TEST			"DacSelfTest"
+#define COMMAND_SET_CONTINUOUS			"SetContinuous"
+#define COMMAND_SET_OUTPUT				"SetOutput"
+#define COMMAND_GET_CAPTURE				"GetCapture"
+#define COMMAND_BENCHMARK				"Benchmark"
+#define COMMAND_GET_I2C_HEALTH			"GetI2cHealth"
+#define COMMAND_CAL_START				"CalStart"
+#define COMMAND_CAL_POINT				"CalPoint"
+#define COMMAND_CAL_END					"CalEnd"
+#define COMMAND_GET_CAL					"GetCal"
+#define COMMAND_BINARY_UPLOAD			"BinaryUpload"
+#define COMMAND_SET_BAUD_RATE			"SetBaudRate"
+#define COMMAND_CONFIRM_BAUD			"ConfirmBaud"
+#define COMMAND_GET_BLOCK_CRCS			"GetBlockCrcs"
+#define COMMAND_KEEP_ECG_DATA			"KeepEcgData"
+#define COMMAND_READ_ECG				"ReadEcg"
+#define COMMAND_VERIFY_ECG				"VerifyEcg"
+
+#define COMMAND_MAX_RHYTHM_STEPS		20
+
+/* Streamed samples are two characters of 6 bits each, offset from '0' so
+ * the line never holds a space or a terminator */
+#define COMMAND_STREAM_SAMPLE_CHARS		2
+#define COMMAND_STREAM_CHAR_OFFSET		'0'
+#define COMMAND_STREAM_MAX_SAMPLES		42
+
+/* Binary upload frame, COBS encoded and ended by a zero byte:
+ * sequence number, samples and CRC-32 of both, all little endian. The
+ * window keeps the frames in flight within the receive queue. */
+#define BINARY_UPLOAD_MAX_SAMPLES		128
+#define BINARY_UPLOAD_SEQUENCE_SIZE		2
+#define BINARY_UPLOAD_CRC_SIZE			4
+#define BINARY_UPLOAD_MAX_FRAME			(BINARY_UPLOAD_SEQUENCE_SIZE + BINARY_UPLOAD_MAX_SAMPLES * 2 + BINARY_UPLOAD_CRC_SIZE)
+#define BINARY_UPLOAD_WINDOW			3
+#define BINARY_UPLOAD_IDLE_TIMEOUT_MS	1000
+
+/* After SetBaudRate the host has this long to send ConfirmBaud at the new
+ * rate, or the link falls back to the old one */
+#define BAUD_CONFIRM_TIMEOUT_MS			1000
+#define BAUD_CONFIRM_MAX_LINES			3
+
+/* Samples decoded per CRC update by GetBlockCrcs and VerifyEcg */
+#define BLOCK_CRC_CHUNK_SAMPLES			32
+
+/* Readback frame, laid out like a binary upload frame but with the index of
+ * its first sample in place of the sequence number. Small enough to build
+ * on the CLI task stack. */
+#define READBACK_MAX_SAMPLES			32
+#define READBACK_INDEX_SIZE				2
+#define READBACK_MAX_FRAME				(READBACK_INDEX_SIZE + READBACK_MAX_SAMPLES * 2 + BINARY_UPLOAD_CRC_SIZE)
 
 
 //Encryption Test Commands
@@ -47,16 +131,118 @@
 
 char ackText[5] = "\nok";
 
+struct binaryUpload{
+	uint8_t frame[COBS_ENCODE_DST_BUF_LEN_MAX(BINARY_UPLOAD_MAX_FRAME)];
+	uint32_t length;
+	uint32_t remaining;
+	uint16_t nextSequence;
+	bool overflow;
+	bool nakSent;
+}g_binaryUpload;
+
+//USART1 runs from a 36 MHz clock, these divide it within 0.2%
+static const uint32_t g_baudRates[] = {115200, 230400, 460800, 921600, MAX_BAUD_RATE};
+
+struct baudConfirm{
+	char line[sizeof(COMMAND_CONFIRM_BAUD)];
+	uint32_t length;
+	uint32_t previousRate;
+	uint32_t startTick;
+	uint8_t badLines;
+}g_baudConfirm;
+
 
 static int printFirmwareInfo(int argc, char* argv[]);
 static int initiateEcgDownloadFn(int argc, char * argv[]);
 static int ecgDownloadFn(int argc, char * argv[]);
 static int ecgGetAvgTriggerTime(int argc, char* argv[]);
+static int setSampleRateFn(int argc, char* argv[]);
+static int getSampleRateFn(int argc, char* argv[]);
+static int setHeartRateFn(int argc, char* argv[]);
+static int initiateTemplateDownloadFn(int argc, char* argv[]);
+static int commitTemplatesFn(int argc, char* argv[]);
+static int setRhythmFn(int argc, char* argv[]);
+static int appendRhythmFn(int argc, char* argv[]);
+static int setHrvFn(int argc, char* argv[]);
+static int setAmplitudeFn(int argc, char* argv[]);
+static int setOffsetFn(int argc, char* argv[]);
+static int saveWaveformFn(int argc, char* argv[]);
+static int listWaveformsFn(int argc, char* argv[]);
+static int selectWaveformFn(int argc, char* argv[]);
+static int eraseWaveformFn(int argc, char* argv[]);
+static int startStreamFn(int argc, char* argv[]);
+static int streamEcgDataFn(int argc, char* argv[]);
+static int stopStreamFn(int argc, char* argv[]);
+static int getStreamStatsFn(int argc, char* argv[]);
+static int setArtifactFn(int argc, char* argv[]);
+static int setChannelsFn(int argc, char* argv[]);
+static int getDacSkewFn(int argc, char* argv[]);
+static int addMarkersFn(int argc, char* argv[]);
+static int setMarkerTriggerFn(int argc, char* argv[]);
+static int getMarkerStatsFn(int argc, char* argv[]);
+static int setI2cSpeedFn(int argc, char* argv[]);
+static int dacSelfTestFn(int argc, char* argv[]);
+static int setContinuousFn(int argc, char* argv[]);
+static int setOutputFn(int argc, char* argv[]);
+static int getCaptureFn(int argc, char* argv[]);
+static int benchmarkFn(int argc, char* argv[]);
+static int getI2cHealthFn(int argc, char* argv[]);
+static int calStartFn(int argc, char* argv[]);
+static int calPointFn(int argc, char* argv[]);
+static int calEndFn(int argc, char* argv[]);
+static int getCalFn(int argc, char* argv[]);
+static int binaryUploadFn(int argc, char* argv[]);
+static int setBaudRateFn(int argc, char* argv[]);
+static int getBlockCrcsFn(int argc, char* argv[]);
+static int keepEcgDataFn(int argc, char* argv[]);
+static int readEcgFn(int argc, char* argv[]);
+static int verifyEcgFn(int argc, char* argv[]);
 const CommandLineEntry_t g_commandTable[]={
 		{COMMAND_PRINT_FIRMWARE_INFO, printFirmwareInfo},
 		{COMMAND_INITIATE_ECG_DOWNLOAD, initiateEcgDownloadFn},
 		{COMMAND_DOWNLOAD_ECG_DATA, ecgDownloadFn},
 		{COMMAND_GET_AVG_TRIGGER_TIME,ecgGetAvgTriggerTime},
+		{COMMAND_SET_SAMPLE_RATE, setSampleRateFn},
+		{COMMAND_GET_SAMPLE_RATE, getSampleRateFn},
+		{COMMAND_SET_HEART_RATE, setHeartRateFn},
+		{COMMAND_INITIATE_TEMPLATE_DOWNLOAD, initiateTemplateDownloadFn},
+		{COMMAND_COMMIT_TEMPLATES, commitTemplatesFn},
+		{COMMAND_SET_RHYTHM, setRhythmFn},
+		{COMMAND_APPEND_RHYTHM, appendRhythmFn},
+		{COMMAND_SET_HRV, setHrvFn},
+		{COMMAND_SET_AMPLITUDE, setAmplitudeFn},
+		{COMMAND_SET_OFFSET, setOffsetFn},
+		{COMMAND_SAVE_WAVEFORM, saveWaveformFn},
+		{COMMAND_LIST_WAVEFORMS, listWaveformsFn},
+		{COMMAND_SELECT_WAVEFORM, selectWaveformFn},
+		{COMMAND_ERASE_WAVEFORM, eraseWaveformFn},
+		{COMMAND_START_STREAM, startStreamFn},
+		{COMMAND_STREAM_ECG_DATA, streamEcgDataFn},
+		{COMMAND_STOP_STREAM, stopStreamFn},
+		{COMMAND_GET_STREAM_STATS, getStreamStatsFn},
+		{COMMAND_SET_ARTIFACT, setArtifactFn},
+		{COMMAND_SET_CHANNELS, setChannelsFn},
+		{COMMAND_GET_DAC_SKEW, getDacSkewFn},
+		{COMMAND_ADD_MARKERS, addMarkersFn},
+		{COMMAND_SET_MARKER_TRIGGER, setMarkerTriggerFn},
+		{COMMAND_GET_MARKER_STATS, getMarkerStatsFn},
+		{COMMAND_SET_I2C_SPEED, setI2cSpeedFn},
+		{COMMAND_DAC_SELF_TEST, dacSelfTestFn},
+		{COMMAND_SET_CONTINUOUS, setContinuousFn},
+		{COMMAND_SET_OUTPUT, setOutputFn},
+		{COMMAND_GET_CAPTURE, getCaptureFn},
+		{COMMAND_BENCHMARK, benchmarkFn},
+		{COMMAND_GET_I2C_HEALTH, getI2cHealthFn},
+		{COMMAND_CAL_START, calStartFn},
+		{COMMAND_CAL_POINT, calPointFn},
+		{COMMAND_CAL_END, calEndFn},
+		{COMMAND_GET_CAL, getCalFn},
+		{COMMAND_BINARY_UPLOAD, binaryUploadFn},
+		{COMMAND_SET_BAUD_RATE, setBaudRateFn},
+		{COMMAND_GET_BLOCK_CRCS, getBlockCrcsFn},
+		{COMMAND_KEEP_ECG_DATA, keepEcgDataFn},
+		{COMMAND_READ_ECG, readEcgFn},
+		{COMMAND_VERIFY_ECG, verifyEcgFn},
 		{0,0} // End of List. Always required
 };
 
@@ -82,10 +268,16 @@ int initiateEcgDownloadFn(int argc, char * argv[])
 	}
 
 	uint32_t downloadSize = 0;
-	sscanf(argv[1],"%lu",&downloadSize);
+	waveformCodec_t codec = WAVEFORM_CODEC_RAW16;
 
+	//Optional storage codec, raw when omitted
+	if(sscanf(argv[1],"%lu",&downloadSize) != 1 || downloadSize > UINT16_MAX ||
+			(argc >= 3 && !WaveformCodecFromName(argv[2], &codec)))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
 
-	if(initiateEcgDownload((uint16_t)downloadSize))
+	if(initiateEcgDownload((uint16_t)downloadSize, codec))
 	{
 		CLI_Print(ackText, strlen(ackText));
 		return E_COMMAND_GOOD_COMMAND;
@@ -103,8 +295,11 @@ int ecgDownloadFn(int argc, char * argv[])
 
 	uint32_t ecgData = 0;
 	uint32_t dataIndex = 0;
-	sscanf(argv[1],"%lu",&dataIndex);
-	sscanf(argv[2],"%lu",&ecgData);
+	if(sscanf(argv[1],"%lu",&dataIndex) != 1 || dataIndex > UINT16_MAX ||
+			sscanf(argv[2],"%lu",&ecgData) != 1 || ecgData > UINT16_MAX)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
 
 	if(downloadEcgData((uint16_t)dataIndex,(uint16_t)ecgData))
 	{
@@ -127,3 +322,1308 @@ int ecgGetAvgTriggerTime(int argc, char* argv[])
 	CLI_Print(str,len);
 	return E_COMMAND_GOOD_COMMAND;
 }
+
+int setSampleRateFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t rateHz = 0;
+	if(sscanf(argv[1],"%lu",&rateHz) == 1 && OsAppSetSampleRate(rateHz))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int getSampleRateFn(int argc, char* argv[])
+{
+	char str[50];
+	int len = sprintf(str,"Rate: %lu Hz Overruns: %lu\n",SampleClockGetRate(),OsAppGetSampleOverrunCount());
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+int setHeartRateFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t heartRate = 0;
+	if(sscanf(argv[1],"%lu",&heartRate) == 1 && heartRate <= UINT16_MAX &&
+			setEcgHeartRate((uint16_t)heartRate))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int initiateTemplateDownloadFn(int argc, char* argv[])
+{
+	if(argc < 3)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	ecgBeatType_t beat;
+	uint32_t downloadSize = 0;
+	waveformCodec_t codec = WAVEFORM_CODEC_RAW16;
+
+	if(!ecgBeatTypeFromSymbol(argv[1][0], &beat))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+	if(sscanf(argv[2],"%lu",&downloadSize) != 1 || downloadSize > UINT16_MAX ||
+			(argc >= 4 && !WaveformCodecFromName(argv[3], &codec)))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	if(initiateEcgTemplateDownload(beat, (uint16_t)downloadSize, codec))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int commitTemplatesFn(int argc, char* argv[])
+{
+	if(commitEcgTemplates())
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief Parses rhythm steps of the form <beat>[:<RR ms>], e.g. "N:800 V:550 N:1250 D"
+ */
+static int loadRhythm(int argc, char* argv[], bool append)
+{
+	ecgRhythmStep_t steps[COMMAND_MAX_RHYTHM_STEPS];
+	uint8_t count = 0;
+
+	for(int i = 1; i < argc && count < COMMAND_MAX_RHYTHM_STEPS; i++, count++)
+	{
+		ecgBeatType_t beat;
+		uint32_t rrMs = 0;
+
+		if(!ecgBeatTypeFromSymbol(argv[i][0], &beat))
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+		if(argv[i][1] == ':')
+		{
+			sscanf(&argv[i][2],"%lu",&rrMs);
+		}
+		else if(argv[i][1] != '\0')
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+
+		steps[count].beat = (uint8_t)beat;
+		steps[count].rrMs = (rrMs <= UINT16_MAX) ? (uint16_t)rrMs : UINT16_MAX;
+	}
+
+	if(setEcgRhythm(steps, count, append))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int setRhythmFn(int argc, char* argv[])
+{
+	//Without steps the sequencer stops and the normal beat loops again
+	return loadRhythm(argc, argv, false);
+}
+
+int appendRhythmFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+	return loadRhythm(argc, argv, true);
+}
+
+/**
+ * @brief SetHrv <SDNN ms> [LF/HF ratio x100] [breaths per min] [amplitude depth %], SetHrv 0 turns it off
+ */
+int setHrvFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t sdnnMs = 0;
+	uint32_t lfHfRatio = HRV_DEFAULT_LF_HF_RATIO;
+	uint32_t respRate = HRV_DEFAULT_RESP_RATE;
+	uint32_t amplitudeDepth = 0;
+
+	sscanf(argv[1],"%lu",&sdnnMs);
+	if(argc >= 3)
+		sscanf(argv[2],"%lu",&lfHfRatio);
+	if(argc >= 4)
+		sscanf(argv[3],"%lu",&respRate);
+	if(argc >= 5)
+		sscanf(argv[4],"%lu",&amplitudeDepth);
+
+	hrvConfig_t config = {
+			.sdnnMs = (sdnnMs <= UINT16_MAX) ? (uint16_t)sdnnMs : UINT16_MAX,
+			.lfHfRatio = (lfHfRatio <= UINT16_MAX) ? (uint16_t)lfHfRatio : UINT16_MAX,
+			.respRate = (respRate <= UINT16_MAX) ? (uint16_t)respRate : UINT16_MAX,
+			.amplitudeDepth = (amplitudeDepth <= UINT8_MAX) ? (uint8_t)amplitudeDepth : UINT8_MAX
+	};
+
+	if(setEcgHrv(&config))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief SetAmplitude <uV peak to peak at RA-LA>
+ */
+int setAmplitudeFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t amplitudeUv = 0;
+	sscanf(argv[1],"%lu",&amplitudeUv);
+
+	if(setEcgAmplitude(amplitudeUv))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief SetOffset <signed uV at RA-LA>
+ */
+int setOffsetFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	int32_t offsetUv = 0;
+	sscanf(argv[1],"%ld",&offsetUv);
+
+	if(setEcgOffset(offsetUv))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief SaveWaveform <slot> <name>, stores the playing waveform in flash. A
+ * slot holds WAVEFORM_LIBRARY_MAX_PAYLOAD bytes: the bank word, template and
+ * marker tables, markers and the encoded samples. A bigger waveform is
+ * refused with Too large: <needed> <limit>.
+ */
+int saveWaveformFn(int argc, char* argv[])
+{
+	if(argc < 3)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t slot = 0;
+	if(sscanf(argv[1],"%lu",&slot) != 1)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	uint32_t saveSize = getEcgWaveformSaveSize();
+	if(saveSize > WAVEFORM_LIBRARY_MAX_PAYLOAD)
+	{
+		char str[40];
+		int len = sprintf(str,"Too large: %lu %lu\n", saveSize, (uint32_t)WAVEFORM_LIBRARY_MAX_PAYLOAD);
+		CLI_Print(str,len);
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	if(slot < WAVEFORM_LIBRARY_SLOT_COUNT && saveEcgWaveform((uint8_t)slot, argv[2]))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int listWaveformsFn(int argc, char* argv[])
+{
+	uint8_t selected = WaveformLibraryGetSelected();
+
+	for(uint8_t slot = 0; slot < WAVEFORM_LIBRARY_SLOT_COUNT; slot++)
+	{
+		const waveformLibraryHeader_t* header = WaveformLibraryGetEntry(slot);
+		char str[80];
+		int len;
+
+		if(header == NULL)
+		{
+			len = sprintf(str,"%u: empty\n",slot);
+		}
+		else
+		{
+			len = sprintf(str,"%u: %.*s Samples: %u Rate: %u Peak: %u CRC: %08lX%s\n",
+					slot, WAVEFORM_LIBRARY_NAME_LENGTH, header->name, header->sampleCount,
+					header->sampleRate, header->peakIndex, header->crc,
+					(slot == selected) ? " *" : "");
+		}
+		CLI_Print(str,len);
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief SelectWaveform <slot>, plays a saved waveform now and at every boot
+ */
+int selectWaveformFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t slot = 0;
+	if(sscanf(argv[1],"%lu",&slot) == 1 && slot < WAVEFORM_LIBRARY_SLOT_COUNT && loadEcgWaveform((uint8_t)slot) &&
+			WaveformLibrarySelect((uint8_t)slot))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int eraseWaveformFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t slot = 0;
+	if(sscanf(argv[1],"%lu",&slot) == 1 && slot < WAVEFORM_LIBRARY_SLOT_COUNT && WaveformLibraryErase((uint8_t)slot))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief Acknowledges a stream command with the credits the host may spend
+ */
+static void printStreamCredits()
+{
+	ecgStreamStats_t stats;
+	char str[30];
+
+	getEcgStreamStats(&stats);
+	int len = sprintf(str,"\nCredits: %lu",stats.credits);
+	CLI_Print(str,len);
+	CLI_Print(ackText, strlen(ackText));
+}
+
+/**
+ * @brief StartStream [prefill samples]
+ */
+int startStreamFn(int argc, char* argv[])
+{
+	uint32_t prefill = 0;
+
+	if(argc >= 2)
+	{
+		sscanf(argv[1],"%lu",&prefill);
+	}
+
+	if(startEcgStream(prefill))
+	{
+		printStreamCredits();
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief StreamEcgData <samples>, see COMMAND_STREAM_SAMPLE_CHARS for the encoding
+ */
+int streamEcgDataFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint16_t samples[COMMAND_STREAM_MAX_SAMPLES];
+	uint32_t length = strlen(argv[1]);
+	uint32_t count = length / COMMAND_STREAM_SAMPLE_CHARS;
+
+	if(length % COMMAND_STREAM_SAMPLE_CHARS != 0 || count > COMMAND_STREAM_MAX_SAMPLES)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		uint8_t high = (uint8_t)(argv[1][2 * i] - COMMAND_STREAM_CHAR_OFFSET);
+		uint8_t low = (uint8_t)(argv[1][2 * i + 1] - COMMAND_STREAM_CHAR_OFFSET);
+
+		if(high > 0x3F || low > 0x3F)
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+		samples[i] = ((uint16_t)high << 6) | low;
+	}
+
+	if(streamEcgData(samples, count))
+	{
+		printStreamCredits();
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int stopStreamFn(int argc, char* argv[])
+{
+	if(stopEcgStream())
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+int getStreamStatsFn(int argc, char* argv[])
+{
+	ecgStreamStats_t stats;
+	char str[120];
+
+	getEcgStreamStats(&stats);
+	int len = sprintf(str,"Stream: %s Channels: %u Fill: %lu Credits: %lu Underruns: %lu Overruns: %lu\n",
+			stats.active ? "on" : "off", stats.channelCount, stats.fill, stats.credits, stats.underruns, stats.overruns);
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief SetArtifact <powerline|wander|emg|motion> <uV peak, 0 off> [Hz | 0.01 Hz | steps per minute]
+ */
+int setArtifactFn(int argc, char* argv[])
+{
+	static const char* const artifactNames[ARTIFACT_COUNT] = {"powerline", "wander", "emg", "motion"};
+
+	if(argc < 3)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	int type = 0;
+	while(type < ARTIFACT_COUNT && strcmp(argv[1], artifactNames[type]) != 0)
+	{
+		type++;
+	}
+	if(type == ARTIFACT_COUNT)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	uint32_t amplitudeUv = 0;
+	uint32_t parameter = 0;
+
+	sscanf(argv[2],"%lu",&amplitudeUv);
+	if(argc >= 4)
+		sscanf(argv[3],"%lu",&parameter);
+
+	if(setEcgArtifact((artifactType_t)type, amplitudeUv, parameter))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief SetChannels <interleaved leads in the next upload or stream>
+ */
+int setChannelsFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t channelCount = 0;
+	sscanf(argv[1],"%lu",&channelCount);
+
+	if(channelCount <= UINT8_MAX && setEcgChannelCount((uint8_t)channelCount))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief GetDacSkew [reset], time between the first and last DAC write of a frame
+ */
+int getDacSkewFn(int argc, char* argv[])
+{
+	voltageControllerSkewStats_t stats;
+	char str[120];
+
+	VoltageControllerGetSkewStats(&stats);
+	int len = sprintf(str,"Channels: %d Frames: %lu Skew: %lu us Max: %lu us Limit: %lu us Over: %lu Errors: %lu\n",
+			VOLTAGE_CONTROLLER_CHANNEL_COUNT, stats.frames, stats.lastSkewUs, stats.maxSkewUs,
+			stats.limitUs, stats.overLimit, stats.writeErrors);
+	CLI_Print(str,len);
+
+	if(argc >= 2 && strcmp(argv[1], "reset") == 0)
+	{
+		VoltageControllerResetSkewStats();
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief AddMarkers <type>:<frame> ..., e.g. "R:250 P:238 S:0", annotates the
+ * template being uploaded. Types are R peak, Pace and Sync.
+ */
+int addMarkersFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	for(int i = 1; i < argc; i++)
+	{
+		ecgMarkerType_t type;
+		uint32_t frameIndex = 0;
+
+		if(!ecgMarkerTypeFromSymbol(argv[i][0], &type) || argv[i][1] != ':' ||
+				sscanf(&argv[i][2],"%lu",&frameIndex) != 1 || frameIndex > UINT16_MAX ||
+				!addEcgMarker(type, (uint16_t)frameIndex))
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+	}
+
+	CLI_Print(ackText, strlen(ackText));
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief SetMarkerTrigger [types], e.g. "RP", the marker types that open a
+ * latency measurement window. Without types no marker opens one.
+ */
+int setMarkerTriggerFn(int argc, char* argv[])
+{
+	uint8_t mask = 0;
+
+	if(argc >= 2)
+	{
+		for(char* symbol = argv[1]; *symbol != '\0'; symbol++)
+		{
+			ecgMarkerType_t type;
+
+			if(!ecgMarkerTypeFromSymbol(*symbol, &type))
+			{
+				return E_COMMAND_BAD_COMMAND;
+			}
+			mask |= 1 << type;
+		}
+	}
+
+	setEcgMarkerTriggerMask(mask);
+	CLI_Print(ackText, strlen(ackText));
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+int getMarkerStatsFn(int argc, char* argv[])
+{
+	ecgMarkerStats_t stats;
+	char str[120];
+
+	getEcgMarkerStats(&stats);
+	int len = sprintf(str,"R: %lu P: %lu S: %lu Windows: %lu Dropped: %lu Mask: %02X\n",
+			stats.markers[ECG_MARKER_R_PEAK], stats.markers[ECG_MARKER_PACE], stats.markers[ECG_MARKER_SYNC],
+			stats.windows, stats.dropped, stats.triggerMask);
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief SetI2cSpeed <100000|400000> selects standard or fast mode for the
+ * DAC bus; with no argument it reports the speed in use. Refused during
+ * continuous output.
+ */
+int setI2cSpeedFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		char str[30];
+		int len = sprintf(str,"I2C: %lu Hz\n",VoltageControllerGetBusSpeed());
+		CLI_Print(str,len);
+		return E_COMMAND_GOOD_COMMAND;
+	}
+
+	uint32_t clockSpeed = 0;
+	sscanf(argv[1],"%lu",&clockSpeed);
+
+	if(OsAppSetDacBusSpeed(clockSpeed))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief DacSelfTest measures complete DAC frames per second at each bus
+ * speed; the result is the highest sample rate the bus can keep up with.
+ * Refused during continuous output and calibration.
+ */
+int dacSelfTestFn(int argc, char* argv[])
+{
+	voltageControllerRateTest_t results[DAC_SELF_TEST_SPEED_COUNT];
+	char str[60];
+
+	if(!OsAppRunDacSelfTest(results))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+	for(int i = 0; i < DAC_SELF_TEST_SPEED_COUNT; i++)
+	{
+		int len = sprintf(str,"I2C: %lu Hz Frames: %lu/s Errors: %lu\n",
+				results[i].clockSpeed, results[i].framesPerSecond, results[i].writeErrors);
+		CLI_Print(str,len);
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief SetContinuous <0|1> streams lead 0 as one open I2C transaction paced
+ * by the bus clock; with no argument it reports the mode and achieved rate.
+ * Refused during calibration.
+ */
+int setContinuousFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		char str[50];
+		int len = sprintf(str,"Continuous: %d Rate: %lu Hz\n",
+				VoltageControllerIsStreaming(), VoltageControllerGetStreamRate());
+		CLI_Print(str,len);
+		return E_COMMAND_GOOD_COMMAND;
+	}
+
+	uint32_t enable = 0;
+	sscanf(argv[1],"%lu",&enable);
+
+	if(enable <= 1 && OsAppSetContinuousOutput(enable == 1))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief SetOutput <dac|pwm|capture> selects the output backend; with no
+ * argument it reports the backend in use and its capabilities. Refused
+ * during calibration.
+ */
+int setOutputFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		voltageBackendCapabilities_t capabilities;
+		char str[90];
+
+		VoltageControllerGetCapabilities(&capabilities);
+		int len = sprintf(str,"Output: %s Channels: %d Bits: %d MaxRate: %lu Hz Flags: %lu\n",
+				VoltageControllerGetBackendName(VoltageControllerGetBackend()), capabilities.channelCount,
+				capabilities.resolutionBits, capabilities.maxRateHz, capabilities.flags);
+		CLI_Print(str,len);
+		return E_COMMAND_GOOD_COMMAND;
+	}
+
+	voltageBackendType_t backend;
+	if(VoltageControllerBackendFromName(argv[1], &backend) && OsAppSetOutputBackend(backend))
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+	else
+		return E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief GetCapture [reset], frames seen by the capture backend and their CRC-32
+ */
+int getCaptureFn(int argc, char* argv[])
+{
+	voltageControllerCaptureStats_t stats;
+	char str[70];
+
+	VoltageControllerGetCaptureStats(&stats);
+	int len = sprintf(str,"Captured: %lu Crc: %08lx Last: %u %u\n",
+			stats.frames, stats.crc, stats.lastFrame[0], stats.lastFrame[1]);
+	CLI_Print(str,len);
+
+	if(argc >= 2 && strcmp(argv[1], "reset") == 0)
+	{
+		VoltageControllerResetCapture();
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief Benchmark <frames> renders frames straight into the output backend
+ * as fast as it accepts them and reports the throughput. Refused during
+ * continuous output and calibration.
+ */
+int benchmarkFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t frameCount = 0;
+	playbackBenchmark_t result;
+	char str[70];
+
+	sscanf(argv[1],"%lu",&frameCount);
+	if(!OsAppRunPlaybackBenchmark(frameCount, &result))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	int len = sprintf(str,"Frames: %lu Rate: %lu/s Cycles: %lu\n",
+			result.frames, result.framesPerSecond, result.cyclesPerFrame);
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief GetI2cHealth [reset], DAC bus error counters and recoveries. Frames
+ * dropped while the bus was down show up as overruns.
+ */
+int getI2cHealthFn(int argc, char* argv[])
+{
+	i2cBusHealth_t health;
+	char str[150];
+
+	I2cBusGetHealth(&health);
+	int len = sprintf(str,"Nack: %lu Timeout: %lu ArbLost: %lu BusErr: %lu Busy: %lu Recovered: %lu Failed: %lu Overruns: %lu Pending: %d\n",
+			health.nacks, health.timeouts, health.arbitrationLosses, health.busErrors, health.busy,
+			health.recovered, health.failedRecoveries, OsAppGetSampleOverrunCount(), health.recoveryPending);
+	CLI_Print(str,len);
+
+	if(argc >= 2 && strcmp(argv[1], "reset") == 0)
+	{
+		I2cBusResetHealth();
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief CalStart stops playback and turns the DAC correction off for a
+ * calibration run
+ */
+int calStartFn(int argc, char* argv[])
+{
+	if(!OsAppStartDacCalibration())
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	CLI_Print(ackText, strlen(ackText));
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief CalPoint <channel> <knot> drives the knot code on the channel and
+ * prints it; CalPoint <channel> <knot> <nV> records the RA–LA voltage
+ * measured there
+ */
+int calPointFn(int argc, char* argv[])
+{
+	if(argc < 3)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t channel = 0;
+	uint32_t knot = 0;
+	sscanf(argv[1],"%lu",&channel);
+	sscanf(argv[2],"%lu",&knot);
+
+	if(argc >= 4)
+	{
+		int32_t measuredNv = 0;
+		sscanf(argv[3],"%ld",&measuredNv);
+		if(channel > UINT8_MAX || knot > UINT8_MAX || !DacCalibrationRecord(channel, knot, measuredNv))
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+		CLI_Print(ackText, strlen(ackText));
+		return E_COMMAND_GOOD_COMMAND;
+	}
+
+	if(channel > UINT8_MAX || knot > UINT8_MAX || !OsAppDriveCalibrationPoint(channel, knot))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	char str[20];
+	int len = sprintf(str,"Code: %u\n", DacCalibrationGetKnotCode(knot));
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief CalEnd [save] fits, stores and applies the recorded points, or
+ * drops them, and resumes playback
+ */
+int calEndFn(int argc, char* argv[])
+{
+	bool save = (argc >= 2 && strcmp(argv[1], "save") == 0);
+
+	if(!OsAppEndDacCalibration(save))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	CLI_Print(ackText, strlen(ackText));
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief GetCal [clear], the calibration in use per channel; clear erases it
+ */
+int getCalFn(int argc, char* argv[])
+{
+	dacCalibrationTable_t table;
+	char str[100];
+
+	if(argc >= 2 && strcmp(argv[1], "clear") == 0 && !DacCalibrationClear())
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	DacCalibrationGetTable(&table);
+	for(int i = 0; i < DAC_CHANNEL_COUNT; i++)
+	{
+		int32_t maxInlNv = 0;
+		for(int k = 0; k < DAC_CALIBRATION_KNOT_COUNT; k++)
+		{
+			int32_t inlNv = table.inlNv[i][k] < 0 ? -table.inlNv[i][k] : table.inlNv[i][k];
+			if(inlNv > maxInlNv)
+			{
+				maxInlNv = inlNv;
+			}
+		}
+
+		int len = sprintf(str,"Channel: %d Cal: %d Offset: %ld nV Gain: %ld pV Inl: %ld nV\n",
+				i, (int)((table.channelMask >> i) & 1), table.offsetNv[i], table.gainPvPerCode[i], maxInlNv);
+		CLI_Print(str,len);
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief Asks for the frames from the expected one on, once per gap so a
+ * window of frames after a bad one does not repeat the request
+ */
+static void binaryUploadNak()
+{
+	if(g_binaryUpload.nakSent)
+	{
+		return;
+	}
+
+	char str[20];
+	int len = sprintf(str,"Nak %u\n", g_binaryUpload.nextSequence);
+	CLI_Print(str,len);
+	g_binaryUpload.nakSent = true;
+}
+
+/**
+ * @brief Checks one received frame and feeds its samples to the upload
+ * @return false when the upload is over and the line goes back to commands
+ */
+static bool binaryUploadFrame()
+{
+	uint8_t* frame = g_binaryUpload.frame;
+
+	//Decoded in place, the output never overtakes the input
+	cobs_decode_result result = cobs_decode(frame, sizeof(g_binaryUpload.frame), frame, g_binaryUpload.length);
+	uint32_t payloadLength = result.out_len - BINARY_UPLOAD_CRC_SIZE;
+
+	if(g_binaryUpload.overflow || result.status != COBS_DECODE_OK ||
+			result.out_len < BINARY_UPLOAD_SEQUENCE_SIZE + BINARY_UPLOAD_CRC_SIZE || payloadLength % 2 != 0)
+	{
+		binaryUploadNak();
+		return true;
+	}
+
+	uint32_t crc = frame[payloadLength] | ((uint32_t)frame[payloadLength + 1] << 8) |
+			((uint32_t)frame[payloadLength + 2] << 16) | ((uint32_t)frame[payloadLength + 3] << 24);
+	if(Crc32Update(CRC32_INITIAL_VALUE, frame, payloadLength) != crc)
+	{
+		binaryUploadNak();
+		return true;
+	}
+
+	//A repeat of a frame already taken is acked again, its ack may be the one
+	//that got lost; a frame past a gap asks for the gap
+	uint16_t sequence = frame[0] | ((uint16_t)frame[1] << 8);
+	if(sequence != g_binaryUpload.nextSequence)
+	{
+		if((int16_t)(sequence - g_binaryUpload.nextSequence) > 0)
+		{
+			binaryUploadNak();
+		}
+		else if(g_binaryUpload.nextSequence != 0)
+		{
+			char str[20];
+			int len = sprintf(str,"Ack %u\n", (uint16_t)(g_binaryUpload.nextSequence - 1));
+			CLI_Print(str,len);
+		}
+		return true;
+	}
+
+	uint32_t count = (payloadLength - BINARY_UPLOAD_SEQUENCE_SIZE) / 2;
+	if(count == 0)
+	{
+		CLI_PrintLine("Abort\n");
+		return false;
+	}
+	if(count > g_binaryUpload.remaining)
+	{
+		CLI_PrintLine("Fail\n");
+		return false;
+	}
+
+	uint16_t progress;
+	uint16_t totalSize;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		uint8_t* sample = &frame[BINARY_UPLOAD_SEQUENCE_SIZE + i * 2];
+		if(!getEcgDownloadProgress(&progress, &totalSize) ||
+				!downloadEcgData(progress, sample[0] | ((uint16_t)sample[1] << 8)))
+		{
+			CLI_PrintLine("Fail\n");
+			return false;
+		}
+	}
+
+	char str[20];
+	int len = sprintf(str,"Ack %u\n", sequence);
+	CLI_Print(str,len);
+	g_binaryUpload.nextSequence++;
+	g_binaryUpload.nakSent = false;
+	g_binaryUpload.remaining -= count;
+
+	if(g_binaryUpload.remaining == 0 || !getEcgDownloadProgress(&progress, &totalSize))
+	{
+		CLI_PrintLine("Done\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Raw mode handler, collects a frame up to its zero byte
+ */
+static bool binaryUploadByte(uint8_t data)
+{
+	if(data != 0)
+	{
+		if(g_binaryUpload.length < sizeof(g_binaryUpload.frame))
+		{
+			g_binaryUpload.frame[g_binaryUpload.length++] = data;
+		}
+		else
+		{
+			g_binaryUpload.overflow = true;
+		}
+		return true;
+	}
+
+	bool more = (g_binaryUpload.length == 0) || binaryUploadFrame();
+	g_binaryUpload.length = 0;
+	g_binaryUpload.overflow = false;
+	return more;
+}
+
+/**
+ * @brief BinaryUpload [samples] takes the samples of the upload started with
+ * InitiateEcgDownload or InitiateTemplateDownload as binary frames. Every
+ * good frame is acked, a repeat of one already taken is acked again, up to
+ * the window may be in flight, and a bad or missing one is asked for again
+ * with Nak. Replies: Binary <max samples>
+ * <window>, then Ack/Nak per frame and Done, Fail or Abort at the end.
+ * With a sample count it is Done after that many, so a delta upload can
+ * mix it with KeepEcgData.
+ */
+int binaryUploadFn(int argc, char* argv[])
+{
+	uint16_t progress;
+	uint16_t totalSize;
+
+	if(!getEcgDownloadProgress(&progress, &totalSize))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	g_binaryUpload.remaining = totalSize - progress;
+	if(argc >= 2)
+	{
+		uint32_t samples = 0;
+		sscanf(argv[1],"%lu",&samples);
+		if(samples == 0 || samples > g_binaryUpload.remaining)
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+		g_binaryUpload.remaining = samples;
+	}
+
+	g_binaryUpload.length = 0;
+	g_binaryUpload.nextSequence = 0;
+	g_binaryUpload.overflow = false;
+	g_binaryUpload.nakSent = false;
+
+	char str[30];
+	int len = sprintf(str,"Binary: %d %d\n", BINARY_UPLOAD_MAX_SAMPLES, BINARY_UPLOAD_WINDOW);
+	CLI_Print(str,len);
+
+	CLI_EnterRawMode(binaryUploadByte, BINARY_UPLOAD_IDLE_TIMEOUT_MS, NULL);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief No confirmation at the new rate, go back to the old one
+ */
+static void baudConfirmTimeout()
+{
+	UART_SetBaudRate(DEBUG_UART, g_baudConfirm.previousRate);
+}
+
+/**
+ * @brief Raw mode handler after a rate change, waits for ConfirmBaud. Noise
+ * from a host still at the old rate does not keep it waiting forever.
+ */
+static bool baudConfirmByte(uint8_t data)
+{
+	if(HAL_GetTick() - g_baudConfirm.startTick > BAUD_CONFIRM_TIMEOUT_MS)
+	{
+		baudConfirmTimeout();
+		return false;
+	}
+
+	if(data != '\r')
+	{
+		if(g_baudConfirm.length < sizeof(g_baudConfirm.line))
+		{
+			g_baudConfirm.line[g_baudConfirm.length++] = (char)data;
+		}
+		return true;
+	}
+
+	bool confirmed = (g_baudConfirm.length == sizeof(g_baudConfirm.line) - 1 &&
+			strncmp(g_baudConfirm.line, COMMAND_CONFIRM_BAUD, g_baudConfirm.length) == 0);
+	g_baudConfirm.length = 0;
+
+	if(confirmed)
+	{
+		CLI_Print(ackText, strlen(ackText));
+		return false;
+	}
+	if(++g_baudConfirm.badLines >= BAUD_CONFIRM_MAX_LINES)
+	{
+		baudConfirmTimeout();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief SetBaudRate [rate] switches the command link. The ack goes out at
+ * the old rate, then the host must send ConfirmBaud at the new one within
+ * BAUD_CONFIRM_TIMEOUT_MS or the device falls back. Without a rate it
+ * prints the current one.
+ */
+int setBaudRateFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		char str[30];
+		int len = sprintf(str,"Baud: %lu\n", UART_GetBaudRate(DEBUG_UART));
+		CLI_Print(str,len);
+		return E_COMMAND_GOOD_COMMAND;
+	}
+
+	uint32_t baudRate = 0;
+	bool supported = false;
+	sscanf(argv[1],"%lu",&baudRate);
+
+	for(uint32_t i = 0; i < sizeof(g_baudRates) / sizeof(g_baudRates[0]); i++)
+	{
+		supported |= (g_baudRates[i] == baudRate);
+	}
+	if(!supported)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	g_baudConfirm.previousRate = UART_GetBaudRate(DEBUG_UART);
+	g_baudConfirm.length = 0;
+	g_baudConfirm.badLines = 0;
+
+	CLI_Print(ackText, strlen(ackText));
+	if(!UART_SetBaudRate(DEBUG_UART, baudRate))
+	{
+		baudConfirmTimeout();
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	g_baudConfirm.startTick = HAL_GetTick();
+	CLI_EnterRawMode(baudConfirmByte, BAUD_CONFIRM_TIMEOUT_MS, baudConfirmTimeout);
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief CRC-32 of a range of the latest normal beat, samples little endian
+ */
+static bool crcEcgSamples(uint32_t start, uint32_t end, uint32_t* crc)
+{
+	uint16_t samples[BLOCK_CRC_CHUNK_SAMPLES];
+
+	*crc = CRC32_INITIAL_VALUE;
+	for(uint32_t index = start; index < end; index += BLOCK_CRC_CHUNK_SAMPLES)
+	{
+		uint32_t count = (end - index > BLOCK_CRC_CHUNK_SAMPLES) ? BLOCK_CRC_CHUNK_SAMPLES : end - index;
+		if(!readEcgSamples(index, samples, count))
+		{
+			return false;
+		}
+		*crc = Crc32Update(*crc, (const uint8_t*)samples, count * sizeof(samples[0]));
+	}
+	return true;
+}
+
+/**
+ * @brief GetBlockCrcs <block size> splits the normal beat playing or waiting
+ * to take over, interleaved as uploaded, into blocks and prints the CRC-32 of each, samples little
+ * endian as zlib.crc32 sees them. Replies: Blocks: <count> Samples: <total>,
+ * then one hex CRC per line. The last block may be short.
+ */
+int getBlockCrcsFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t blockSize = 0;
+	sscanf(argv[1],"%lu",&blockSize);
+
+	uint32_t total = getEcgSampleCount();
+	if(blockSize == 0 || total == 0)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	char str[40];
+	int len = sprintf(str,"Blocks: %lu Samples: %lu\n", (total + blockSize - 1) / blockSize, total);
+	CLI_Print(str,len);
+
+	for(uint32_t start = 0; start < total; start += blockSize)
+	{
+		uint32_t end = (total - start > blockSize) ? start + blockSize : total;
+		uint32_t crc;
+
+		if(!crcEcgSamples(start, end, &crc))
+		{
+			return E_COMMAND_BAD_COMMAND;
+		}
+
+		len = sprintf(str,"%08lX\n", crc);
+		CLI_Print(str,len);
+	}
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief KeepEcgData <samples> takes the next samples of an upload from the
+ * playing beat, the blocks GetBlockCrcs showed unchanged
+ */
+int keepEcgDataFn(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		return E_COMMAND_FEW_ARGS;
+	}
+
+	uint32_t count = 0;
+	sscanf(argv[1],"%lu",&count);
+
+	if(count == 0 || count > UINT16_MAX || !keepEcgData((uint16_t)count))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	CLI_Print(ackText, strlen(ackText));
+	return E_COMMAND_GOOD_COMMAND;
+}
+
+/**
+ * @brief ReadEcg [start] [samples] streams a range of the normal beat
+ * playing or waiting to take over, the whole beat by default. Replies:
+ * Readback: <samples> <max samples per frame>, then the frames, each COBS
+ * encoded and ended by a zero byte, then End: <frames> <CRC-32 of the
+ * samples sent>, also ended by a zero byte. A read that fails part way
+ * still sends the trailer, with the frames that went out.
+ */
+int readEcgFn(int argc, char* argv[])
+{
+	uint32_t total = getEcgSampleCount();
+	uint32_t start = 0;
+	uint32_t count = 0;
+
+	if(argc >= 2)
+	{
+		sscanf(argv[1],"%lu",&start);
+	}
+	if(start > total)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+	count = total - start;
+	if(argc >= 3)
+	{
+		sscanf(argv[2],"%lu",&count);
+	}
+	if(count > total - start)
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	char str[40];
+	int len = sprintf(str,"Readback: %lu %d\n", count, READBACK_MAX_SAMPLES);
+	CLI_Print(str,len);
+
+	uint8_t payload[READBACK_MAX_FRAME];
+	uint8_t frame[COBS_ENCODE_DST_BUF_LEN_MAX(READBACK_MAX_FRAME) + 1];
+	uint16_t samples[READBACK_MAX_SAMPLES];
+	uint32_t frames = 0;
+	uint32_t samplesCrc = CRC32_INITIAL_VALUE;
+	bool status = true;
+	for(uint32_t index = start; index < start + count; index += READBACK_MAX_SAMPLES)
+	{
+		uint32_t frameSamples = (start + count - index > READBACK_MAX_SAMPLES) ? READBACK_MAX_SAMPLES : start + count - index;
+		if(!readEcgSamples(index, samples, frameSamples))
+		{
+			status = false;
+			break;
+		}
+
+		uint32_t length = 0;
+		payload[length++] = (uint8_t)index;
+		payload[length++] = (uint8_t)(index >> 8);
+		for(uint32_t i = 0; i < frameSamples; i++)
+		{
+			payload[length++] = (uint8_t)samples[i];
+			payload[length++] = (uint8_t)(samples[i] >> 8);
+		}
+		samplesCrc = Crc32Update(samplesCrc, &payload[READBACK_INDEX_SIZE], length - READBACK_INDEX_SIZE);
+		uint32_t crc = Crc32Update(CRC32_INITIAL_VALUE, payload, length);
+		for(int i = 0; i < BINARY_UPLOAD_CRC_SIZE; i++)
+		{
+			payload[length++] = (uint8_t)(crc >> (8 * i));
+		}
+
+		cobs_encode_result result = cobs_encode(frame, sizeof(frame) - 1, payload, length);
+		frame[result.out_len] = 0;
+		CLI_Print((char*)frame, result.out_len + 1);
+		frames++;
+	}
+
+	//Sent with the zero sprintf ends it with, so it reads like a frame
+	len = sprintf(str,"End: %lu %08lX\n", frames, samplesCrc);
+	CLI_Print(str,len + 1);
+	return status ? E_COMMAND_GOOD_COMMAND : E_COMMAND_BAD_COMMAND;
+}
+
+/**
+ * @brief VerifyEcg checks the normal beat playing or waiting to take over
+ * in one round trip. Replies: Length: <samples> Peak: <frame> Crc: <CRC-32
+ * of the samples, little endian, as zlib.crc32 sees them>. Refused with
+ * Upload incomplete while an upload is still in progress or none was made.
+ */
+int verifyEcgFn(int argc, char* argv[])
+{
+	uint32_t total = getEcgSampleCount();
+	uint32_t crc;
+
+	if(isEcgUploadInProgress() || total == 0)
+	{
+		CLI_PrintLine("Upload incomplete\n");
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	if(!crcEcgSamples(0, total, &crc))
+	{
+		return E_COMMAND_BAD_COMMAND;
+	}
+
+	char str[50];
+	int len = sprintf(str,"Length: %lu Peak: %d Crc: %08lX\n", total, getEcgPeakIndex(), crc);
+	CLI_Print(str,len);
+	return E_COMMAND_GOOD_COMMAND;
+}
@@ -11,146 +11,1113 @@
 #include "VoltageController.h"
 #include "TriggerDetectApplication.h"
 #include "Stopwatch.h"
+#include "SampleClock/SampleClock.h"
+#include "FixedPoint/FixedPoint.h"
+#include "WaveformLibrary/WaveformLibrary.h"
+#include "CircularQueue/CircularQueue.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
 
 
 ecg_config_t g_ecgConfig = {
         .fs = 1000.0f,   /* sampling rate */
-        .hr = 300.0f,    /* bpm */
-        .noise = 0.00f  /* mV noise */
+        .hr = 300.0f     /* bpm */
     };
 
 
 
-uint16_t g_rawControllerData[MAX_SAMPLES];
+/*
+ * Playback reads from the active bank while uploads land in the shadow bank.
+ * The banks are swapped by the sample clock at the loop boundary.
+ */
+ecgWaveformBank_t g_ecgBanks[ECG_BANK_COUNT];
+volatile uint8_t g_activeBank = 0;
+volatile bool g_bankSwapPending = false;
+waveformDecoder_t g_ecgDecoder;
+waveformEncoder_t g_ecgEncoder;
+uint16_t g_ecgDownloadPeakValue = 0;
+uint8_t g_ecgChannelCount = 1;
+
+/*
+ * Heart rate retiming: a Q16.16 phase accumulator walks the stored beat.
+ * Samples inside the P-QRS-T window advance one per tick, only the TP
+ * segment is stretched or compressed to reach the requested RR interval.
+ */
+volatile uint16_t g_retimeHeartRate = 0;
+volatile bool g_retimeUpdateRequired = false;
+bool g_retimePrimed = false;
+uint32_t g_retimePhase = 0;
+uint32_t g_retimeFixedIncrement = ECG_RETIME_ONE;
+uint32_t g_retimeTpIncrement = ECG_RETIME_ONE;
+int g_retimeWindowStart = 0;
+int g_retimeWindowLength = 0;
+int g_retimeCurrentIndex = 0;
+int g_retimeNextIndex = 0;
+uint32_t g_retimeSampleRate = 0;
+uint16_t g_retimeCurrent[ECG_CHANNEL_COUNT];
+uint16_t g_retimeNext[ECG_CHANNEL_COUNT];
 int g_Rpeaks[MAX_PEAKS];
-int g_peakIndex = MAX_SAMPLES + 1;
-int g_waveformSize = 0;
 int g_waveformIndex = 0;
 bool g_ecgUpdateRequired = true;
 uint16_t g_ecgDownloadTotalSize = 0;
 uint16_t g_ecgDownloadProgress = 0;
-ecgDownloadState_t g_ecgDownloadState = ECG_DOWNLOAD_STATE_IDLE;
+volatile ecgDownloadState_t g_ecgDownloadState = ECG_DOWNLOAD_STATE_IDLE;
+ecgBeatTemplate_t* g_ecgDownloadTemplate = NULL;
+bool g_templateAssembling = false;
+bool g_playbackRewindRequired = false;
+
+/*
+ * Readback: a second decoder walks the latest normal beat for the CLI task.
+ * It only moves forward, so in order reads cost one decode per sample. The
+ * generation changes whenever the shadow bank is rewritten and sends the
+ * decoder back to the start of the beat.
+ */
+waveformDecoder_t g_ecgReadDecoder;
+const ecgWaveformBank_t* g_ecgReadBank = NULL;
+uint32_t g_ecgReadPosition = 0;
+uint32_t g_ecgReadGeneration = 0;
+uint32_t g_ecgBankGeneration = 0;
+
+/*
+ * Marker cursor: walks the annotation run of the template being played.
+ * Markers of a type in the trigger mask open a latency measurement window.
+ */
+uint8_t g_markerCursor = 0;
+uint8_t g_markerEnd = 0;
+volatile uint8_t g_markerTriggerMask = ECG_MARKER_DEFAULT_TRIGGER_MASK;
+volatile uint32_t g_markerCounts[ECG_MARKER_TYPE_COUNT];
+volatile uint32_t g_markerWindows = 0;
+volatile uint32_t g_markerDroppedWindows = 0;
+
+/*
+ * Rhythm sequencer: each step plays one beat template from the active bank
+ * and then holds its last sample until the step's RR interval has elapsed.
+ */
+ecgRhythmStep_t g_rhythmSteps[ECG_RHYTHM_MAX_STEPS];
+volatile uint8_t g_rhythmLength = 0;
+volatile bool g_rhythmRestart = false;
+uint8_t g_rhythmStep = 0;
+uint32_t g_rhythmTicksLeft = 0;
+int g_rhythmBeatIndex = 0;
+ecgBeatTemplate_t* g_rhythmTemplate = NULL;
+uint16_t g_rhythmHoldFrame[ECG_CHANNEL_COUNT];
+
+/*
+ * Heart rate variability: the modulator is stepped once per beat and gives
+ * an RR offset for the beat plus a respiratory gain applied to every sample.
+ */
+hrvModulator_t g_hrvModulator;
+volatile bool g_hrvEnabled = false;
+bool g_hrvBeatStarted = false;
+int32_t g_hrvRrOffsetMs = 0;
+
+/*
+ * Output stage: stored beats are normalized to the full code range and
+ * scaled to the requested amplitude and baseline per sample in Q15.
+ */
+volatile int32_t g_outputGain = ECG_OUTPUT_GAIN_FROM_UV(ECG_PP_UV_TARGET);
+volatile int32_t g_outputOffset = 0;
+uint32_t g_outputAmplitudeUv = ECG_PP_UV_TARGET;
+int32_t g_outputOffsetUv = 0;
+
+/*
+ * Recording artifacts: summed in DAC codes after the gain so they keep their
+ * level whatever the beat amplitude. Configured from the CLI task inside a
+ * critical section, advanced by the sample clock interrupt.
+ */
+artifactGenerator_t g_artifactGenerator;
+volatile bool g_artifactsActive = false;
+
+/*
+ * Streaming: the host pushes samples into a jitter buffer that borrows the
+ * shadow bank storage, so uploads are refused while a stream is running.
+ * The CLI task is the only producer and the sample clock interrupt the
+ * only consumer, so the queue needs no lock between them.
+ */
+CircularQueue_t g_streamQueue;
+volatile bool g_streamActive = false;
+bool g_streamPrefilling = false;
+uint32_t g_streamPrefillBytes = 0;
+uint8_t g_streamChannelCount = 1;
+uint16_t g_streamLastFrame[ECG_CHANNEL_COUNT];
+volatile uint32_t g_streamUnderruns = 0;
+uint32_t g_streamOverruns = 0;
 
 //float g_rawEcgData[MAX_SAMPLES];
 
-static void scaleTo3mVpp(
-    const float *ecg_in,     // real ECG waveform
-    uint16_t length,
-    uint16_t *dac_out        // 12-bit DAC output
-)
+void generateEcgWaveformData()
+{
+//	float rawEcgData[MAX_SAMPLES];
+//	float isolatedBeatData[MAX_SAMPLES];
+
+//	int waveformSize = ecg_generate_beats(&g_ecgConfig, 2, rawEcgData, MAX_SAMPLES, g_Rpeaks, MAX_PEAKS);
+//	isolate_beat(waveformSize, rawEcgData, isolatedBeatData, &waveformSize);
+//	int waveformSize = g_ecgDownloadTotalSize;
+//	g_peakIndex = beat_peak_detect(waveformSize, g_rawEcgData);
+//	g_waveformSize = waveformSize;
+//
+//	g_ecgUpdateRequired = false;
+
+}
+
+/**
+ * @brief Takes over a freshly uploaded bank if one is waiting
+ */
+static void takePendingBank()
+{
+	if(g_bankSwapPending)
+	{
+		g_activeBank ^= 1;
+		g_bankSwapPending = false;
+		g_retimeUpdateRequired = true;
+	}
+}
+
+static ecgMarkerRun_t* getMarkerRun(ecgWaveformBank_t* bank, ecgBeatTemplate_t* beatTemplate)
+{
+	return &bank->markerRuns[beatTemplate - bank->templates];
+}
+
+/**
+ * @brief Positions the decoder and the marker cursor at the first frame of a
+ * template in the active bank
+ */
+static void resetTemplateDecoder(ecgBeatTemplate_t* beatTemplate)
+{
+	ecgWaveformBank_t* bank = &g_ecgBanks[g_activeBank];
+	ecgMarkerRun_t* run = getMarkerRun(bank, beatTemplate);
+
+	WaveformDecoderReset(&g_ecgDecoder, beatTemplate->codec, bank->data + beatTemplate->offset);
+	g_markerCursor = run->offset;
+	g_markerEnd = run->offset + run->count;
+}
+
+/**
+ * @brief Plays the markers on a frame of the current template, opening a
+ * measurement window for each marker type in the trigger mask
+ */
+static void playMarkers(int frameIndex)
+{
+	const uint16_t* markers = g_ecgBanks[g_activeBank].markers;
+
+	while(g_markerCursor < g_markerEnd && ECG_MARKER_GET_INDEX(markers[g_markerCursor]) == frameIndex)
+	{
+		ecgMarkerType_t type = ECG_MARKER_GET_TYPE(markers[g_markerCursor++]);
+
+		g_markerCounts[type]++;
+		if(g_markerTriggerMask & (1 << type))
+		{
+			g_markerWindows++;
+			if(restartStopwatch(&triggerSw))
+			{
+				g_markerDroppedWindows++;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Rewinds playback to the start of the normal beat, taking over a
+ * freshly uploaded bank if one is waiting
+ */
+static ecgBeatTemplate_t* rewindPlayback()
+{
+	g_waveformIndex = 0;
+	g_playbackRewindRequired = false;
+	g_hrvBeatStarted = true;
+	takePendingBank();
+
+	ecgBeatTemplate_t* beatTemplate = &g_ecgBanks[g_activeBank].templates[ECG_BEAT_NORMAL];
+	resetTemplateDecoder(beatTemplate);
+	return beatTemplate;
+}
+
+/**
+ * @brief Fills a frame with the leads that are not stored, they repeat lead 0
+ */
+static void fillMissingLeads(uint16_t* frame, uint8_t channelCount)
+{
+	for(int i = channelCount; i < ECG_CHANNEL_COUNT; i++)
+	{
+		frame[i] = frame[0];
+	}
+}
+
+/**
+ * @brief Decodes the next interleaved frame of the active bank
+ */
+static void decodeFrame(uint16_t* frame)
+{
+	uint8_t channelCount = g_ecgBanks[g_activeBank].channelCount;
+
+	for(int i = 0; i < channelCount; i++)
+	{
+		frame[i] = WaveformDecoderNext(&g_ecgDecoder);
+	}
+	fillMissingLeads(frame, channelCount);
+}
+
+/**
+ * @brief Decodes the stored frame at g_waveformIndex and advances, wrapping
+ * at the loop boundary. The caller plays the markers once the output reaches
+ * the frame.
+ * @param frame decoded DAC codes, one per channel
+ * @param index position of the decoded frame in the beat
+ * @return false when there is nothing to play
+ */
+static bool readStoredSample(uint16_t* frame, int* index)
+{
+	ecgBeatTemplate_t* beatTemplate = &g_ecgBanks[g_activeBank].templates[ECG_BEAT_NORMAL];
+
+	if (g_playbackRewindRequired || g_waveformIndex >= beatTemplate->size)
+	{
+		beatTemplate = rewindPlayback();
+	}
+
+	if(beatTemplate->size == 0)
+	{
+		return false;
+	}
+
+	*index = g_waveformIndex++;
+	decodeFrame(frame);
+	return true;
+}
+
+/**
+ * @brief RR interval the retimed beat is stretched to before variability,
+ * the stored beat length when only variability is enabled
+ */
+static int getRetimeNominalRrTicks(ecgBeatTemplate_t* beatTemplate)
+{
+	if(g_retimeHeartRate == 0)
+	{
+		return beatTemplate->size;
+	}
+	return (int)((g_retimeSampleRate * 60UL) / g_retimeHeartRate);
+}
+
+/**
+ * @brief Recomputes the retiming increments for the normal beat. Only runs
+ * when the heart rate, the sample rate or the bank changes.
+ */
+static void updateRetimeIncrements(ecgBeatTemplate_t* beatTemplate)
+{
+	uint32_t rate = g_retimeSampleRate;
+	int rrTicks = getRetimeNominalRrTicks(beatTemplate) + (int)((g_hrvRrOffsetMs * (int32_t)rate) / 1000L);
+	int preR = (int)((ECG_RETIME_PRE_R_MS * rate) / 1000UL);
+	int postR = (int)((ECG_RETIME_POST_R_MS * rate) / 1000UL);
+	int window = preR + postR + 1;
+
+	if(beatTemplate->size == 0)
+	{
+		return;
+	}
+
+	if(rrTicks < 1)
+	{
+		rrTicks = 1;
+	}
+
+	if(window > beatTemplate->size)
+	{
+		window = beatTemplate->size;
+	}
+
+	int tpStored = beatTemplate->size - window;
+	int tpTarget = rrTicks - window;
+
+	g_retimeWindowStart = (beatTemplate->peakIndex - preR + beatTemplate->size) % beatTemplate->size;
+	g_retimeWindowLength = window;
+
+	if(tpStored > 0 && tpTarget > 0 && tpTarget * ECG_RETIME_MAX_SPEEDUP >= tpStored)
+	{
+		g_retimeFixedIncrement = ECG_RETIME_ONE;
+		g_retimeTpIncrement = ((uint32_t)tpStored << 16) / (uint32_t)tpTarget;
+	}
+	else
+	{
+		//No TP segment to work with, scale the whole beat instead
+		uint32_t increment = ((uint32_t)beatTemplate->size << 16) / (uint32_t)rrTicks;
+		if(increment > ECG_RETIME_MAX_SPEEDUP * ECG_RETIME_ONE)
+		{
+			increment = ECG_RETIME_MAX_SPEEDUP * ECG_RETIME_ONE;
+		}
+		g_retimeFixedIncrement = increment;
+		g_retimeTpIncrement = increment;
+	}
+}
+
+/**
+ * @brief Steps the phase accumulator by one tick. A stored frame's markers
+ * play when the interpolation position reaches it, not when it is read ahead
+ * as the next frame, so a marker fires on the tick its frame goes out.
+ */
+static void advanceRetimePhase()
+{
+	ecgBeatTemplate_t* beatTemplate = &g_ecgBanks[g_activeBank].templates[ECG_BEAT_NORMAL];
+
+	int windowOffset = g_retimeCurrentIndex - g_retimeWindowStart;
+	if(windowOffset < 0)
+	{
+		windowOffset += beatTemplate->size;
+	}
+	g_retimePhase += (windowOffset < g_retimeWindowLength) ? g_retimeFixedIncrement : g_retimeTpIncrement;
+
+	//At most ECG_RETIME_MAX_SPEEDUP stored samples are consumed per tick
+	while(g_retimePhase >= ECG_RETIME_ONE)
+	{
+		g_retimePhase -= ECG_RETIME_ONE;
+		memcpy(g_retimeCurrent, g_retimeNext, sizeof(g_retimeCurrent));
+		g_retimeCurrentIndex = g_retimeNextIndex;
+		//Played before the next read, which may rewind the marker cursor
+		playMarkers(g_retimeCurrentIndex);
+		if(!readStoredSample(g_retimeNext, &g_retimeNextIndex))
+		{
+			g_retimePrimed = false;
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Retimed playback, interpolates between stored frames while the
+ * phase accumulator steps through the beat
+ */
+static bool exportRetimedEcg(uint16_t* frame)
+{
+	if(g_retimePrimed)
+	{
+		advanceRetimePhase();
+	}
+
+	if(!g_retimePrimed)
+	{
+		if(!readStoredSample(g_retimeCurrent, &g_retimeCurrentIndex))
+		{
+			return false;
+		}
+		playMarkers(g_retimeCurrentIndex);
+		if(!readStoredSample(g_retimeNext, &g_retimeNextIndex))
+		{
+			return false;
+		}
+		g_retimePhase = 0;
+		g_retimePrimed = true;
+	}
+
+	ecgBeatTemplate_t* beatTemplate = &g_ecgBanks[g_activeBank].templates[ECG_BEAT_NORMAL];
+
+	if(g_hrvBeatStarted)
+	{
+		g_hrvBeatStarted = false;
+		if(g_hrvEnabled)
+		{
+			g_retimeSampleRate = SampleClockGetRate();
+			g_hrvRrOffsetMs = HrvModulatorNextBeat(&g_hrvModulator,
+					((uint32_t)getRetimeNominalRrTicks(beatTemplate) * 1000UL) / g_retimeSampleRate);
+		}
+		else
+		{
+			g_hrvRrOffsetMs = 0;
+		}
+		g_retimeUpdateRequired = true;
+	}
+
+	if(g_retimeUpdateRequired || g_retimeSampleRate != SampleClockGetRate())
+	{
+		g_retimeUpdateRequired = false;
+		g_retimeSampleRate = SampleClockGetRate();
+		updateRetimeIncrements(beatTemplate);
+	}
+
+	//Interpolate every lead between the two frames around the current phase
+	for(int i = 0; i < ECG_CHANNEL_COUNT; i++)
+	{
+		int32_t delta = (int32_t)g_retimeNext[i] - (int32_t)g_retimeCurrent[i];
+		frame[i] = (uint16_t)((int32_t)g_retimeCurrent[i] + ((delta * (int32_t)(g_retimePhase >> 4)) >> 12));
+	}
+	return true;
+}
+
+/**
+ * @brief Resolves the template a rhythm beat plays, missing templates fall
+ * back to the normal beat
+ * @return NULL when the beat has nothing to play
+ */
+static ecgBeatTemplate_t* getRhythmTemplate(uint8_t beat)
+{
+	ecgWaveformBank_t* bank = &g_ecgBanks[g_activeBank];
+
+	if(beat >= ECG_BEAT_TEMPLATE_COUNT)
+	{
+		return NULL;
+	}
+
+	if(bank->templates[beat].size == 0)
+	{
+		beat = ECG_BEAT_NORMAL;
+	}
+	return (bank->templates[beat].size != 0) ? &bank->templates[beat] : NULL;
+}
+
+/**
+ * @brief R peak position of a rhythm beat, dropped beats keep the timing of the normal beat
+ */
+static int getRhythmPeakIndex(uint8_t beat)
+{
+	ecgBeatTemplate_t* beatTemplate = getRhythmTemplate(beat);
+
+	if(beatTemplate == NULL)
+	{
+		beatTemplate = getRhythmTemplate(ECG_BEAT_NORMAL);
+	}
+	return (beatTemplate != NULL) ? beatTemplate->peakIndex : 0;
+}
+
+/**
+ * @brief Loads the next step of the rhythm script. The step length is
+ * measured from this beat's R peak to the next one, so templates with
+ * different pre-R lengths still land on the requested RR interval.
+ * @return false when the active bank has no beats to play
+ */
+static bool startRhythmStep()
+{
+	if(g_rhythmRestart)
+	{
+		g_rhythmRestart = false;
+		g_rhythmStep = 0;
+		for(int i = 0; i < ECG_CHANNEL_COUNT; i++)
+		{
+			g_rhythmHoldFrame[i] = ECG_NORMALIZED_MID_CODE;
+		}
+	}
+
+	//Beat boundaries are the only place a new bank can take over
+	takePendingBank();
+
+	ecgBeatTemplate_t* normalTemplate = getRhythmTemplate(ECG_BEAT_NORMAL);
+	if(normalTemplate == NULL)
+	{
+		return false;
+	}
+
+	ecgRhythmStep_t step = g_rhythmSteps[g_rhythmStep];
+	g_rhythmStep = (g_rhythmStep + 1) % g_rhythmLength;
+
+	g_rhythmTemplate = getRhythmTemplate(step.beat);
+	g_rhythmBeatIndex = 0;
+
+	int32_t ticks;
+	if(step.rrMs != 0)
+	{
+		ticks = (int32_t)(((uint32_t)step.rrMs * SampleClockGetRate()) / 1000UL);
+	}
+	else
+	{
+		ticks = (g_rhythmTemplate != NULL) ? g_rhythmTemplate->size : normalTemplate->size;
+	}
+	if(g_hrvEnabled && ticks > 0)
+	{
+		uint32_t rate = SampleClockGetRate();
+		ticks += (HrvModulatorNextBeat(&g_hrvModulator, ((uint32_t)ticks * 1000UL) / rate) * (int32_t)rate) / 1000L;
+	}
+	ticks += getRhythmPeakIndex(step.beat) - getRhythmPeakIndex(g_rhythmSteps[g_rhythmStep].beat);
+	g_rhythmTicksLeft = (ticks > 0) ? (uint32_t)ticks : 1;
+
+	if(g_rhythmTemplate != NULL)
+	{
+		resetTemplateDecoder(g_rhythmTemplate);
+	}
+	else
+	{
+		//A dropped beat holds the baseline, not the tail of the beat before
+		for(int i = 0; i < ECG_CHANNEL_COUNT; i++)
+		{
+			g_rhythmHoldFrame[i] = ECG_NORMALIZED_MID_CODE;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Rhythm playback, plays the current beat template and then holds
+ * its last frame until the step's RR interval has elapsed; a dropped beat
+ * holds the baseline for its whole interval
+ */
+static bool exportRhythmEcg(uint16_t* frame)
+{
+	if(g_rhythmRestart || g_rhythmTicksLeft == 0)
+	{
+		if(!startRhythmStep())
+		{
+			return false;
+		}
+	}
+
+	if(g_rhythmTemplate != NULL && g_rhythmBeatIndex < g_rhythmTemplate->size)
+	{
+		playMarkers(g_rhythmBeatIndex);
+		decodeFrame(g_rhythmHoldFrame);
+		g_rhythmBeatIndex++;
+	}
+
+	memcpy(frame, g_rhythmHoldFrame, sizeof(g_rhythmHoldFrame));
+	g_rhythmTicksLeft--;
+	return true;
+}
+
+/**
+ * @brief Maps a normalized frame to the DAC: amplitude gain, the respiratory
+ * gain of the current beat, the baseline offset and the artifacts, which are
+ * common to every lead
+ */
+static void applyOutputStage(uint16_t* frame)
+{
+	int32_t gain = g_outputGain;
+	int32_t baseline = DAC_MID_CODE + g_outputOffset;
+
+	if(g_hrvEnabled)
+	{
+		gain = (gain * HrvModulatorGetGain(&g_hrvModulator)) >> 15;
+	}
+
+	if(g_artifactsActive)
+	{
+		if(g_artifactGenerator.sampleRate != SampleClockGetRate())
+		{
+			ArtifactGeneratorSetSampleRate(&g_artifactGenerator, SampleClockGetRate());
+		}
+		baseline += ArtifactGeneratorNext(&g_artifactGenerator);
+	}
+
+	for(int i = 0; i < ECG_CHANNEL_COUNT; i++)
+	{
+		int32_t value = baseline + ((((int32_t)frame[i] - ECG_NORMALIZED_MID_CODE) * gain) >> 15);
+
+		if(value < 0)
+		{
+			value = 0;
+		}
+		else if(value > DAC_MAX_CODE)
+		{
+			value = DAC_MAX_CODE;
+		}
+		frame[i] = (uint16_t)value;
+	}
+}
+
+/**
+ * @brief Streamed playback. Holds the last frame until the jitter buffer
+ * reaches its prefill level, and again after every underrun.
+ */
+static bool exportStreamSample(uint16_t* frame)
+{
+	uint32_t buffered = CircularQueueGetRemainingData(&g_streamQueue);
+	uint32_t frameBytes = g_streamChannelCount * sizeof(uint16_t);
+
+	if(g_streamPrefilling && buffered >= g_streamPrefillBytes)
+	{
+		g_streamPrefilling = false;
+	}
+
+	if(!g_streamPrefilling)
+	{
+		if(buffered < frameBytes)
+		{
+			g_streamUnderruns++;
+			g_streamPrefilling = true;
+		}
+		else
+		{
+			CircularQueueReadBytes(&g_streamQueue, (uint8_t*)g_streamLastFrame, frameBytes);
+			fillMissingLeads(g_streamLastFrame, g_streamChannelCount);
+		}
+	}
+
+	memcpy(frame, g_streamLastFrame, sizeof(g_streamLastFrame));
+	return true;
+}
+
+/**
+ * @brief Picks the playback mode: a host stream, the rhythm sequencer,
+ * retimed looping or plain looping of the normal beat
+ */
+static bool exportPlaybackSample(uint16_t* frame)
+{
+	int index;
+
+	if(g_streamActive)
+	{
+		return exportStreamSample(frame);
+	}
+
+	if(g_rhythmLength != 0)
+	{
+		//Looped playback starts from the top again once the rhythm is cleared
+		g_playbackRewindRequired = true;
+		g_retimePrimed = false;
+		return exportRhythmEcg(frame);
+	}
+
+	if(g_retimeHeartRate != 0 || g_hrvEnabled)
+	{
+		return exportRetimedEcg(frame);
+	}
+
+	g_retimePrimed = false;
+	if(!readStoredSample(frame, &index))
+	{
+		return false;
+	}
+	playMarkers(index);
+	return true;
+}
+
+/**
+ * @brief Advances playback by one frame. Runs from the sample clock
+ * interrupt, so it only does index bookkeeping and never touches the bus.
+ * @param dacCodes ECG_CHANNEL_COUNT DAC codes to be emitted for this tick
+ * @return false when there is nothing to play
+ */
+bool exportEcg(uint16_t* dacCodes)
+{
+	if(!exportPlaybackSample(dacCodes))
+	{
+		return false;
+	}
+
+	applyOutputStage(dacCodes);
+	return true;
+}
+
+/**
+ * @brief Sets the number of interleaved leads in the next upload or stream
+ */
+bool setEcgChannelCount(uint8_t channelCount)
+{
+	if(channelCount == 0 || channelCount > ECG_CHANNEL_COUNT ||
+			g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_templateAssembling)
+	{
+		return false;
+	}
+
+	g_ecgChannelCount = channelCount;
+	return true;
+}
+
+uint8_t getEcgChannelCount()
+{
+	return g_ecgChannelCount;
+}
+
+/**
+ * @brief Retimes the stored beat to the given heart rate without a new upload
+ * @param heartRate beats per minute, 0 plays the stored beat as uploaded
+ */
+bool setEcgHeartRate(uint16_t heartRate)
+{
+	if(heartRate != 0 && (heartRate < ECG_RETIME_MIN_HEART_RATE || heartRate > ECG_RETIME_MAX_HEART_RATE))
+	{
+		return false;
+	}
+
+	g_retimeHeartRate = heartRate;
+	g_retimeUpdateRequired = true;
+	return true;
+}
+
+uint16_t getEcgHeartRate()
+{
+	return g_retimeHeartRate;
+}
+
+/**
+ * @brief Sets the peak to peak amplitude at RA–LA for a full scale normalized beat
+ * @param amplitudeUv microvolts peak to peak
+ */
+bool setEcgAmplitude(uint32_t amplitudeUv)
+{
+	if(amplitudeUv > ECG_OUTPUT_MAX_AMPLITUDE_UV)
+	{
+		return false;
+	}
+
+	g_outputAmplitudeUv = amplitudeUv;
+	g_outputGain = ECG_OUTPUT_GAIN_FROM_UV(amplitudeUv);
+	return true;
+}
+
+/**
+ * @brief Shifts the baseline at RA–LA
+ * @param offsetUv microvolts, signed
+ */
+bool setEcgOffset(int32_t offsetUv)
+{
+	if(offsetUv > ECG_OUTPUT_MAX_OFFSET_UV || offsetUv < -ECG_OUTPUT_MAX_OFFSET_UV)
+	{
+		return false;
+	}
+
+	g_outputOffsetUv = offsetUv;
+	g_outputOffset = (int32_t)ECG_UV_TO_DAC_CODES(offsetUv);
+	return true;
+}
+
+/**
+ * @brief Enables, scales or disables one artifact source
+ * @param amplitudeUv peak level at RA–LA, 0 turns the source off
+ * @param parameter source specific, see artifactType_t, 0 keeps the current value
+ */
+bool setEcgArtifact(artifactType_t type, uint32_t amplitudeUv, uint32_t parameter)
+{
+	bool status;
+
+	if(amplitudeUv > ECG_ARTIFACT_MAX_AMPLITUDE_UV)
+	{
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	status = ArtifactGeneratorConfigure(&g_artifactGenerator, type,
+			(int32_t)ECG_UV_TO_DAC_CODES(amplitudeUv), parameter);
+	g_artifactsActive = ArtifactGeneratorIsActive(&g_artifactGenerator);
+	taskEXIT_CRITICAL();
+	return status;
+}
+
+uint32_t getEcgAmplitude()
+{
+	return g_outputAmplitudeUv;
+}
+
+int32_t getEcgOffset()
+{
+	return g_outputOffsetUv;
+}
+
+/**
+ * @brief Configures heart rate variability and respiratory modulation
+ * @param config NULL, or zero SDNN and zero amplitude depth, turns it off
+ */
+bool setEcgHrv(const hrvConfig_t* config)
+{
+	hrvModulator_t modulator;
+
+	if(config == NULL || (config->sdnnMs == 0 && config->amplitudeDepth == 0))
+	{
+		g_hrvEnabled = false;
+		return true;
+	}
+
+	if(!HrvModulatorInit(&modulator, config))
+	{
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	g_hrvModulator = modulator;
+	g_hrvEnabled = true;
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+/**
+ * @brief Loads or extends the rhythm script played by the sequencer
+ * @param steps beats to play, in order
+ * @param count number of steps, 0 without append stops the sequencer
+ * @param append adds the steps to the end of the current script
+ */
+bool setEcgRhythm(const ecgRhythmStep_t* steps, uint8_t count, bool append)
+{
+	uint8_t start = append ? g_rhythmLength : 0;
+
+	if(count > ECG_RHYTHM_MAX_STEPS - start)
+	{
+		return false;
+	}
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		if(steps[i].beat >= ECG_BEAT_TYPE_COUNT ||
+				(steps[i].rrMs != 0 && (steps[i].rrMs < ECG_RHYTHM_MIN_RR_MS || steps[i].rrMs > ECG_RHYTHM_MAX_RR_MS)))
+		{
+			return false;
+		}
+	}
+
+	taskENTER_CRITICAL();
+	if(count != 0)
+	{
+		memcpy(&g_rhythmSteps[start], steps, count * sizeof(ecgRhythmStep_t));
+	}
+	g_rhythmLength = start + count;
+	if(!append)
+	{
+		g_rhythmRestart = true;
+	}
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+uint8_t getEcgRhythmLength()
 {
-    float min = FLT_MAX;
-    float max = -FLT_MAX;
-
-    /* Find min and max */
-    for (uint16_t i = 0; i < length; i++) {
-        if (ecg_in[i] < min) min = ecg_in[i];
-        if (ecg_in[i] > max) max = ecg_in[i];
-    }
+	return g_rhythmLength;
+}
 
-    float range = max - min;
+bool ecgBeatTypeFromSymbol(char symbol, ecgBeatType_t* beat)
+{
+	switch(symbol)
+	{
+	case 'N': *beat = ECG_BEAT_NORMAL; break;
+	case 'V': *beat = ECG_BEAT_PVC; break;
+	case 'A': *beat = ECG_BEAT_APC; break;
+	case 'P': *beat = ECG_BEAT_PACED; break;
+	case 'D': *beat = ECG_BEAT_DROPPED; break;
+	default: return false;
+	}
+	return true;
+}
 
-    /* Safety check */
-    if (range < 1e-9f) {
-        for (uint16_t i = 0; i < length; i++)
-            dac_out[i] = DAC_MID_CODE;
-        return;
-    }
+bool isEcgUpdateRequired()
+{
+	return g_ecgUpdateRequired;
+}
 
-    /* Normalize and scale */
-    for (uint16_t i = 0; i < length; i++) {
-        float norm = (ecg_in[i] - min) / range;  // 0 → 1
-        norm = (norm * 2.0f) - 1.0f;              // -1 → +1
+void setEcgUpdateRequired(bool status)
+{
+	g_ecgUpdateRequired = status;
+}
 
-        float dac_f =
-            (float)DAC_MID_CODE +
-            (norm * ECG_DAC_HALF_SWING);
 
-        /* Clamp */
-        if (dac_f < 0.0f) dac_f = 0.0f;
-        if (dac_f > DAC_MAX_CODE) dac_f = DAC_MAX_CODE;
 
-        dac_out[i] = (uint16_t)(dac_f + 0.5f);
-    }
+static ecgWaveformBank_t* getShadowBank()
+{
+	return &g_ecgBanks[g_activeBank ^ 1];
 }
 
-void generateEcgWaveformData()
+/**
+ * @brief The bank playing, or the one taking over at the next loop boundary
+ */
+static ecgWaveformBank_t* getLatestBank()
 {
-//	float rawEcgData[MAX_SAMPLES];
-//	float isolatedBeatData[MAX_SAMPLES];
-
-//	int waveformSize = ecg_generate_beats(&g_ecgConfig, 2, rawEcgData, MAX_SAMPLES, g_Rpeaks, MAX_PEAKS);
-//	isolate_beat(waveformSize, rawEcgData, isolatedBeatData, &waveformSize);
-//	int waveformSize = g_ecgDownloadTotalSize;
-//	g_peakIndex = beat_peak_detect(waveformSize, g_rawEcgData);
-//	scaleTo3mVpp(isolatedBeatData, waveformSize, (uint16_t*)g_rawControllerData);
-//	g_waveformSize = waveformSize;
-//
-//	g_ecgUpdateRequired = false;
-
+	taskENTER_CRITICAL();
+	uint8_t bank = g_bankSwapPending ? g_activeBank ^ 1 : g_activeBank;
+	taskEXIT_CRITICAL();
+	return &g_ecgBanks[bank];
 }
 
-int beatPeakDetect(int total_samples, uint16_t* ecg_waveform)
+/**
+ * @brief The bank an upload is written to while one is in progress or being
+ * assembled, so a readback checks the transfer and not the waveform before
+ * it; otherwise the latest bank
+ */
+static ecgWaveformBank_t* getReadbackBank()
 {
-    uint16_t max_value = 0;
-    int peak_index = -1;
-
-    for (int i = 0; i < total_samples; i++) {
-        if (ecg_waveform[i] > max_value) {
-            max_value = ecg_waveform[i];
-            peak_index = i;
-        }
-    }
+	if(g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_templateAssembling)
+	{
+		return getShadowBank();
+	}
+	return getLatestBank();
+}
 
-    return peak_index;
+/**
+ * @brief Empties a bank, every template and marker
+ */
+static void clearBank(ecgWaveformBank_t* bank)
+{
+	bank->dataLength = 0;
+	bank->markerCount = 0;
+	for(int i = 0; i < ECG_BEAT_TEMPLATE_COUNT; i++)
+	{
+		bank->templates[i].size = 0;
+		bank->markerRuns[i].count = 0;
+	}
 }
 
-void exportEcg()
+/**
+ * @brief Finalizes the markers of a template. Without markers the template
+ * gets one R marker on its peak, with markers the first R marker becomes the
+ * peak used for retiming and rhythm alignment.
+ */
+static void annotateTemplate(ecgWaveformBank_t* bank, ecgBeatTemplate_t* beatTemplate)
 {
-	if(g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE)
+	ecgMarkerRun_t* run = getMarkerRun(bank, beatTemplate);
+
+	if(run->count == 0)
 	{
+		run->offset = bank->markerCount;
+		if(bank->markerCount < ECG_MARKER_MAX_PER_BANK)
+		{
+			bank->markers[bank->markerCount++] = ECG_MARKER(ECG_MARKER_R_PEAK, beatTemplate->peakIndex);
+			run->count = 1;
+		}
 		return;
 	}
 
-	
-	if (g_waveformIndex < g_waveformSize)
+	for(int i = run->offset; i < run->offset + run->count; i++)
 	{
-		if(g_waveformIndex == g_peakIndex)
+		if(ECG_MARKER_GET_TYPE(bank->markers[i]) == ECG_MARKER_R_PEAK)
 		{
-			startStopwatch(&triggerSw);
+			beatTemplate->peakIndex = ECG_MARKER_GET_INDEX(bank->markers[i]);
+			break;
 		}
-		VoltageControllerSetRawVoltage(g_rawControllerData[g_waveformIndex++]);
 	}
-	else
+}
+
+/**
+ * @brief Starts an upload of one beat template into the shadow bank. Refused
+ * while the last upload still waits in the shadow bank for its loop boundary:
+ * it is the waveform GetBlockCrcs reported, so a delta upload must copy from it.
+ * @param totalDownloadSize interleaved samples, a whole number of frames
+ * @param assemble keeps the bank open for further templates until
+ * commitEcgTemplates, otherwise the bank is swapped in once the upload completes
+ */
+static bool startTemplateDownload(ecgBeatType_t beat, uint16_t totalDownloadSize, waveformCodec_t codec, bool assemble)
+{
+	if(beat >= ECG_BEAT_TEMPLATE_COUNT || g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_streamActive ||
+			g_bankSwapPending)
 	{
-		g_waveformIndex = 0;
+		return false;
 	}
+
+	ecgWaveformBank_t* shadowBank = getShadowBank();
+	//A plain upload, or the first template of a new set, starts from an empty bank
+	bool appendToBank = assemble && g_templateAssembling;
+	uint32_t offset = appendToBank ? shadowBank->dataLength : 0;
+
+	if(totalDownloadSize == 0 || totalDownloadSize % g_ecgChannelCount != 0 ||
+			totalDownloadSize > WaveformCodecMaxSamples(codec, ECG_BANK_SIZE_BYTES - offset))
+	{
+		return false;
+	}
+
+	if(!appendToBank)
+	{
+		clearBank(shadowBank);
+		shadowBank->channelCount = g_ecgChannelCount;
+	}
+	g_templateAssembling = assemble;
+	g_ecgBankGeneration++;
+
+	ecgBeatTemplate_t* beatTemplate = &shadowBank->templates[beat];
+	beatTemplate->size = 0;
+	beatTemplate->offset = offset;
+	beatTemplate->codec = codec;
+	shadowBank->markerRuns[beat].offset = shadowBank->markerCount;
+	shadowBank->markerRuns[beat].count = 0;
+	WaveformEncoderInit(&g_ecgEncoder, codec, shadowBank->data + offset, ECG_BANK_SIZE_BYTES - offset);
+
+	g_ecgDownloadTemplate = beatTemplate;
+	g_ecgDownloadTotalSize = totalDownloadSize;
+	g_ecgDownloadProgress = 0;
+	g_ecgDownloadPeakValue = 0;
+	g_ecgDownloadState = ECG_DOWNLOAD_IN_PROCESS;
+	return true;
 }
 
-bool isEcgUpdateRequired()
+bool initiateEcgDownload(uint16_t totalDownloadSize, waveformCodec_t codec)
 {
-	return g_ecgUpdateRequired;
+	return startTemplateDownload(ECG_BEAT_NORMAL, totalDownloadSize, codec, false);
 }
 
-void setEcgUpdateRequired(bool status)
+/**
+ * @brief Adds a beat template to the set being assembled in the shadow bank.
+ * The set goes live with commitEcgTemplates.
+ */
+bool initiateEcgTemplateDownload(ecgBeatType_t beat, uint16_t totalDownloadSize, waveformCodec_t codec)
 {
-	g_ecgUpdateRequired = status;
+	return startTemplateDownload(beat, totalDownloadSize, codec, true);
 }
 
+/**
+ * @brief Annotates the template being uploaded. Markers go in frame order
+ * and may be sent any time before its last sample.
+ * @param frameIndex frame of the template the marker sits on
+ */
+bool addEcgMarker(ecgMarkerType_t type, uint16_t frameIndex)
+{
+	ecgWaveformBank_t* shadowBank = getShadowBank();
+
+	if(g_ecgDownloadState != ECG_DOWNLOAD_IN_PROCESS || type >= ECG_MARKER_TYPE_COUNT ||
+			frameIndex >= g_ecgDownloadTotalSize / shadowBank->channelCount ||
+			shadowBank->markerCount >= ECG_MARKER_MAX_PER_BANK)
+	{
+		return false;
+	}
+
+	ecgMarkerRun_t* run = getMarkerRun(shadowBank, g_ecgDownloadTemplate);
 
+	//The playback cursor only moves forward
+	if(run->count != 0 && frameIndex < ECG_MARKER_GET_INDEX(shadowBank->markers[shadowBank->markerCount - 1]))
+	{
+		return false;
+	}
+
+	shadowBank->markers[shadowBank->markerCount++] = ECG_MARKER(type, frameIndex);
+	run->count++;
+	return true;
+}
 
-bool initiateEcgDownload(uint16_t totalDownloadSize)
+bool ecgMarkerTypeFromSymbol(char symbol, ecgMarkerType_t* type)
 {
-	if(g_ecgDownloadState == ECG_DOWNLOAD_STATE_IDLE)
+	static const char markerSymbols[ECG_MARKER_TYPE_COUNT] = {'R', 'P', 'S'};
+
+	for(int i = 0; i < ECG_MARKER_TYPE_COUNT; i++)
 	{
-		g_ecgDownloadTotalSize = totalDownloadSize;
-		g_ecgDownloadProgress = 0;
-		g_ecgDownloadState = ECG_DOWNLOAD_IN_PROCESS;
-		pauseTriggerDetect();
-		return true;
+		if(markerSymbols[i] == symbol)
+		{
+			*type = (ecgMarkerType_t)i;
+			return true;
+		}
 	}
 	return false;
 }
+
+/**
+ * @brief Selects the marker types that open a measurement window
+ * @param mask bit n set for ecgMarkerType_t n
+ */
+void setEcgMarkerTriggerMask(uint8_t mask)
+{
+	g_markerTriggerMask = mask & ((1 << ECG_MARKER_TYPE_COUNT) - 1);
+}
+
+void getEcgMarkerStats(ecgMarkerStats_t* stats)
+{
+	taskENTER_CRITICAL();
+	for(int i = 0; i < ECG_MARKER_TYPE_COUNT; i++)
+	{
+		stats->markers[i] = g_markerCounts[i];
+	}
+	stats->windows = g_markerWindows;
+	stats->dropped = g_markerDroppedWindows;
+	stats->triggerMask = g_markerTriggerMask;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Hands the assembled template set to playback at the next beat boundary
+ */
+bool commitEcgTemplates()
+{
+	if(!g_templateAssembling || g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE)
+	{
+		return false;
+	}
+
+	//Looped playback and missing templates fall back to the normal beat
+	if(getShadowBank()->templates[ECG_BEAT_NORMAL].size == 0)
+	{
+		return false;
+	}
+
+	g_templateAssembling = false;
+	g_bankSwapPending = true;
+	return true;
+}
+
 bool downloadEcgData(uint16_t currentProgress, uint16_t currentData)
 {
 	bool status = false;
@@ -162,14 +1129,36 @@ bool downloadEcgData(uint16_t currentProgress, uint16_t currentData)
 	case ECG_DOWNLOAD_IN_PROCESS:
 		if (currentProgress == g_ecgDownloadProgress )
 		{
-			g_rawControllerData[g_ecgDownloadProgress++] = currentData;
+			ecgBeatTemplate_t* beatTemplate = g_ecgDownloadTemplate;
+
+			//Variable rate codecs can run out of space before the last sample
+			if(!WaveformEncoderPut(&g_ecgEncoder, currentData))
+			{
+				g_ecgDownloadState = ECG_DOWNLOAD_STATE_IDLE;
+				break;
+			}
+
+			//The stored stream may be lossy, so the peak is tracked on the uploaded lead 0 values
+			uint8_t channelCount = getShadowBank()->channelCount;
+			if(g_ecgDownloadProgress % channelCount == 0 &&
+					(g_ecgDownloadProgress == 0 || currentData > g_ecgDownloadPeakValue))
+			{
+				g_ecgDownloadPeakValue = currentData;
+				beatTemplate->peakIndex = g_ecgDownloadProgress / channelCount;
+			}
+			g_ecgDownloadProgress++;
 
 			if(g_ecgDownloadProgress == g_ecgDownloadTotalSize)
 			{
+				beatTemplate->size = g_ecgDownloadTotalSize / channelCount;
+				beatTemplate->dataLength = WaveformEncoderGetLength(&g_ecgEncoder);
+				getShadowBank()->dataLength += beatTemplate->dataLength;
+				annotateTemplate(getShadowBank(), beatTemplate);
 				g_ecgDownloadState = ECG_DOWNLOAD_STATE_IDLE;
-				g_waveformSize = g_ecgDownloadTotalSize;
-				g_peakIndex = beatPeakDetect(g_waveformSize, g_rawControllerData);
-				resumeTriggerDetect();
+				if(!g_templateAssembling)
+				{
+					g_bankSwapPending = true;
+				}
 			}
 			status = true;
 		}
@@ -181,3 +1170,399 @@ bool downloadEcgData(uint16_t currentProgress, uint16_t currentData)
 	}
 	return status;
 }
+
+/**
+ * @brief Index of the next sample the upload in progress expects
+ * @return false when no upload is in progress
+ */
+bool getEcgDownloadProgress(uint16_t* progress, uint16_t* totalSize)
+{
+	if(g_ecgDownloadState != ECG_DOWNLOAD_IN_PROCESS)
+	{
+		return false;
+	}
+
+	*progress = g_ecgDownloadProgress;
+	*totalSize = g_ecgDownloadTotalSize;
+	return true;
+}
+
+static bool readBankSamples(ecgWaveformBank_t* bank, uint32_t index, uint16_t* samples, uint32_t count);
+
+/**
+ * @brief Takes the next samples of the upload in progress from the playing
+ * normal beat at the same position, so a delta upload only sends the blocks
+ * that changed. Lossy codecs store the decoded values again.
+ * @param count samples to keep
+ * @return false when the upload is not a normal beat of the playing lead
+ * count or runs past the end of the playing beat
+ */
+bool keepEcgData(uint16_t count)
+{
+	ecgWaveformBank_t* shadowBank = getShadowBank();
+	uint16_t sample;
+
+	//With no swap pending the playing bank is the one GetBlockCrcs reported
+	ecgWaveformBank_t* playingBank = &g_ecgBanks[g_activeBank];
+
+	if(g_ecgDownloadState != ECG_DOWNLOAD_IN_PROCESS || g_bankSwapPending ||
+			g_ecgDownloadTemplate != &shadowBank->templates[ECG_BEAT_NORMAL] ||
+			shadowBank->channelCount != playingBank->channelCount)
+	{
+		return false;
+	}
+
+	for(uint16_t i = 0; i < count; i++)
+	{
+		if(!readBankSamples(playingBank, g_ecgDownloadProgress, &sample, 1) ||
+				!downloadEcgData(g_ecgDownloadProgress, sample))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief True from the start of an upload or template set until it is
+ * complete, readbacks then see the bank being written
+ */
+bool isEcgUploadInProgress()
+{
+	return g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_templateAssembling;
+}
+
+/**
+ * @brief Interleaved samples in the latest normal beat
+ */
+uint32_t getEcgSampleCount()
+{
+	ecgWaveformBank_t* bank = getReadbackBank();
+
+	return (uint32_t)bank->templates[ECG_BEAT_NORMAL].size * bank->channelCount;
+}
+
+/**
+ * @brief Frame of the R peak in the latest normal beat
+ */
+int getEcgPeakIndex()
+{
+	return getReadbackBank()->templates[ECG_BEAT_NORMAL].peakIndex;
+}
+
+/**
+ * @brief Reads decoded samples of a bank's normal beat, interleaved as they
+ * were uploaded. Only the CLI task writes the banks, so the one read holds
+ * still even if the sample clock swaps it in meanwhile.
+ * @param index first sample
+ * @return false past the end of the beat
+ */
+static bool readBankSamples(ecgWaveformBank_t* bank, uint32_t index, uint16_t* samples, uint32_t count)
+{
+	ecgBeatTemplate_t* beatTemplate = &bank->templates[ECG_BEAT_NORMAL];
+	uint32_t total = (uint32_t)beatTemplate->size * bank->channelCount;
+
+	if(index > total || count > total - index)
+	{
+		return false;
+	}
+
+	if(g_ecgReadBank != bank || g_ecgReadGeneration != g_ecgBankGeneration || index < g_ecgReadPosition)
+	{
+		WaveformDecoderReset(&g_ecgReadDecoder, beatTemplate->codec, bank->data + beatTemplate->offset);
+		g_ecgReadBank = bank;
+		g_ecgReadPosition = 0;
+		g_ecgReadGeneration = g_ecgBankGeneration;
+	}
+
+	for(; g_ecgReadPosition < index; g_ecgReadPosition++)
+	{
+		WaveformDecoderNext(&g_ecgReadDecoder);
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		samples[i] = WaveformDecoderNext(&g_ecgReadDecoder);
+	}
+	g_ecgReadPosition += count;
+	return true;
+}
+
+/**
+ * @brief Reads decoded samples of the latest normal beat, or of the one an
+ * upload in progress is writing
+ */
+bool readEcgSamples(uint32_t index, uint16_t* samples, uint32_t count)
+{
+	return readBankSamples(getReadbackBank(), index, samples, count);
+}
+
+/**
+ * @brief Library payload bytes the playing bank takes, 0 when nothing is
+ * loaded. SaveWaveform refuses a bank over WAVEFORM_LIBRARY_MAX_PAYLOAD.
+ */
+uint32_t getEcgWaveformSaveSize(void)
+{
+	ecgWaveformBank_t* bank = &g_ecgBanks[g_activeBank];
+
+	if(bank->templates[ECG_BEAT_NORMAL].size == 0)
+	{
+		return 0;
+	}
+	return sizeof(uint32_t) + sizeof(bank->templates) + sizeof(bank->markerRuns) +
+			bank->markerCount * sizeof(bank->markers[0]) + bank->dataLength;
+}
+
+/**
+ * @brief Saves the playing bank, every template, to a flash library slot
+ */
+bool saveEcgWaveform(uint8_t slot, const char* name)
+{
+	ecgWaveformBank_t* bank = &g_ecgBanks[g_activeBank];
+	ecgBeatTemplate_t* normalTemplate = &bank->templates[ECG_BEAT_NORMAL];
+	waveformLibraryHeader_t header = {0};
+	uint32_t bankInfo = bank->channelCount | ((uint32_t)bank->markerCount << 8);
+	uint32_t markersLength = bank->markerCount * sizeof(bank->markers[0]);
+	uint32_t saveSize = getEcgWaveformSaveSize();
+
+	if(saveSize == 0 || saveSize > WAVEFORM_LIBRARY_MAX_PAYLOAD)
+	{
+		return false;
+	}
+
+	strncpy(header.name, name, WAVEFORM_LIBRARY_NAME_LENGTH);
+	header.sampleCount = (uint16_t)normalTemplate->size;
+	header.sampleRate = (uint16_t)SampleClockGetRate();
+	header.peakIndex = (uint16_t)normalTemplate->peakIndex;
+	header.format = ECG_LIBRARY_FORMAT;
+
+	return WaveformLibraryBeginSave(slot) &&
+			WaveformLibraryWrite((const uint8_t*)&bankInfo, sizeof(bankInfo)) &&
+			WaveformLibraryWrite((const uint8_t*)bank->templates, sizeof(bank->templates)) &&
+			WaveformLibraryWrite((const uint8_t*)bank->markerRuns, sizeof(bank->markerRuns)) &&
+			WaveformLibraryWrite((const uint8_t*)bank->markers, markersLength) &&
+			WaveformLibraryWrite(bank->data, bank->dataLength) &&
+			WaveformLibraryEndSave(&header);
+}
+
+/**
+ * @brief Copies a library slot into the shadow bank, it takes over at the
+ * next loop boundary like a fresh upload
+ */
+bool loadEcgWaveform(uint8_t slot)
+{
+	const waveformLibraryHeader_t* header = WaveformLibraryGetEntry(slot);
+	ecgBeatTemplate_t templates[ECG_BEAT_TEMPLATE_COUNT];
+	ecgMarkerRun_t markerRuns[ECG_BEAT_TEMPLATE_COUNT] = {0};
+	uint32_t bankInfo = 1;
+	uint32_t runsLength = 0;
+
+	if(header == NULL || g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_streamActive)
+	{
+		return false;
+	}
+
+	const uint8_t* payload = WaveformLibraryGetPayload(slot);
+	uint32_t length = header->length;
+
+	switch(header->format)
+	{
+	case ECG_LIBRARY_FORMAT:
+		runsLength = sizeof(markerRuns);
+		//Fall through, both formats start with the bank word
+	case ECG_LIBRARY_FORMAT_NO_MARKERS:
+		if(length < sizeof(bankInfo))
+		{
+			return false;
+		}
+		memcpy(&bankInfo, payload, sizeof(bankInfo));
+		payload += sizeof(bankInfo);
+		length -= sizeof(bankInfo);
+		break;
+	case ECG_LIBRARY_FORMAT_SINGLE_LEAD:
+		break;
+	default:
+		return false;
+	}
+
+	uint32_t channelCount = bankInfo & 0xFF;
+	uint32_t markerCount = (runsLength != 0) ? (bankInfo >> 8) & 0xFF : 0;
+	uint32_t markersLength = markerCount * sizeof(uint16_t);
+
+	if(channelCount == 0 || channelCount > ECG_CHANNEL_COUNT || markerCount > ECG_MARKER_MAX_PER_BANK ||
+			length < sizeof(templates) + runsLength + markersLength)
+	{
+		return false;
+	}
+
+	memcpy(templates, payload, sizeof(templates));
+	memcpy(markerRuns, payload + sizeof(templates), runsLength);
+	const uint8_t* markers = payload + sizeof(templates) + runsLength;
+	const uint8_t* data = markers + markersLength;
+	uint32_t dataLength = length - sizeof(templates) - runsLength - markersLength;
+
+	if(dataLength > ECG_BANK_SIZE_BYTES || templates[ECG_BEAT_NORMAL].size == 0)
+	{
+		return false;
+	}
+
+	for(int i = 0; i < ECG_BEAT_TEMPLATE_COUNT; i++)
+	{
+		if(templates[i].size != 0 && (templates[i].codec >= WAVEFORM_CODEC_COUNT ||
+				templates[i].offset + templates[i].dataLength > dataLength ||
+				markerRuns[i].offset + markerRuns[i].count > markerCount))
+		{
+			return false;
+		}
+	}
+
+	//A rate the sample clock refuses fails the load before the shadow bank is touched
+	if(!SampleClockSetRate(header->sampleRate))
+	{
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	g_bankSwapPending = false;
+	taskEXIT_CRITICAL();
+	g_templateAssembling = false;
+	g_ecgBankGeneration++;
+
+	ecgWaveformBank_t* shadowBank = getShadowBank();
+	memcpy(shadowBank->templates, templates, sizeof(templates));
+	memcpy(shadowBank->markerRuns, markerRuns, sizeof(markerRuns));
+	memcpy(shadowBank->markers, markers, markersLength);
+	memcpy(shadowBank->data, data, dataLength);
+	shadowBank->dataLength = dataLength;
+	shadowBank->markerCount = (uint8_t)markerCount;
+	shadowBank->channelCount = (uint8_t)channelCount;
+
+	//Slots saved before the annotation track get one R marker per template
+	if(runsLength == 0)
+	{
+		for(int i = 0; i < ECG_BEAT_TEMPLATE_COUNT; i++)
+		{
+			if(templates[i].size != 0)
+			{
+				annotateTemplate(shadowBank, &shadowBank->templates[i]);
+			}
+		}
+	}
+
+	g_bankSwapPending = true;
+	return true;
+}
+
+/**
+ * @brief Loads the selected library waveform, runs before the tasks start
+ */
+void ecgGeneratorAppInit()
+{
+	uint8_t slot = WaveformLibraryGetSelected();
+
+	ArtifactGeneratorInit(&g_artifactGenerator, SampleClockGetRate());
+
+	if(slot != WAVEFORM_LIBRARY_NO_SELECTION)
+	{
+		loadEcgWaveform(slot);
+	}
+}
+
+/**
+ * @brief Switches playback to the host stream, frames carry the leads set
+ * with setEcgChannelCount
+ * @param prefillSamples samples buffered before playback starts and after an
+ * underrun, 0 for half the buffer
+ */
+bool startEcgStream(uint32_t prefillSamples)
+{
+	uint32_t capacity = ECG_STREAM_CAPACITY_SAMPLES;
+
+	if(g_ecgDownloadState != ECG_DOWNLOAD_STATE_IDLE || g_streamActive || prefillSamples > capacity)
+	{
+		return false;
+	}
+
+	if(prefillSamples == 0)
+	{
+		prefillSamples = capacity / 2;
+	}
+
+	taskENTER_CRITICAL();
+	//A waiting upload goes live now, the shadow bank becomes the jitter buffer
+	takePendingBank();
+	g_templateAssembling = false;
+	CircularQueueInit(&g_streamQueue, getShadowBank()->data, ECG_STREAM_BUFFER_BYTES);
+	g_streamChannelCount = g_ecgChannelCount;
+	for(int i = 0; i < ECG_CHANNEL_COUNT; i++)
+	{
+		g_streamLastFrame[i] = ECG_NORMALIZED_MID_CODE;
+	}
+	//Prefill whole frames, the buffer only ever holds whole frames
+	g_streamPrefillBytes = ((prefillSamples + g_streamChannelCount - 1) / g_streamChannelCount) *
+			g_streamChannelCount * sizeof(uint16_t);
+	g_streamPrefilling = true;
+	g_streamUnderruns = 0;
+	g_streamOverruns = 0;
+	g_streamActive = true;
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+/**
+ * @brief Leaves streaming, looped or rhythm playback starts from the top
+ */
+bool stopEcgStream()
+{
+	ecgWaveformBank_t* shadowBank = getShadowBank();
+
+	if(!g_streamActive)
+	{
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	g_streamActive = false;
+	g_playbackRewindRequired = true;
+	g_retimePrimed = false;
+	g_rhythmTicksLeft = 0;
+	taskEXIT_CRITICAL();
+
+	//The jitter buffer overwrote whatever the shadow bank held
+	clearBank(shadowBank);
+	return true;
+}
+
+/**
+ * @brief Queues streamed samples, interleaved whole frames. Frames that do
+ * not fit are dropped and counted as overruns, the host should not send more
+ * than its credits.
+ */
+bool streamEcgData(const uint16_t* samples, uint32_t count)
+{
+	if(!g_streamActive || count % g_streamChannelCount != 0)
+	{
+		return false;
+	}
+
+	uint32_t space = CircularQueueGetRemainingSpace(&g_streamQueue) / sizeof(uint16_t);
+	space -= space % g_streamChannelCount;
+	uint32_t accepted = (count < space) ? count : space;
+	CircularQueueWriteBytes(&g_streamQueue, (const uint8_t*)samples, accepted * sizeof(uint16_t));
+
+	g_streamOverruns += count - accepted;
+	return true;
+}
+
+void getEcgStreamStats(ecgStreamStats_t* stats)
+{
+	taskENTER_CRITICAL();
+	stats->active = g_streamActive;
+	stats->channelCount = g_streamChannelCount;
+	stats->fill = g_streamActive ? CircularQueueGetRemainingData(&g_streamQueue) / sizeof(uint16_t) : 0;
+	stats->credits = g_streamActive ? CircularQueueGetRemainingSpace(&g_streamQueue) / sizeof(uint16_t) : 0;
+	stats->credits -= stats->credits % g_streamChannelCount;
+	stats->underruns = g_streamUnderruns;
+	stats->overruns = g_streamOverruns;
+	taskEXIT_CRITICAL();
+}
@@ -10,6 +10,24 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "CommonConfigurations.h"
+#include "WaveformCodec/WaveformCodec.h"
+#include "HrvModulator/HrvModulator.h"
+#include "ArtifactGenerator/ArtifactGenerator.h"
+
+/* The two banks together take about the RAM the single sample buffer had.
+ * Each holds 1024 raw, 1365 pack12 or about 4090 adpcm samples, delta up to
+ * 4093 depending on the waveform. The host tools pick the codec that fits. */
+#define ECG_BANK_COUNT		2
+#define ECG_BANK_SIZE_BYTES	2048
+
+/* Heart rate retiming, the window around R is played 1:1 and only TP is resampled */
+#define ECG_RETIME_ONE				(1UL << 16)
+#define ECG_RETIME_MAX_SPEEDUP		4
+#define ECG_RETIME_PRE_R_MS			250UL
+#define ECG_RETIME_POST_R_MS		400UL
+#define ECG_RETIME_MIN_HEART_RATE	20
+#define ECG_RETIME_MAX_HEART_RATE	300
 
 
 typedef enum{
@@ -18,8 +36,161 @@ typedef enum{
 	ECG_DOWNLOAD_STATE_COUNT
 }ecgDownloadState_t;
 
+/*
+ * Uploaded beats are normalized: ECG_NORMALIZED_MID_CODE is the baseline and
+ * +-ECG_NORMALIZED_HALF_SWING is full amplitude. The output stage scales
+ * them with a Q15 gain, so a full scale beat spans the requested amplitude.
+ */
+#define ECG_NORMALIZED_MID_CODE		2048
+#define ECG_NORMALIZED_HALF_SWING	2047
+#define ECG_OUTPUT_GAIN_FROM_UV(uv)	((int32_t)((ECG_UV_TO_DAC_CODES(uv) * 32768LL) / (2 * ECG_NORMALIZED_HALF_SWING)))
+#define ECG_OUTPUT_MAX_AMPLITUDE_UV	3290	//Full DAC swing through the divider
+#define ECG_OUTPUT_MAX_OFFSET_UV	1600
+
+/* Layout of a bank saved to the waveform library: a 32 bit word with the
+ * channel count in the low byte and the marker count in the next, the
+ * template table, the marker runs, the markers, then the data. Format 2 has only the channel
+ * count and no markers, format 1 has neither and is loaded as a single lead;
+ * both get one R marker per template. */
+#define ECG_LIBRARY_FORMAT			3
+#define ECG_LIBRARY_FORMAT_NO_MARKERS	2
+#define ECG_LIBRARY_FORMAT_SINGLE_LEAD	1
+
+/* Artifact amplitudes are peak levels at RA–LA, added after the gain */
+#define ECG_ARTIFACT_MAX_AMPLITUDE_UV	1600
+
+/* Streaming borrows the shadow bank as its jitter buffer, the largest power
+ * of two that fits in it */
+#define ECG_STREAM_BUFFER_BYTES		2048
+#define ECG_STREAM_CAPACITY_SAMPLES	(ECG_STREAM_BUFFER_BYTES / sizeof(uint16_t))
+
+/* Rhythm sequencer, RR of 0 plays the beat for the length of its template */
+#define ECG_RHYTHM_MAX_STEPS		64
+#define ECG_RHYTHM_MIN_RR_MS		200
+#define ECG_RHYTHM_MAX_RR_MS		3000
+
+typedef enum{
+	ECG_BEAT_NORMAL,
+	ECG_BEAT_PVC,
+	ECG_BEAT_APC,
+	ECG_BEAT_PACED,
+	ECG_BEAT_TEMPLATE_COUNT,
+	ECG_BEAT_DROPPED = ECG_BEAT_TEMPLATE_COUNT,	//No template, holds the baseline
+	ECG_BEAT_TYPE_COUNT
+}ecgBeatType_t;
+
+/*
+ * Annotation track: each template owns a run of markers in its bank, sorted
+ * by frame index. The runs sit beside the template table so saved template
+ * tables keep their layout. A marker is a 14 bit frame index and a 2 bit type packed
+ * in a half-word. Playback steps a cursor through the run, so the cost per
+ * frame is one compare. Templates uploaded without markers get one R marker
+ * on their largest lead 0 sample.
+ */
+typedef enum{
+	ECG_MARKER_R_PEAK,
+	ECG_MARKER_PACE,
+	ECG_MARKER_SYNC,
+	ECG_MARKER_TYPE_COUNT
+}ecgMarkerType_t;
+
+#define ECG_MARKER_MAX_PER_BANK		32
+#define ECG_MARKER_INDEX_MASK		0x3FFF
+#define ECG_MARKER_TYPE_SHIFT		14
+#define ECG_MARKER(type, index)		((uint16_t)(((type) << ECG_MARKER_TYPE_SHIFT) | ((index) & ECG_MARKER_INDEX_MASK)))
+#define ECG_MARKER_GET_INDEX(marker)	((int)((marker) & ECG_MARKER_INDEX_MASK))
+#define ECG_MARKER_GET_TYPE(marker)		((ecgMarkerType_t)((marker) >> ECG_MARKER_TYPE_SHIFT))
+
+/* Marker types that open a trigger latency measurement window by default */
+#define ECG_MARKER_DEFAULT_TRIGGER_MASK	(1 << ECG_MARKER_R_PEAK)
+
+typedef struct{
+	uint32_t offset;
+	uint32_t dataLength;
+	waveformCodec_t codec;
+	int size;
+	int peakIndex;
+}ecgBeatTemplate_t;
+
+typedef struct{
+	uint8_t offset;
+	uint8_t count;
+}ecgMarkerRun_t;
+
+/*
+ * Multi-lead waveforms are stored interleaved, one frame of channelCount
+ * samples per tick with lead 0 first. Template sizes and peak indices count
+ * frames, the R peak is found on lead 0. DAC channels beyond the stored
+ * leads repeat lead 0.
+ */
+#define ECG_CHANNEL_COUNT			DAC_CHANNEL_COUNT
+
+typedef struct{
+	uint8_t data[ECG_BANK_SIZE_BYTES];
+	uint32_t dataLength;
+	ecgBeatTemplate_t templates[ECG_BEAT_TEMPLATE_COUNT];
+	ecgMarkerRun_t markerRuns[ECG_BEAT_TEMPLATE_COUNT];
+	uint16_t markers[ECG_MARKER_MAX_PER_BANK];
+	uint8_t markerCount;
+	uint8_t channelCount;
+}ecgWaveformBank_t;
+
+typedef struct{
+	uint8_t beat;
+	uint16_t rrMs;
+}ecgRhythmStep_t;
+
+typedef struct{
+	uint32_t markers[ECG_MARKER_TYPE_COUNT];	//markers played, by type
+	uint32_t windows;		//measurement windows opened
+	uint32_t dropped;		//windows restarted before a trigger closed them
+	uint8_t triggerMask;	//marker types that open a window
+}ecgMarkerStats_t;
+
+typedef struct{
+	bool active;
+	uint8_t channelCount;	//samples per frame
+	uint32_t fill;			//samples buffered
+	uint32_t credits;		//samples the host may send without an overrun
+	uint32_t underruns;		//times playback ran dry
+	uint32_t overruns;		//samples dropped on a full buffer
+}ecgStreamStats_t;
+
+void ecgGeneratorAppInit();
 void generateEcgWaveformData();
-void exportEcg();
+bool exportEcg(uint16_t* dacCodes);
+bool setEcgChannelCount(uint8_t channelCount);
+uint8_t getEcgChannelCount();
 bool downloadEcgData(uint16_t currentProgress, uint16_t currentData);
-bool initiateEcgDownload(uint16_t totalDownloadSize);
+bool getEcgDownloadProgress(uint16_t* progress, uint16_t* totalSize);
+bool keepEcgData(uint16_t count);
+bool isEcgUploadInProgress();
+uint32_t getEcgSampleCount();
+int getEcgPeakIndex();
+bool readEcgSamples(uint32_t index, uint16_t* samples, uint32_t count);
+bool initiateEcgDownload(uint16_t totalDownloadSize, waveformCodec_t codec);
+bool initiateEcgTemplateDownload(ecgBeatType_t beat, uint16_t totalDownloadSize, waveformCodec_t codec);
+bool commitEcgTemplates();
+bool addEcgMarker(ecgMarkerType_t type, uint16_t frameIndex);
+bool ecgMarkerTypeFromSymbol(char symbol, ecgMarkerType_t* type);
+void setEcgMarkerTriggerMask(uint8_t mask);
+void getEcgMarkerStats(ecgMarkerStats_t* stats);
+bool ecgBeatTypeFromSymbol(char symbol, ecgBeatType_t* beat);
+bool setEcgHeartRate(uint16_t heartRate);
+uint16_t getEcgHeartRate();
+bool setEcgHrv(const hrvConfig_t* config);
+bool setEcgArtifact(artifactType_t type, uint32_t amplitudeUv, uint32_t parameter);
+bool setEcgAmplitude(uint32_t amplitudeUv);
+bool setEcgOffset(int32_t offsetUv);
+uint32_t getEcgAmplitude();
+int32_t getEcgOffset();
+uint32_t getEcgWaveformSaveSize(void);
+bool saveEcgWaveform(uint8_t slot, const char* name);
+bool loadEcgWaveform(uint8_t slot);
+bool startEcgStream(uint32_t prefillSamples);
+bool stopEcgStream();
+bool streamEcgData(const uint16_t* samples, uint32_t count);
+void getEcgStreamStats(ecgStreamStats_t* stats);
+bool setEcgRhythm(const ecgRhythmStep_t* steps, uint8_t count, bool append);
+uint8_t getEcgRhythmLength();
 #endif /* ECGGENERATORAPPLICATION_ECGGENERATORAPPLICATION_H_ */
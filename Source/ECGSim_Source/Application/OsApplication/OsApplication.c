@@ -12,6 +12,9 @@
 #include "customUART.h"
 #include "CLIApplication.h"
 #include "TriggerDetectApplication.h"
+#include "SampleClock/SampleClock.h"
+#include "I2cBus/I2cBus.h"
+#include "DacCalibration/DacCalibration.h"
 
 osThreadId_t basicTaskHandle;
 const osThreadAttr_t basicTask_attributes = {
@@ -24,13 +27,6 @@ const osThreadAttr_t basicTask_attributes = {
 
 
 
-osThreadId_t ecgWorkerTaskHandle;
-const osThreadAttr_t ecgWorkerTask_attributes = {
-  .name = "ecgWorkerTask",
-  .stack_size = 128 * 4,
-  .priority = (osPriority_t) osPriorityNormal,
-};
-
 osThreadId_t cliTaskHandle;
 const osThreadAttr_t cliTask_attributes = {
   .name = "cliTask",
@@ -46,31 +42,396 @@ const osThreadAttr_t triggerTask_attributes = {
 };
 
 
+volatile uint32_t g_ecgSampleOverruns = 0;
+bool g_continuousOutput = false;
+
+/**
+ * @brief Sample clock tick, runs in the TIM3 interrupt. The next frame is
+ * computed here so the spacing follows the hardware timer, and its bus writes
+ * are started with DMA; the tick never waits on the bus.
+ */
+static void ecgSampleClockTick(void)
+{
+	uint16_t dacCodes[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+
+	if(!exportEcg(dacCodes))
+	{
+		return;
+	}
+
+	//The previous frame still on the bus means it could not keep up, drop this one
+	if(!VoltageControllerWriteFrameAsync(dacCodes))
+	{
+		g_ecgSampleOverruns++;
+	}
+}
+
+static void ecgStreamStopped(void);
+static bool isI2cBackend(void);
+
+/**
+ * @brief Restarts playback the way it ran before a pause, not while a
+ * calibration run holds the outputs
+ */
+static void resumePlayback(void)
+{
+	if(DacCalibrationIsActive())
+	{
+		return;
+	}
+	if(g_continuousOutput && getEcgChannelCount() <= 1 &&
+			VoltageControllerStartStream(SampleClockGetRate(), exportEcg, ecgStreamStopped))
+	{
+		return;
+	}
+	SampleClockStart();
+}
+
+/**
+ * @brief Wakes basicTask to service the DAC bus, called from the sample
+ * clock and I2C interrupts
+ */
+static void requestDacBusService(void)
+{
+	osThreadFlagsSet(basicTaskHandle, BASIC_TASK_FLAG_DAC_BUS);
+}
+
+/**
+ * @brief Probes a bus the sample clock tick found busy, and recovers it once
+ * the error path flagged it. Until then the writes are refused and counted as
+ * overruns, so an unattended run keeps going and reports the gap instead of
+ * hanging on the bus.
+ * @return false if a recovery was tried and failed
+ */
+static bool serviceDacBus(void)
+{
+	if(!isI2cBackend())
+	{
+		return true;
+	}
+	if(!I2cBusRecoveryPending() && !I2cBusIsStuck())
+	{
+		return true;
+	}
+
+	SampleClockStop();
+	bool recovered = VoltageControllerRecoverBus();
+	resumePlayback();
+	return recovered;
+}
+
 void basicTask(void *argument)
 {
     uint32_t lastWakeTime = osKernelGetTickCount();
 
+    //Started from a task so the first tick lands after the scheduler is up
+    I2cBusSetServiceRequest(requestDacBusService);
+    SampleClockInit(ecgSampleClockTick);
+    SampleClockStart();
+
     for (;;)
     {
-        HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13);
-        osDelayUntil(lastWakeTime + BASIC_TASK_TIME_PERIOD_MS);
-        lastWakeTime += BASIC_TASK_TIME_PERIOD_MS;
+        if(osKernelGetTickCount() - lastWakeTime >= BASIC_TASK_TIME_PERIOD_MS)
+        {
+            HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13);
+            lastWakeTime += BASIC_TASK_TIME_PERIOD_MS;
+        }
+        bool busHealthy = serviceDacBus();
+
+        //The bus error path wakes the task early, a bus that failed to recover is retried next period
+        uint32_t elapsed = osKernelGetTickCount() - lastWakeTime;
+        if(elapsed >= BASIC_TASK_TIME_PERIOD_MS)
+        {
+            continue;
+        }
+        if(busHealthy)
+        {
+            osThreadFlagsWait(BASIC_TASK_FLAG_DAC_BUS, osFlagsWaitAny, BASIC_TASK_TIME_PERIOD_MS - elapsed);
+        }
+        else
+        {
+            osDelay(BASIC_TASK_TIME_PERIOD_MS - elapsed);
+        }
     }
 }
 
+uint32_t OsAppGetSampleOverrunCount(void)
+{
+	return g_ecgSampleOverruns;
+}
 
-void ecgWorkerTask(void *argument)
+/**
+ * @brief True when the output goes through the MCP4725s on I2C1
+ */
+static bool isI2cBackend(void)
 {
+	voltageBackendCapabilities_t capabilities;
+	VoltageControllerGetCapabilities(&capabilities);
+	return (capabilities.flags & VOLTAGE_BACKEND_FLAG_I2C) != 0;
+}
 
-    uint32_t lastWakeTime = osKernelGetTickCount();
-    for (;;)
-    {
+/**
+ * @brief Switches the DAC bus speed with the sample clock paused, so no frame
+ * is started while the I2C peripheral is reprogrammed. Refused during
+ * continuous output, whose open transaction owns the bus; it paces itself
+ * off the bus clock, so end it first with SetContinuous 0.
+ */
+bool OsAppSetDacBusSpeed(uint32_t clockSpeed)
+{
+	if(!isI2cBackend() || VoltageControllerIsStreaming())
+	{
+		return false;
+	}
 
-        exportEcg();
+	SampleClockStop();
+	bool result = VoltageControllerSetBusSpeed(clockSpeed);
+	resumePlayback();
+	return result;
+}
 
-        osDelayUntil(lastWakeTime + GENERATE_ECG_TASK_TIME_PERIOD_MS);
-        lastWakeTime += GENERATE_ECG_TASK_TIME_PERIOD_MS;
-    }
+/**
+ * @brief Measures the achievable frame rate at every bus speed, then restores
+ * the speed in use. Playback pauses for the duration of the test; refused
+ * during continuous output and calibration.
+ */
+bool OsAppRunDacSelfTest(voltageControllerRateTest_t results[DAC_SELF_TEST_SPEED_COUNT])
+{
+	static const uint32_t speeds[DAC_SELF_TEST_SPEED_COUNT] = {
+			VOLTAGE_CONTROLLER_BUS_SPEED_STANDARD,
+			VOLTAGE_CONTROLLER_BUS_SPEED_FAST
+	};
+	uint32_t activeSpeed = VoltageControllerGetBusSpeed();
+
+	if(!isI2cBackend() || VoltageControllerIsStreaming() || DacCalibrationIsActive())
+	{
+		return false;
+	}
+
+	SampleClockStop();
+	for(int i = 0; i < DAC_SELF_TEST_SPEED_COUNT; i++)
+	{
+		results[i] = (voltageControllerRateTest_t){.clockSpeed = speeds[i]};
+		if(VoltageControllerSetBusSpeed(speeds[i]))
+		{
+			VoltageControllerMeasureUpdateRate(DAC_SELF_TEST_WINDOW_MS, &results[i]);
+		}
+	}
+	VoltageControllerSetBusSpeed(activeSpeed);
+	resumePlayback();
+	return true;
+}
+
+/**
+ * @brief A bus error ended continuous output, fall back to the sample clock.
+ * Runs in the I2C interrupt, so the stream itself is restarted by the bus
+ * recovery in the basic task.
+ */
+static void ecgStreamStopped(void)
+{
+	if(!DacCalibrationIsActive())
+	{
+		SampleClockStart();
+	}
+}
+
+/**
+ * @brief Retunes playback; continuous output is restarted at the new rate
+ * since the bus clock paces it. Frame by frame, a rate above what the
+ * backend writes at its bus speed is refused rather than dropping frames.
+ */
+bool OsAppSetSampleRate(uint32_t rateHz)
+{
+	voltageBackendCapabilities_t capabilities;
+	VoltageControllerGetCapabilities(&capabilities);
+
+	if(!VoltageControllerIsStreaming() && capabilities.maxRateHz != 0 && rateHz > capabilities.maxRateHz)
+	{
+		return false;
+	}
+	if(!SampleClockSetRate(rateHz))
+	{
+		return false;
+	}
+	if(VoltageControllerIsStreaming())
+	{
+		VoltageControllerStopStream();
+		if(!VoltageControllerStartStream(SampleClockGetRate(), exportEcg, ecgStreamStopped))
+		{
+			resumePlayback();
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Switches between sample clock paced frames and continuous output,
+ * where lead 0 streams in one open transaction paced by the bus clock. A
+ * single transaction reaches one DAC, so it needs a one-lead waveform.
+ * Refused during calibration, which holds the outputs.
+ */
+bool OsAppSetContinuousOutput(bool enable)
+{
+	if(DacCalibrationIsActive())
+	{
+		return false;
+	}
+
+	g_continuousOutput = enable;
+	if(enable == VoltageControllerIsStreaming())
+	{
+		return true;
+	}
+
+	if(!enable)
+	{
+		VoltageControllerStopStream();
+		resumePlayback();
+		return true;
+	}
+
+	if(getEcgChannelCount() > 1)
+	{
+		g_continuousOutput = false;
+		return false;
+	}
+
+	SampleClockStop();
+	if(!VoltageControllerStartStream(SampleClockGetRate(), exportEcg, ecgStreamStopped))
+	{
+		g_continuousOutput = false;
+		resumePlayback();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Moves playback to another output backend, continuous output ends.
+ * Refused during calibration, which needs the DACs.
+ */
+bool OsAppSetOutputBackend(voltageBackendType_t backend)
+{
+	bool result;
+
+	if(DacCalibrationIsActive())
+	{
+		return false;
+	}
+
+	VoltageControllerStopStream();
+	g_continuousOutput = false;
+	SampleClockStop();
+	result = VoltageControllerInit(backend);
+	resumePlayback();
+	return result;
+}
+
+/**
+ * @brief Renders frameCount frames as fast as possible straight into the
+ * output backend and times them. With the capture backend this measures the
+ * generator alone, with no DAC attached. Playback pauses meanwhile and the
+ * waveform advances by frameCount frames. Refused during continuous output
+ * and calibration.
+ */
+bool OsAppRunPlaybackBenchmark(uint32_t frameCount, playbackBenchmark_t* result)
+{
+	uint16_t block[PLAYBACK_BENCHMARK_BLOCK_FRAMES * VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+	uint32_t written = 0;
+
+	if(frameCount == 0 || frameCount > PLAYBACK_BENCHMARK_MAX_FRAMES || VoltageControllerIsStreaming() ||
+			DacCalibrationIsActive())
+	{
+		return false;
+	}
+
+	SampleClockStop();
+	VoltageControllerFlush();
+
+	uint32_t start = DWT->CYCCNT;
+	while(written < frameCount)
+	{
+		uint32_t count = frameCount - written;
+		if(count > PLAYBACK_BENCHMARK_BLOCK_FRAMES)
+		{
+			count = PLAYBACK_BENCHMARK_BLOCK_FRAMES;
+		}
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			uint16_t* frame = &block[i * VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+			if(!exportEcg(frame))
+			{
+				for(int channel = 0; channel < VOLTAGE_CONTROLLER_CHANNEL_COUNT; channel++)
+				{
+					frame[channel] = DAC_MID_CODE;
+				}
+			}
+		}
+		uint32_t blockWritten = VoltageControllerWriteBlock(block, count);
+		written += blockWritten;
+		if(blockWritten < count)
+		{
+			break;
+		}
+	}
+	VoltageControllerFlush();
+	uint32_t cycles = DWT->CYCCNT - start;
+
+	resumePlayback();
+
+	result->frames = written;
+	result->cyclesPerFrame = written ? cycles / written : 0;
+	result->framesPerSecond = cycles ? (uint32_t)(((uint64_t)written * SystemCoreClock) / cycles) : 0;
+	return written == frameCount;
+}
+
+/**
+ * @brief Starts a DAC calibration run. Playback stops and the outputs hold
+ * the points driven with OsAppDriveCalibrationPoint until the run ends.
+ */
+bool OsAppStartDacCalibration(void)
+{
+	if(!isI2cBackend() || DacCalibrationIsActive())
+	{
+		return false;
+	}
+
+	VoltageControllerStopStream();
+	SampleClockStop();
+	return DacCalibrationBegin();
+}
+
+/**
+ * @brief Puts the raw knot code on one channel for measurement, the other
+ * channels sit at mid scale
+ */
+bool OsAppDriveCalibrationPoint(uint8_t channel, uint8_t knot)
+{
+	uint16_t frame[VOLTAGE_CONTROLLER_CHANNEL_COUNT];
+
+	if(!DacCalibrationIsActive() || channel >= VOLTAGE_CONTROLLER_CHANNEL_COUNT || knot >= DAC_CALIBRATION_KNOT_COUNT)
+	{
+		return false;
+	}
+
+	for(int i = 0; i < VOLTAGE_CONTROLLER_CHANNEL_COUNT; i++)
+	{
+		frame[i] = DAC_MID_CODE;
+	}
+	frame[channel] = DacCalibrationGetKnotCode(knot);
+	return VoltageControllerWriteBlock(frame, 1) == 1;
+}
+
+/**
+ * @brief Ends the calibration run, stores it with save, and resumes playback
+ */
+bool OsAppEndDacCalibration(bool save)
+{
+	bool result = DacCalibrationEnd(save);
+
+	resumePlayback();
+	return result;
 }
 
 void cliTask(void *argument)
@@ -93,23 +454,22 @@ void OsAppCreateTasks(void)
 	basicTaskHandle = osThreadNew(basicTask, NULL, &basicTask_attributes);
 	cliTaskHandle = osThreadNew(cliTask, NULL, &cliTask_attributes);
 	triggerTaskHandle = osThreadNew(triggerTask, NULL, &triggerTask_attributes);
-	ecgWorkerTaskHandle = osThreadNew(ecgWorkerTask, NULL, &ecgWorkerTask_attributes);
 
 	configASSERT(basicTaskHandle != NULL);
 	configASSERT(cliTaskHandle != NULL);
 	configASSERT(triggerTaskHandle != NULL);
-	configASSERT(ecgWorkerTaskHandle != NULL);
 }
 
 void OsAppLowerLayerInit(void)
 {
 	UART_Init(DEBUG_UART);
 	UART_Init(TRIGGER_UART);
-	VoltageControllerInit();
+	DacCalibrationInit();
+	VoltageControllerInit(VOLTAGE_CONTROLLER_DEFAULT_BACKEND);
 }
 
 void OsAppUpperLayerInit(void)
 {
 	triggerDetectApplicationInit();
-//	ecgGeneratorAppInit();
+	ecgGeneratorAppInit();
 }
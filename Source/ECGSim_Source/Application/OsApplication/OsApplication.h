@@ -12,12 +12,33 @@
 #include "cmsis_os2.h"
 #include "main.h"
 #include "task.h"
+#include "VoltageController.h"
 
 #define BASIC_TASK_TIME_PERIOD_MS				1000
-#define GENERATE_ECG_TASK_TIME_PERIOD_MS		1
+#define BASIC_TASK_FLAG_DAC_BUS					0x01	//the bus error path wants a probe or a recovery
+#define DAC_SELF_TEST_WINDOW_MS					100
+#define DAC_SELF_TEST_SPEED_COUNT				2
+#define PLAYBACK_BENCHMARK_BLOCK_FRAMES			16
+#define PLAYBACK_BENCHMARK_MAX_FRAMES			100000UL	//the cycle counter wraps after 119 s at 36 MHz
+
+typedef struct{
+	uint32_t frames;
+	uint32_t framesPerSecond;
+	uint32_t cyclesPerFrame;	//generator plus backend write
+}playbackBenchmark_t;
 
 void OsAppCreateTasks(void);
 void OsAppLowerLayerInit(void);
 void OsAppUpperLayerInit(void);
+uint32_t OsAppGetSampleOverrunCount(void);
+bool OsAppSetDacBusSpeed(uint32_t clockSpeed);
+bool OsAppRunDacSelfTest(voltageControllerRateTest_t results[DAC_SELF_TEST_SPEED_COUNT]);
+bool OsAppSetSampleRate(uint32_t rateHz);
+bool OsAppSetContinuousOutput(bool enable);
+bool OsAppSetOutputBackend(voltageBackendType_t backend);
+bool OsAppRunPlaybackBenchmark(uint32_t frameCount, playbackBenchmark_t* result);
+bool OsAppStartDacCalibration(void);
+bool OsAppDriveCalibrationPoint(uint8_t channel, uint8_t knot);
+bool OsAppEndDacCalibration(bool save);
 
 #endif /* OSAPPLICATION_OSAPPLICATION_H_ */
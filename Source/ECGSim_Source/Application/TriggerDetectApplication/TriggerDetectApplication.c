@@ -43,12 +43,6 @@ bool triggerDetectApplicationInit()
 
 	return false;
 }
-bool getCharacter(char *receivedCharacter)
-{
-	return UART_ReadByteNonBlocking(TRIGGER_UART, (uint8_t *)receivedCharacter);
-}
-
-
 void resetTriggerBuffer()
 {
 	memset(g_triggerBuffer.buffer, 0, TRIGGER_BUFFER_SIZE);
@@ -56,28 +50,32 @@ void resetTriggerBuffer()
 }
 
 
-void addToCommandBuffer(char a_data)
+/**
+ * @brief Collects the received bytes of a trigger frame up to its end value
+ * @return true once the frame is complete
+ */
+bool constructTriggerPayload()
 {
-	if(g_triggerBuffer.triggerIndex >= TRIGGER_BUFFER_SIZE)
+	uint32_t space = TRIGGER_BUFFER_SIZE - g_triggerBuffer.triggerIndex;
+
+	if(space == 0)
 	{
 		CLI_PrintLine("TOO MANY BYTES");
 		resetTriggerBuffer();
-		return ;
+		return false;
 	}
-	g_triggerBuffer.buffer[g_triggerBuffer.triggerIndex++] = a_data;
-}
 
-bool constructTriggerPayload()
-{
-	char receivedCharacter;
-	if(getCharacter(&receivedCharacter))
+	uint32_t count = UART_ReadUntil(TRIGGER_UART, &g_triggerBuffer.buffer[g_triggerBuffer.triggerIndex], space, TRIGGER_END_VALUE);
+	if(count == 0)
 	{
-		addToCommandBuffer(receivedCharacter);
-		if(receivedCharacter == TRIGGER_END_VALUE)
-		{
-			g_triggerReceived = true;
-			return true;
-		}
+		return false;
+	}
+
+	g_triggerBuffer.triggerIndex += count;
+	if(g_triggerBuffer.buffer[g_triggerBuffer.triggerIndex - 1] == TRIGGER_END_VALUE)
+	{
+		g_triggerReceived = true;
+		return true;
 	}
 
 	return false;
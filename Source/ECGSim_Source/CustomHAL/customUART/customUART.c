@@ -7,23 +7,76 @@
 #include "customUART.h"
 #include "CircularQueue/CircularQueue.h"
 #include "FreeRTOS.h"
-#include "queue.h"
+#include "task.h"
 #include "usart.h"
 #include "pinConfig.h"
 #include "CommonConfigurations.h"
-#define UART_IT_WRITE_CHUNK_SIZE 251
-
-QueueHandle_t g_DebugUARTTxQueue;
-QueueHandle_t g_DebugUARTRxQueue;
-QueueHandle_t g_TriggerUARTTxQueue;
-QueueHandle_t g_TriggerUARTRxQueue;
+#include <string.h>
+#define UART_TX_DRAIN_TIMEOUT_MS 200
 
 UART_HandleTypeDef* g_uartHandler[UART_COUNT];
 
-uint8_t g_TxByte[UART_COUNT][UART_IT_WRITE_CHUNK_SIZE];
-uint8_t g_RxByte[UART_COUNT];
+/*
+ * Transmit: tasks copy into a byte queue and DMA sends its largest contiguous
+ * span in place, the transfer complete interrupt releases it and starts the
+ * next one.
+ */
+typedef struct{
+	CircularQueue_t queue;		//tasks produce, the transfer complete interrupt consumes
+	volatile uint32_t inFlight;	//bytes of the running transfer, 0 when idle
+}uartTxRing_t;
 
+uint8_t g_DebugUARTTxBuffer[DEBUG_UART_TX_RING_SIZE];
+uint8_t g_TriggerUARTTxBuffer[TRIGGER_UART_TX_RING_SIZE];
 
+uartTxRing_t g_txRing[UART_COUNT] = {
+		[DEBUG_UART] = {.queue = {.data = g_DebugUARTTxBuffer, .maxSize = DEBUG_UART_TX_RING_SIZE}},
+		[TRIGGER_UART] = {.queue = {.data = g_TriggerUARTTxBuffer, .maxSize = TRIGGER_UART_TX_RING_SIZE}},
+};
+
+/*
+ * Receive: a UART with a receive DMA channel runs it circular over its queue
+ * buffer and the idle line, half and full transfer events commit what it
+ * wrote. USART2_RX shares DMA1_Channel6 with the DAC bus, so TRIGGER_UART
+ * moves each byte into its queue from the receive interrupt instead.
+ */
+typedef struct{
+	CircularQueue_t queue;		//the receive interrupt produces, the reading task consumes
+	uint32_t dmaPosition;		//buffer index the DMA had reached at the last event
+	volatile bool restartPending;	//reception stopped on an error, the reader restarts it
+}uartRxRing_t;
+
+uint8_t g_DebugUARTRxBuffer[DEBUG_UART_RX_RING_SIZE];
+uint8_t g_TriggerUARTRxBuffer[TRIGGER_UART_RX_RING_SIZE];
+
+uartRxRing_t g_rxRing[UART_COUNT] = {
+		[DEBUG_UART] = {.queue = {.data = g_DebugUARTRxBuffer, .maxSize = DEBUG_UART_RX_RING_SIZE}},
+		[TRIGGER_UART] = {.queue = {.data = g_TriggerUARTRxBuffer, .maxSize = TRIGGER_UART_RX_RING_SIZE}},
+};
+
+
+/**
+ * @brief (Re)starts reception. DMA reception starts over at the ring start
+ * and drops the bytes not read yet.
+ * @note Reader context with reception stopped, the reset also moves the
+ * reader's tail
+ */
+static bool startReception(UARTType_t uartType)
+{
+	UART_HandleTypeDef* huart = g_uartHandler[uartType];
+	uartRxRing_t* ring = &g_rxRing[uartType];
+
+	if(huart->hdmarx == NULL)
+	{
+		__HAL_UART_ENABLE_IT(huart, UART_IT_RXNE);
+		return true;
+	}
+
+	//Keep the indices in step with the DMA write position
+	CircularQueueReset(&ring->queue);
+	ring->dmaPosition = 0;
+	return HAL_UARTEx_ReceiveToIdle_DMA(huart, ring->queue.data, (uint16_t)ring->queue.maxSize) == HAL_OK;
+}
 
 bool initDebugUart()
 {
@@ -31,20 +84,8 @@ bool initDebugUart()
 
 		MX_USART1_UART_Init();
 		g_uartHandler[DEBUG_UART] = &huart1;
-		g_DebugUARTTxQueue = xQueueCreate(DEBUG_UART_TX_QUEUE_SIZE,1);
-		g_DebugUARTRxQueue = xQueueCreate(DEBUG_UART_RX_QUEUE_SIZE,1);
 
-		if( NULL == g_DebugUARTTxQueue || NULL == g_DebugUARTRxQueue)
-		{
-			return false;
-
-		}
-
-		if(HAL_UART_Receive_IT(g_uartHandler[DEBUG_UART], &g_RxByte[DEBUG_UART], 1) != HAL_OK)
-		{
-			return false;
-		}
-		return true;
+		return startReception(DEBUG_UART);
 }
 
 bool initTriggerUart()
@@ -53,20 +94,8 @@ bool initTriggerUart()
 
 		MX_USART2_UART_Init();
 		g_uartHandler[TRIGGER_UART] = &huart2;
-		g_TriggerUARTTxQueue = xQueueCreate(TRIGGER_UART_TX_QUEUE_SIZE,1);
-		g_TriggerUARTRxQueue = xQueueCreate(TRIGGER_UART_RX_QUEUE_SIZE,1);
 
-		if( NULL == g_TriggerUARTTxQueue || NULL == g_TriggerUARTRxQueue)
-		{
-			return false;
-
-		}
-
-		if(HAL_UART_Receive_IT(g_uartHandler[TRIGGER_UART], &g_RxByte[TRIGGER_UART], 1) != HAL_OK)
-		{
-			return false;
-		}
-		return true;
+		return startReception(TRIGGER_UART);
 }
 
 bool UART_Init(UARTType_t uartType)
@@ -90,161 +119,335 @@ bool UART_Init(UARTType_t uartType)
 }
 
 
-bool UART_Write(UARTType_t uartType, uint8_t *pdata, uint32_t size)
+/**
+ * @brief Starts a DMA transfer of the pending bytes up to the end of the
+ * ring, unless one is running
+ * @note Call with the UART interrupts masked
+ */
+static void startTxTransfer(UARTType_t uartType)
 {
-	bool status = true;
-	if( IS_VALID_PNTR(pdata) && 0 < size)
+	uartTxRing_t* ring = &g_txRing[uartType];
+	uint8_t* span;
+
+	if(ring->inFlight != 0)
 	{
+		return;
+	}
 
-		if(uartType == DEBUG_UART)
-		{
-			while(size --)
-			{
-				xQueueSendToBack(g_DebugUARTTxQueue, pdata,(TickType_t) 0);
-				pdata++;
-			}
-		}
-		else if (uartType == TRIGGER_UART)
-		{
-			while(size --)
-			{
-				xQueueSendToBack(g_TriggerUARTTxQueue, pdata,(TickType_t) 0);
-				pdata++;
-			}
+	uint32_t length = CircularQueuePeekContiguous(&ring->queue, &span);
+	if(length != 0 && HAL_UART_Transmit_DMA(g_uartHandler[uartType], span, (uint16_t)length) == HAL_OK)
+	{
+		ring->inFlight = length;
+	}
+}
 
-		}
+/**
+ * @brief Copies the bytes into the transmit queue and starts a transfer if
+ * the line is idle. Never waits, bytes that do not fit are left out.
+ * @return bytes queued
+ */
+uint32_t UART_Write(UARTType_t uartType, const uint8_t *pdata, uint32_t size)
+{
+	if(!IS_VALID_PNTR(pdata) || size == 0 || uartType >= UART_COUNT)
+	{
+		return 0;
+	}
 
+	uartTxRing_t* ring = &g_txRing[uartType];
 
-		if(g_uartHandler[uartType]->gState != HAL_UART_STATE_BUSY_TX)
-		{
-			__HAL_UART_ENABLE_IT(g_uartHandler[uartType], UART_IT_TC);
-		}
-	}
-	else status = false;
+	//Writing tasks take turns so the queue keeps a single producer
+	vTaskSuspendAll();
 
-	return status;
+	uint32_t written = CircularQueueWriteBytes(&ring->queue, pdata, size);
 
+	taskENTER_CRITICAL();
+	startTxTransfer(uartType);
+	taskEXIT_CRITICAL();
 
+	xTaskResumeAll();
+	return written;
 }
 
-
-bool UART_ReadByteNonBlocking(UARTType_t uartType, uint8_t *pdata)
+/**
+ * @brief Queues all the bytes, waiting for the running transfers to free
+ * space when the queue is full
+ * @note Task context, gives up after UART_TX_DRAIN_TIMEOUT_MS without any
+ * progress. Before the scheduler runs it does not wait.
+ * @return bytes queued
+ */
+uint32_t UART_WriteBlocking(UARTType_t uartType, const uint8_t *pdata, uint32_t size)
 {
-	bool status = false;
-	if(IS_VALID_PNTR(pdata))
-	{
+	uint32_t written = UART_Write(uartType, pdata, size);
+	TickType_t start = xTaskGetTickCount();
 
-		if(uartType == DEBUG_UART)
+	while(written < size && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(UART_TX_DRAIN_TIMEOUT_MS))
 		{
-			if(xQueueReceive(g_DebugUARTRxQueue, pdata, 0) == pdTRUE)
-			{
-				status = true;
-			}
+			break;
 		}
-		else if(uartType == TRIGGER_UART)
+		vTaskDelay(1);
+
+		uint32_t queued = UART_Write(uartType, &pdata[written], size - written);
+		if(queued != 0)
 		{
-			if(xQueueReceive(g_TriggerUARTRxQueue, pdata, 0) == pdTRUE)
-			{
-				status = true;
-			}
+			written += queued;
+			start = xTaskGetTickCount();
 		}
-
-
 	}
-	return status;
+
+	return written;
 }
 
 
-bool UART_ClearRxBuffer(UARTType_t uartType)
+/**
+ * @brief Takes received bytes out of the queue, stopping after the first
+ * delimiter when one is given
+ * @param delimiter byte value, or -1 for none
+ * @return bytes read
+ */
+static uint32_t readRing(UARTType_t uartType, uint8_t *pdata, uint32_t size, int delimiter)
 {
-	bool status = false;
+	if(!IS_VALID_PNTR(pdata) || uartType >= UART_COUNT)
+	{
+		return 0;
+	}
 
+	uartRxRing_t* ring = &g_rxRing[uartType];
+	CircularQueue_t* queue = &ring->queue;
+	uint32_t count = 0;
+	uint8_t* span;
+	uint32_t length;
 
-		if(uartType == DEBUG_UART)
-		{
-			xQueueReset(g_DebugUARTRxQueue);
+	//Bytes received before the error are taken first
+	if(ring->restartPending && CircularQueueGetRemainingData(queue) == 0)
+	{
+		ring->restartPending = false;
+		startReception(uartType);
+	}
 
-		}
-		else if(uartType == TRIGGER_UART)
+	if(delimiter < 0)
+	{
+		return CircularQueueReadBytes(queue, pdata, size);
+	}
+
+	//At most two spans, the second one after the buffer wraps
+	while(count < size && (length = CircularQueuePeekContiguous(queue, &span)) != 0)
+	{
+		if(length > size - count)
 		{
-			xQueueReset(g_TriggerUARTRxQueue);
+			length = size - count;
+		}
 
+		uint8_t* end = memchr(span, delimiter, length);
+		if(end != NULL)
+		{
+			length = end - span + 1;
 		}
 
-		status = true;
+		memcpy(&pdata[count], span, length);
+		CircularQueueCommitRead(queue, length);
+		count += length;
+
+		if(end != NULL)
+		{
+			break;
+		}
+	}
 
+	return count;
+}
 
+bool UART_ReadByteNonBlocking(UARTType_t uartType, uint8_t *pdata)
+{
+	return readRing(uartType, pdata, 1, -1) == 1;
+}
 
-	return status;
+/**
+ * @brief Reads whatever has arrived, up to size bytes
+ * @return bytes read
+ */
+uint32_t UART_Read(UARTType_t uartType, uint8_t *pdata, uint32_t size)
+{
+	return readRing(uartType, pdata, size, -1);
+}
 
+/**
+ * @brief Reads up to and including the next delimiter, or what has arrived
+ * of it so far, up to size bytes
+ * @return bytes read, the last one is the delimiter when the span is complete
+ */
+uint32_t UART_ReadUntil(UARTType_t uartType, uint8_t *pdata, uint32_t size, uint8_t delimiter)
+{
+	return readRing(uartType, pdata, size, delimiter);
 }
 
-bool UART_ClearTxBuffer(UARTType_t uartType)
+
+/**
+ * @brief Lets the queued bytes go out at the old rate, then reprograms the
+ * baud rate and restarts reception
+ * @note Task context, waits up to UART_TX_DRAIN_TIMEOUT_MS for the drain
+ */
+bool UART_SetBaudRate(UARTType_t uartType, uint32_t baudRate)
 {
-	bool status = false;
+	if(uartType >= UART_COUNT || baudRate == 0)
+	{
+		return false;
+	}
 
+	UART_HandleTypeDef* huart = g_uartHandler[uartType];
+	uartTxRing_t* ring = &g_txRing[uartType];
+	TickType_t start = xTaskGetTickCount();
 
-		if(uartType == DEBUG_UART)
-		{
-			xQueueReset(g_DebugUARTTxQueue);
-		}
-		else if(uartType == TRIGGER_UART)
+	while(CircularQueueGetRemainingData(&ring->queue) != 0 || huart->gState == HAL_UART_STATE_BUSY_TX ||
+			__HAL_UART_GET_FLAG(huart, UART_FLAG_TC) == RESET)
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(UART_TX_DRAIN_TIMEOUT_MS))
 		{
-			xQueueReset(g_TriggerUARTTxQueue);
+			break;
 		}
+		vTaskDelay(1);
+	}
 
-		status = true;
-
+	HAL_UART_AbortReceive(huart);
+	huart->Init.BaudRate = baudRate;
+	if(HAL_UART_Init(huart) != HAL_OK)
+	{
+		return false;
+	}
+	g_rxRing[uartType].restartPending = false;
+	return startReception(uartType);
+}
 
+uint32_t UART_GetBaudRate(UARTType_t uartType)
+{
+	return (uartType < UART_COUNT) ? g_uartHandler[uartType]->Init.BaudRate : 0;
+}
 
-	return status;
+bool UART_ClearRxBuffer(UARTType_t uartType)
+{
+	if(uartType >= UART_COUNT)
+	{
+		return false;
+	}
 
+	return CircularQueueFlush(&g_rxRing[uartType].queue);
 }
 
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+/**
+ * @brief Drops the bytes still waiting, the transfer running finishes
+ */
+bool UART_ClearTxBuffer(UARTType_t uartType)
 {
-	if(huart->Instance == g_uartHandler[DEBUG_UART]->Instance)
+	if(uartType >= UART_COUNT)
 	{
-		if(xQueueReceiveFromISR(g_DebugUARTTxQueue, &g_TxByte[DEBUG_UART], 0) == pdTRUE)
-		{
-			HAL_UART_Transmit_IT(g_uartHandler[DEBUG_UART], g_TxByte[DEBUG_UART], 1);
-		}
+		return false;
 	}
-	else if(huart->Instance == g_uartHandler[TRIGGER_UART]->Instance)
+
+	uartTxRing_t* ring = &g_txRing[uartType];
+
+	//The producer takes back its unsent bytes, a writer never gives up the
+	//CPU halfway through its copy
+	taskENTER_CRITICAL();
+	ring->queue.headIndex = ring->queue.tailIndex + ring->inFlight;
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+static bool getUartType(UART_HandleTypeDef *huart, UARTType_t* uartType)
+{
+	for(int i = 0; i < UART_COUNT; i++)
 	{
-		if(xQueueReceiveFromISR(g_TriggerUARTTxQueue, &g_TxByte[TRIGGER_UART], 0) == pdTRUE)
+		if(g_uartHandler[i] != NULL && huart->Instance == g_uartHandler[i]->Instance)
 		{
-			HAL_UART_Transmit_IT(g_uartHandler[TRIGGER_UART], g_TxByte[TRIGGER_UART], 1);
+			*uartType = (UARTType_t)i;
+			return true;
 		}
 	}
-
+	return false;
 }
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+/**
+ * @brief The last byte of a transfer left the shift register, release its
+ * span and send the next one
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	UARTType_t uartType;
+
+	if(getUartType(huart, &uartType))
+	{
+		uartTxRing_t* ring = &g_txRing[uartType];
+
+		CircularQueueCommitRead(&ring->queue, ring->inFlight);
+		ring->inFlight = 0;
+		startTxTransfer(uartType);
+	}
+}
 
+/**
+ * @brief A DMA error ends a transfer early, its span is given up so the
+ * rest of the ring still goes out. Overrun, noise and framing errors stop
+ * reception, the reader restarts it once it has drained the queue, the
+ * interrupt never moves the reader's tail.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
 {
-	if(huart->Instance == g_uartHandler[DEBUG_UART]->Instance)
+	UARTType_t uartType;
+
+	if(!getUartType(huart, &uartType))
 	{
-		BaseType_t pxHigherPriorityTaskWoken;
-		xQueueSendToBackFromISR(g_DebugUARTRxQueue, &g_RxByte[DEBUG_UART], &pxHigherPriorityTaskWoken);
-		if(pxHigherPriorityTaskWoken)
-		{
-			taskYIELD();
-		}
+		return;
+	}
 
-		HAL_UART_Receive_IT(g_uartHandler[DEBUG_UART], &g_RxByte[DEBUG_UART], 1);
+	uartTxRing_t* ring = &g_txRing[uartType];
+	if(huart->gState == HAL_UART_STATE_READY && ring->inFlight != 0)
+	{
+		CircularQueueCommitRead(&ring->queue, ring->inFlight);
+		ring->inFlight = 0;
+		startTxTransfer(uartType);
 	}
 
-	else if(huart->Instance == g_uartHandler[TRIGGER_UART]->Instance)
+	if(huart->RxState == HAL_UART_STATE_READY)
 	{
-		BaseType_t pxHigherPriorityTaskWoken;
-		xQueueSendToBackFromISR(g_TriggerUARTRxQueue, &g_RxByte[TRIGGER_UART], &pxHigherPriorityTaskWoken);
-		if(pxHigherPriorityTaskWoken)
-		{
-			taskYIELD();
-		}
+		g_rxRing[uartType].restartPending = true;
+	}
+}
+
+/**
+ * @brief Circular DMA reception event, publishes the bytes written since
+ * the last one
+ * @param Size ring index the DMA has reached, the ring size on a wrap
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	UARTType_t uartType;
 
-		HAL_UART_Receive_IT(g_uartHandler[TRIGGER_UART], &g_RxByte[TRIGGER_UART], 1);
+	if(getUartType(huart, &uartType))
+	{
+		uartRxRing_t* ring = &g_rxRing[uartType];
+		uint32_t mask = ring->queue.maxSize - 1;
+		uint32_t position = Size & mask;
+
+		//The DMA cannot wait, a lapped reader skips to the newest bytes
+		CircularQueueCommitWrite(&ring->queue, (position - ring->dmaPosition) & mask);
+		ring->dmaPosition = position;
 	}
 }
 
+/**
+ * @brief Receive interrupt of a UART without a receive DMA channel, called
+ * ahead of HAL_UART_IRQHandler. Reading SR then DR also clears overrun,
+ * noise and framing errors. A byte that finds the queue full is dropped.
+ */
+void UART_ReceiveIRQHandler(UARTType_t uartType)
+{
+	UART_HandleTypeDef* huart = g_uartHandler[uartType];
+
+	if(huart == NULL || (huart->Instance->SR & USART_SR_RXNE) == 0)
+	{
+		return;
+	}
+
+	CircularQueueWriteByte(&g_rxRing[uartType].queue, (uint8_t)huart->Instance->DR);
+}
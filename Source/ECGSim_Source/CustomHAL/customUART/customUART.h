@@ -18,21 +18,36 @@ typedef enum{
 	UART_COUNT
 }UARTType_t;
 
-#define DEBUG_UART_TX_QUEUE_SIZE 1024
-#define DEBUG_UART_RX_QUEUE_SIZE 1024
+//Queues must be a power of two. Bulk CLI replies wait for room, the debug
+//receive queue holds a binary upload window, the trigger link only receives
+//frames of up to 100 bytes.
+#define DEBUG_UART_TX_RING_SIZE 512
+#define DEBUG_UART_RX_RING_SIZE 1024
 
-#define TRIGGER_UART_TX_QUEUE_SIZE 1024
-#define TRIGGER_UART_RX_QUEUE_SIZE 1024
+#define TRIGGER_UART_TX_RING_SIZE 64
+#define TRIGGER_UART_RX_RING_SIZE 256
 
 
 bool UART_Init(UARTType_t uartType);
 
 
-bool UART_Write(UARTType_t uartType, uint8_t *pdata, uint32_t size);
+uint32_t UART_Write(UARTType_t uartType, const uint8_t *pdata, uint32_t size);
+
+uint32_t UART_WriteBlocking(UARTType_t uartType, const uint8_t *pdata, uint32_t size);
 
 
 bool UART_ReadByteNonBlocking(UARTType_t uart, uint8_t *pdata);
 
+uint32_t UART_Read(UARTType_t uartType, uint8_t *pdata, uint32_t size);
+
+uint32_t UART_ReadUntil(UARTType_t uartType, uint8_t *pdata, uint32_t size, uint8_t delimiter);
+
+void UART_ReceiveIRQHandler(UARTType_t uartType);
+
+bool UART_SetBaudRate(UARTType_t uartType, uint32_t baudRate);
+
+uint32_t UART_GetBaudRate(UARTType_t uartType);
+
 bool UART_ClearRxBuffer(UARTType_t uartType);
 
 bool UART_ClearTxBuffer(UARTType_t uartType);
@@ -30,6 +30,15 @@
 #include "MCP4725.h"
 #include "i2c.h"
 
+static MCP4725* volatile _MCP4725_inFlight = NULL;                  //device owning the async transfer, one per bus
+
+static MCP4725* volatile _MCP4725_streaming = NULL;                 //device owning the open stream transaction
+static MCP4725_STREAM_CALLBACK _MCP4725_refill = NULL;
+static uint8_t*  _MCP4725_ring = NULL;
+static uint16_t  _MCP4725_ringLength = 0;
+
+#define MCP4725_STREAM_FLAG_TIMEOUT  (SystemCoreClock / 25U / 1000U * 25U) //~25 msec of polling, as the HAL flag waits
+
 /**************************************************************************/
 /*
     MCP4725_init()
@@ -43,6 +52,7 @@ MCP4725 MCP4725_init(I2C_HandleTypeDef* hi2c, MCP4725Ax_ADDRESS addr, float refV
 
 	_MCP4725._i2cAddress = (uint16_t)(addr<<1);
 	_MCP4725.hi2c = hi2c;
+	_MCP4725._callback = NULL;
 
 	MCP4725_setReferenceVoltage(&_MCP4725, refV); //set _refVoltage & _bitsPerVolt variables
 
@@ -120,6 +130,261 @@ uint8_t MCP4725_setValue(MCP4725* _MCP4725, uint16_t value, MCP4725_COMMAND_TYPE
   return MCP4725_writeComand(_MCP4725, value, mode, powerType);
 }
 
+/**************************************************************************/
+/*
+    setValueAsync()
+
+    Start a fast mode write (2-bytes) with DMA & return without waiting
+
+    NOTE:
+    - callback runs from the I2C interrupt once the stop condition is sent,
+      it may start the next async write
+    - only one async transfer can be in flight, returns 0 if the previous
+      one has not completed or the transfer could not be started
+    - call from a single interrupt priority, the busy check is not atomic
+      against a caller that can be preempted by the I2C interrupt
+*/
+/**************************************************************************/ 
+uint8_t MCP4725_setValueAsync(MCP4725* _MCP4725, uint16_t value, MCP4725_POWER_DOWN_TYPE powerType, MCP4725_ASYNC_CALLBACK callback)
+{
+  if (_MCP4725_inFlight != NULL) return 0;
+
+	MCP4725_packFastWrite(_MCP4725->_txBuffer, value, powerType);
+	_MCP4725->_callback = callback;
+
+	_MCP4725_inFlight = _MCP4725;
+	if (HAL_I2C_Master_Transmit_DMA(_MCP4725->hi2c, _MCP4725->_i2cAddress, _MCP4725->_txBuffer, 2) != HAL_OK)
+	{
+		_MCP4725_inFlight = NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+/**************************************************************************/
+/*
+    isBusy()
+
+    Return 1 while an async write is in flight
+*/
+/**************************************************************************/ 
+uint8_t MCP4725_isBusy(void)
+{
+	return _MCP4725_inFlight != NULL;
+}
+
+/**************************************************************************/
+/*
+    packFastWrite()
+
+    Encode one fast mode write (2-bytes) for an async or streamed transfer
+*/
+/**************************************************************************/ 
+void MCP4725_packFastWrite(uint8_t* buffer, uint16_t value, MCP4725_POWER_DOWN_TYPE powerType)
+{
+  #ifndef MCP4725_DISABLE_SANITY_CHECK
+  if (value > MCP4725_MAX_VALUE) value = MCP4725_MAX_VALUE; //make sure value never exceeds threshold
+  #endif
+
+	buffer[0] = MCP4725_FAST_MODE | (powerType << 4) | highByte(value);
+	buffer[1] = lowByte(value);
+}
+
+/**************************************************************************/
+/*
+    waitStreamFlag()
+
+    Poll an SR1 flag during the stream address phase, fails on a NACK
+*/
+/**************************************************************************/ 
+static uint8_t MCP4725_waitStreamFlag(I2C_HandleTypeDef* hi2c, uint32_t flag)
+{
+	uint32_t count = MCP4725_STREAM_FLAG_TIMEOUT;
+
+	while (__HAL_I2C_GET_FLAG(hi2c, flag) == RESET)
+	{
+		if (__HAL_I2C_GET_FLAG(hi2c, I2C_FLAG_AF) == SET || --count == 0)
+		{
+			__HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_AF);
+			SET_BIT(hi2c->Instance->CR1, I2C_CR1_STOP);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**************************************************************************/
+/*
+    restoreStreamDma()
+
+    Put the TX channel back to the normal mode used by async writes
+*/
+/**************************************************************************/ 
+static void MCP4725_restoreStreamDma(I2C_HandleTypeDef* hi2c)
+{
+	hi2c->hdmatx->Init.Mode = DMA_NORMAL;
+	HAL_DMA_Init(hi2c->hdmatx);
+	hi2c->hdmatx->XferHalfCpltCallback = NULL;
+	hi2c->hdmatx->XferCpltCallback = NULL;
+	hi2c->hdmatx->XferErrorCallback = NULL;
+
+	_MCP4725_streaming = NULL;
+}
+
+static void MCP4725_streamHalfCplt(DMA_HandleTypeDef *hdma)
+{
+	MCP4725* device = _MCP4725_streaming;
+	if (device != NULL) _MCP4725_refill(device, _MCP4725_ring, _MCP4725_ringLength / 2);
+}
+
+static void MCP4725_streamCplt(DMA_HandleTypeDef *hdma)
+{
+	MCP4725* device = _MCP4725_streaming;
+	if (device != NULL) _MCP4725_refill(device, _MCP4725_ring + _MCP4725_ringLength / 2, _MCP4725_ringLength / 2);
+}
+
+static void MCP4725_streamDmaError(DMA_HandleTypeDef *hdma)
+{
+	MCP4725* device = _MCP4725_streaming;
+
+	if (device == NULL) return;
+
+	MCP4725_stopStream();
+	if (device->_callback != NULL) device->_callback(device, 0);
+}
+
+/**************************************************************************/
+/*
+    startStream()
+
+    Open one write transaction & keep it open, the ring is sent by circular
+    DMA as back-to-back fast mode writes, so every update costs 18 SCL clocks
+    instead of the 29 of a separate write & the bus clock paces the output
+
+    NOTE:
+    - ring holds "length" bytes of packed fast writes, length a multiple of
+      4 so each half ends on a whole write, prefilled by the caller
+    - refill runs from the DMA interrupt for the half just sent
+    - stopped runs if a bus error ends the stream, after the bus is released
+    - blocks for the start & address phase only
+*/
+/**************************************************************************/ 
+uint8_t MCP4725_startStream(MCP4725* _MCP4725, uint8_t* ring, uint16_t length, MCP4725_STREAM_CALLBACK refill, MCP4725_ASYNC_CALLBACK stopped)
+{
+	I2C_HandleTypeDef* hi2c = _MCP4725->hi2c;
+
+	if (_MCP4725_inFlight != NULL || hi2c->hdmatx == NULL || hi2c->State != HAL_I2C_STATE_READY) return 0;
+	if (length < 4 || (length % 4) != 0 || refill == NULL) return 0;
+	if (__HAL_I2C_GET_FLAG(hi2c, I2C_FLAG_BUSY) == SET) return 0;
+
+	hi2c->State = HAL_I2C_STATE_BUSY_TX;
+	hi2c->Mode = HAL_I2C_MODE_MASTER;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	_MCP4725->_callback = stopped;
+	_MCP4725_refill = refill;
+	_MCP4725_ring = ring;
+	_MCP4725_ringLength = length;
+
+	/* start & address phase */
+	if ((hi2c->Instance->CR1 & I2C_CR1_PE) != I2C_CR1_PE) __HAL_I2C_ENABLE(hi2c);
+	CLEAR_BIT(hi2c->Instance->CR1, I2C_CR1_POS);
+	SET_BIT(hi2c->Instance->CR1, I2C_CR1_START);
+	if (!MCP4725_waitStreamFlag(hi2c, I2C_FLAG_SB)) goto failed;
+	hi2c->Instance->DR = I2C_7BIT_ADD_WRITE(_MCP4725->_i2cAddress);
+	if (!MCP4725_waitStreamFlag(hi2c, I2C_FLAG_ADDR)) goto failed;
+
+	/* data phase, the first request comes once ADDR is cleared */
+	hi2c->hdmatx->Init.Mode = DMA_CIRCULAR;
+	if (HAL_DMA_Init(hi2c->hdmatx) != HAL_OK) goto failed;
+	hi2c->hdmatx->XferHalfCpltCallback = MCP4725_streamHalfCplt;
+	hi2c->hdmatx->XferCpltCallback = MCP4725_streamCplt;
+	hi2c->hdmatx->XferErrorCallback = MCP4725_streamDmaError;
+	hi2c->hdmatx->XferAbortCallback = NULL;
+
+	_MCP4725_inFlight = _MCP4725;
+	_MCP4725_streaming = _MCP4725;
+	if (HAL_DMA_Start_IT(hi2c->hdmatx, (uint32_t)ring, (uint32_t)&hi2c->Instance->DR, length) != HAL_OK)
+	{
+		_MCP4725_inFlight = NULL;
+		MCP4725_restoreStreamDma(hi2c);
+		SET_BIT(hi2c->Instance->CR1, I2C_CR1_STOP);
+		goto failed;
+	}
+
+	__HAL_I2C_ENABLE_IT(hi2c, I2C_IT_ERR);                           //a NACK ends the stream through HAL_I2C_ErrorCallback
+	SET_BIT(hi2c->Instance->CR2, I2C_CR2_DMAEN);
+	__HAL_I2C_CLEAR_ADDRFLAG(hi2c);
+
+	return 1;
+
+failed:
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->Mode = HAL_I2C_MODE_NONE;
+	return 0;
+}
+
+/**************************************************************************/
+/*
+    stopStream()
+
+    Stop the DMA, let the byte in the shift register out & send the stop,
+    the DAC ignores a write cut after its first byte
+*/
+/**************************************************************************/ 
+void MCP4725_stopStream(void)
+{
+	MCP4725* device = _MCP4725_streaming;
+	I2C_HandleTypeDef* hi2c;
+	uint32_t count = MCP4725_STREAM_FLAG_TIMEOUT;
+
+	if (device == NULL) return;
+	hi2c = device->hi2c;
+
+	__HAL_I2C_DISABLE_IT(hi2c, I2C_IT_ERR);
+	CLEAR_BIT(hi2c->Instance->CR2, I2C_CR2_DMAEN);
+	HAL_DMA_Abort(hi2c->hdmatx);
+
+	while (__HAL_I2C_GET_FLAG(hi2c, I2C_FLAG_BTF) == RESET && --count != 0);
+	SET_BIT(hi2c->Instance->CR1, I2C_CR1_STOP);
+
+	MCP4725_restoreStreamDma(hi2c);
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->Mode = HAL_I2C_MODE_NONE;
+	_MCP4725_inFlight = NULL;
+}
+
+/**************************************************************************/
+/*
+    abortAsync()
+
+    Forget the transfer in flight without calling back, for bus recovery,
+    the caller re-initialises the I2C peripheral afterwards
+*/
+/**************************************************************************/ 
+void MCP4725_abortAsync(void)
+{
+	MCP4725* device = _MCP4725_inFlight;
+
+	if (device == NULL) return;
+
+	HAL_DMA_Abort(device->hi2c->hdmatx);
+	if (device == _MCP4725_streaming) MCP4725_restoreStreamDma(device->hi2c);
+	_MCP4725_inFlight = NULL;
+}
+
+/**************************************************************************/
+/*
+    isStreaming()
+
+    Return 1 while a stream transaction is open
+*/
+/**************************************************************************/ 
+uint8_t MCP4725_isStreaming(void)
+{
+	return _MCP4725_streaming != NULL;
+}
+
 /**************************************************************************/
 /*
     setVoltage()
@@ -465,3 +730,31 @@ uint16_t MCP4725_readRegister(MCP4725* _MCP4725, MCP4725_READ_TYPE dataType)
 
   return ret_val;
 }
+
+/**************************************************************************/
+/*
+    completeAsync()
+
+    Release the bus & hand the result to the owner of the async write
+*/
+/**************************************************************************/ 
+static void MCP4725_completeAsync(I2C_HandleTypeDef *hi2c, uint8_t success)
+{
+	MCP4725* device = _MCP4725_inFlight;
+
+	if (device == NULL || device->hi2c != hi2c) return;
+
+	if (device == _MCP4725_streaming) MCP4725_restoreStreamDma(hi2c); //HAL already aborted the DMA & released the bus
+	_MCP4725_inFlight = NULL;
+	if (device->_callback != NULL) device->_callback(device, success);
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	MCP4725_completeAsync(hi2c, 1);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	MCP4725_completeAsync(hi2c, 0);
+}
@@ -93,6 +93,16 @@ MCP4725_READ_TYPE;
 #define MCP4725_REFERENCE_VOLTAGE    3.30                         //supply-reference votltage
 #define MCP4725_MAX_VALUE            4095 //((MCP4725_STEPS) - 1)
 #define MCP4725_ERROR                0xFFFF                       //returns 65535, if communication error is occurred
+#define MCP4725_FAST_WRITE_BYTES     2                            //bytes per fast mode write, repeatable after one address
+#define MCP4725_STREAM_BITS_PER_WRITE 18                          //SCL clocks per streamed write, 2 bytes with acks
+
+struct MCP;
+
+/* async write completion, runs from the I2C interrupt, success = 0 on a bus error */
+typedef void (*MCP4725_ASYNC_CALLBACK)(struct MCP* _MCP4725, uint8_t success);
+
+/* stream refill, runs from the DMA interrupt, fill "length" bytes of fast writes */
+typedef void (*MCP4725_STREAM_CALLBACK)(struct MCP* _MCP4725, uint8_t* buffer, uint16_t length);
 
 typedef struct MCP
 {
@@ -101,6 +111,8 @@ typedef struct MCP
 	MCP4725Ax_ADDRESS _i2cAddress;
   float             _refVoltage;
   uint16_t          _bitsPerVolt;
+  uint8_t           _txBuffer[2];                                  //DMA source, must outlive the transfer
+  MCP4725_ASYNC_CALLBACK _callback;
 } MCP4725;
 
 
@@ -114,6 +126,13 @@ float			MCP4725_getReferenceVoltage(MCP4725* _MCP4725);
 
 uint8_t		MCP4725_setValue(MCP4725* _MCP4725, uint16_t value, MCP4725_COMMAND_TYPE mode, MCP4725_POWER_DOWN_TYPE powerType);
 uint8_t		MCP4725_setVoltage(MCP4725* _MCP4725, float voltage, MCP4725_COMMAND_TYPE mode, MCP4725_POWER_DOWN_TYPE powerType);
+uint8_t		MCP4725_setValueAsync(MCP4725* _MCP4725, uint16_t value, MCP4725_POWER_DOWN_TYPE powerType, MCP4725_ASYNC_CALLBACK callback);
+uint8_t		MCP4725_isBusy(void);
+void			MCP4725_packFastWrite(uint8_t* buffer, uint16_t value, MCP4725_POWER_DOWN_TYPE powerType);
+uint8_t		MCP4725_startStream(MCP4725* _MCP4725, uint8_t* ring, uint16_t length, MCP4725_STREAM_CALLBACK refill, MCP4725_ASYNC_CALLBACK stopped);
+void			MCP4725_stopStream(void);
+uint8_t		MCP4725_isStreaming(void);
+void			MCP4725_abortAsync(void);
 
 uint16_t	MCP4725_getValue(MCP4725* _MCP4725);
 float			MCP4725_getVoltage(MCP4725* _MCP4725);
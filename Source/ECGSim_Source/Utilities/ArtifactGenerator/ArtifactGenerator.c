@@ -0,0 +1,180 @@
+/*
+ * ArtifactGenerator.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "ArtifactGenerator.h"
+#include "FixedPoint/FixedPoint.h"
+#include <string.h>
+
+#define ARTIFACT_EMG_LOW_HZ			20UL
+#define ARTIFACT_EMG_HIGH_HZ		150UL
+
+
+/* Electrode half cell recovery time constant */
+#define ARTIFACT_MOTION_TAU_MS		500UL
+
+#define ARTIFACT_RANDOM_SEED		1
+
+/* 2*pi in Q15 */
+#define TWO_PI_Q15					205887UL
+
+/**
+ * @brief One pole low pass coefficient in Q15, alpha = w / (1 + w) with
+ * w = 2*pi*fc/fs. Close enough to the exact 1 - exp(-w) for noise shaping.
+ */
+static int32_t getOnePoleAlpha(uint32_t cornerHz, uint32_t sampleRate)
+{
+	uint32_t w = (cornerHz * TWO_PI_Q15) / sampleRate;
+	return (int32_t)((w << 15) / (FIXED_POINT_Q15_ONE + w));
+}
+
+static uint32_t getPhaseStep(uint32_t frequency, uint32_t divisor)
+{
+	return (uint32_t)(((uint64_t)frequency << 32) / divisor);
+}
+
+void ArtifactGeneratorInit(artifactGenerator_t* generator, uint32_t sampleRate)
+{
+	memset(generator, 0, sizeof(artifactGenerator_t));
+	generator->parameter[ARTIFACT_POWERLINE] = ARTIFACT_POWERLINE_DEFAULT_HZ;
+	generator->parameter[ARTIFACT_BASELINE_WANDER] = ARTIFACT_WANDER_DEFAULT_CENTIHZ;
+	generator->parameter[ARTIFACT_ELECTRODE_MOTION] = ARTIFACT_MOTION_DEFAULT_PER_MIN;
+	generator->randomState = ARTIFACT_RANDOM_SEED;
+	ArtifactGeneratorSetSampleRate(generator, sampleRate);
+}
+
+/**
+ * @brief Sets one source
+ * @param amplitude peak level in output units, 0 turns the source off
+ * @param parameter source specific, 0 keeps the current value
+ */
+bool ArtifactGeneratorConfigure(artifactGenerator_t* generator, artifactType_t type, int32_t amplitude, uint32_t parameter)
+{
+	if(type >= ARTIFACT_COUNT || amplitude < 0 || amplitude > ARTIFACT_MAX_AMPLITUDE)
+	{
+		return false;
+	}
+
+	if(parameter != 0)
+	{
+		switch(type)
+		{
+		case ARTIFACT_POWERLINE:
+			if(parameter < ARTIFACT_POWERLINE_MIN_HZ || parameter > ARTIFACT_POWERLINE_MAX_HZ)
+				return false;
+			break;
+		case ARTIFACT_BASELINE_WANDER:
+			if(parameter < ARTIFACT_WANDER_MIN_CENTIHZ || parameter > ARTIFACT_WANDER_MAX_CENTIHZ)
+				return false;
+			break;
+		case ARTIFACT_ELECTRODE_MOTION:
+			if(parameter < ARTIFACT_MOTION_MIN_PER_MIN || parameter > ARTIFACT_MOTION_MAX_PER_MIN)
+				return false;
+			break;
+		default:
+			break;
+		}
+		generator->parameter[type] = parameter;
+	}
+
+	generator->amplitude[type] = amplitude;
+	if(type == ARTIFACT_ELECTRODE_MOTION && amplitude == 0)
+	{
+		generator->motionLevel = 0;
+	}
+	ArtifactGeneratorSetSampleRate(generator, generator->sampleRate);
+	return true;
+}
+
+/**
+ * @brief Recomputes the per sample steps and filter coefficients, runs only
+ * when the configuration or the sample clock changes
+ */
+void ArtifactGeneratorSetSampleRate(artifactGenerator_t* generator, uint32_t sampleRate)
+{
+	uint32_t tauSamples = (ARTIFACT_MOTION_TAU_MS * sampleRate) / 1000UL;
+
+	generator->sampleRate = sampleRate;
+	generator->powerlineStep = getPhaseStep(generator->parameter[ARTIFACT_POWERLINE], sampleRate);
+	generator->wanderStep = getPhaseStep(generator->parameter[ARTIFACT_BASELINE_WANDER], sampleRate * 100UL);
+	generator->emgFastAlpha = getOnePoleAlpha(ARTIFACT_EMG_HIGH_HZ, sampleRate);
+	generator->emgSlowAlpha = getOnePoleAlpha(ARTIFACT_EMG_LOW_HZ, sampleRate);
+	generator->motionThreshold = getPhaseStep(generator->parameter[ARTIFACT_ELECTRODE_MOTION], sampleRate * 60UL);
+
+	//Decay by 1/2^shift per sample, the closest power of two to the time constant
+	generator->motionDecayShift = 0;
+	while((1UL << (generator->motionDecayShift + 1)) <= tauSamples)
+	{
+		generator->motionDecayShift++;
+	}
+}
+
+bool ArtifactGeneratorIsActive(const artifactGenerator_t* generator)
+{
+	for(int i = 0; i < ARTIFACT_COUNT; i++)
+	{
+		if(generator->amplitude[i] != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Sum of the enabled sources for the next sample
+ */
+int32_t ArtifactGeneratorNext(artifactGenerator_t* generator)
+{
+	int32_t sum = 0;
+
+	if(generator->amplitude[ARTIFACT_POWERLINE] != 0)
+	{
+		generator->powerlinePhase += generator->powerlineStep;
+		sum += (generator->amplitude[ARTIFACT_POWERLINE] * FixedPointSin(generator->powerlinePhase)) >> 15;
+	}
+
+	if(generator->amplitude[ARTIFACT_BASELINE_WANDER] != 0)
+	{
+		generator->wanderPhase += generator->wanderStep;
+		sum += (generator->amplitude[ARTIFACT_BASELINE_WANDER] * FixedPointSin(generator->wanderPhase)) >> 15;
+	}
+
+	if(generator->amplitude[ARTIFACT_EMG] != 0)
+	{
+		int32_t white = FixedPointRandomQ15(&generator->randomState);
+		generator->emgFast += ((white - generator->emgFast) * generator->emgFastAlpha) >> 15;
+		generator->emgSlow += ((generator->emgFast - generator->emgSlow) * generator->emgSlowAlpha) >> 15;
+
+		//The band keeps about 0.3 of full scale RMS, the amplitude is the rare peak
+		int32_t band = generator->emgFast - generator->emgSlow;
+		if(band > FIXED_POINT_Q15_ONE)
+		{
+			band = FIXED_POINT_Q15_ONE;
+		}
+		else if(band < -FIXED_POINT_Q15_ONE)
+		{
+			band = -FIXED_POINT_Q15_ONE;
+		}
+		sum += (generator->amplitude[ARTIFACT_EMG] * band) >> 15;
+	}
+
+	if(generator->amplitude[ARTIFACT_ELECTRODE_MOTION] != 0 &&
+			FixedPointRandom(&generator->randomState) < generator->motionThreshold)
+	{
+		//Step of half to full amplitude in Q8, either direction
+		int32_t scale = 0x8000 + (FixedPointRandomQ15(&generator->randomState) & 0x7FFF);
+		int32_t step = (generator->amplitude[ARTIFACT_ELECTRODE_MOTION] * scale) >> 8;
+		generator->motionLevel += (FixedPointRandom(&generator->randomState) & 0x80000000UL) ? -step : step;
+	}
+	if(generator->motionLevel != 0)
+	{
+		generator->motionLevel -= generator->motionLevel >> generator->motionDecayShift;
+		sum += generator->motionLevel >> 8;
+	}
+
+	return sum;
+}
@@ -0,0 +1,66 @@
+/*
+ * ArtifactGenerator.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Additive recording artifacts generated per sample in fixed point.
+ *  Amplitudes are in output units (the caller uses DAC codes) and each
+ *  source is off while its amplitude is 0.
+ *   - Powerline: DDS on the shared sine table, 50 or 60 Hz
+ *   - Baseline wander: slow DDS sine, frequency in hundredths of a Hz
+ *   - EMG: LCG white noise through a 20-150 Hz band pass of two one pole filters
+ *   - Electrode motion: random baseline steps that relax back exponentially
+ */
+
+#ifndef UTILITIES_ARTIFACTGENERATOR_ARTIFACTGENERATOR_H_
+#define UTILITIES_ARTIFACTGENERATOR_ARTIFACTGENERATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum{
+	ARTIFACT_POWERLINE,				//parameter: mains frequency in Hz
+	ARTIFACT_BASELINE_WANDER,		//parameter: frequency in 0.01 Hz
+	ARTIFACT_EMG,					//parameter: unused
+	ARTIFACT_ELECTRODE_MOTION,		//parameter: steps per minute
+	ARTIFACT_COUNT
+}artifactType_t;
+
+#define ARTIFACT_MAX_AMPLITUDE				2047
+
+#define ARTIFACT_POWERLINE_MIN_HZ			40
+#define ARTIFACT_POWERLINE_MAX_HZ			70
+#define ARTIFACT_POWERLINE_DEFAULT_HZ		50
+#define ARTIFACT_WANDER_MIN_CENTIHZ			5
+#define ARTIFACT_WANDER_MAX_CENTIHZ			100
+#define ARTIFACT_WANDER_DEFAULT_CENTIHZ		25
+#define ARTIFACT_MOTION_MIN_PER_MIN			1
+#define ARTIFACT_MOTION_MAX_PER_MIN			120
+#define ARTIFACT_MOTION_DEFAULT_PER_MIN		6
+
+typedef struct{
+	int32_t amplitude[ARTIFACT_COUNT];
+	uint32_t parameter[ARTIFACT_COUNT];
+	uint32_t sampleRate;
+	uint32_t powerlinePhase;
+	uint32_t powerlineStep;
+	uint32_t wanderPhase;
+	uint32_t wanderStep;
+	int32_t emgFast;
+	int32_t emgSlow;
+	int32_t emgFastAlpha;			//Q15
+	int32_t emgSlowAlpha;			//Q15
+	int32_t motionLevel;			//output units in Q8
+	uint32_t motionThreshold;		//per sample step probability in 1/2^32
+	uint8_t motionDecayShift;
+	uint32_t randomState;
+}artifactGenerator_t;
+
+void ArtifactGeneratorInit(artifactGenerator_t* generator, uint32_t sampleRate);
+bool ArtifactGeneratorConfigure(artifactGenerator_t* generator, artifactType_t type, int32_t amplitude, uint32_t parameter);
+void ArtifactGeneratorSetSampleRate(artifactGenerator_t* generator, uint32_t sampleRate);
+bool ArtifactGeneratorIsActive(const artifactGenerator_t* generator);
+int32_t ArtifactGeneratorNext(artifactGenerator_t* generator);
+
+#endif /* UTILITIES_ARTIFACTGENERATOR_ARTIFACTGENERATOR_H_ */
@@ -23,12 +23,21 @@
 #include <stdlib.h>
 #include <string.h>
 
-static bool isCircularQueueFull(CircularQueue_t* queueHandle);
-static bool isCircularQueueEmpty(CircularQueue_t* queueHandle);
+/*
+ * The data copy must be visible before the index that publishes it, and a
+ * slot must be read before the index that frees it. Acquire loads and
+ * release stores of the other side's index order them (DMB on Cortex-M).
+ */
+#define CQ_LOAD_ACQUIRE(index)			__atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define CQ_STORE_RELEASE(index, value)	__atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+static bool isPowerOfTwo(uint32_t size);
+static uint32_t getReadableData(CircularQueue_t* queueHandle);
+static uint32_t getWritableSpace(CircularQueue_t* queueHandle);
 
 bool CircularQueueInit_dynMem(CircularQueue_t* queueHandle, uint32_t maxSize)
 {
-	if(queueHandle == NULL || 0 >= maxSize)
+	if(queueHandle == NULL || !isPowerOfTwo(maxSize))
 	{
 		return false;
 	}
@@ -49,14 +58,14 @@ bool CircularQueueInit_dynMem(CircularQueue_t* queueHandle, uint32_t maxSize)
  * @brief function to init queue with queueHandle params and checks if th eQueue handle passed is valid
  * @param queueHandle
  * @param pQBuffer
- * @param maxSize
+ * @param maxSize power of two
  * @return true:success
  * false:failure
  * @note provide sufficiently large Buffers
  */
 bool CircularQueueInit(CircularQueue_t* queueHandle, uint8_t* pQBuffer, uint32_t maxSize)
 {
-	if(queueHandle == NULL || NULL == pQBuffer || 0 >= maxSize )
+	if(queueHandle == NULL || NULL == pQBuffer || !isPowerOfTwo(maxSize))
 	{
 		return false;
 	}
@@ -82,7 +91,6 @@ bool CircularQueueDeinit(CircularQueue_t* queueHandle)
 		queueHandle->maxSize = 0;
 		queueHandle->headIndex = 0;
 		queueHandle->tailIndex = 0;
-		//		queueHandle->remainingDataSizeTobeRead = 0;
 	}
 	else status = false;
 	return status;
@@ -107,7 +115,7 @@ bool CircularQueueDeinit_dynMem(CircularQueue_t* queueHandle)
 }
 
 /**
- * @brief function to reset Queue indices
+ * @brief function to reset Queue indices, neither side may be running
  * @param queueHandle
  */
 bool CircularQueueReset(CircularQueue_t* queueHandle)
@@ -131,18 +139,14 @@ bool CircularQueueReset(CircularQueue_t* queueHandle)
  */
 bool CircularQueueWriteByte(CircularQueue_t* queueHandle, uint8_t data)
 {
-	if(queueHandle == NULL)
-	{
-		return false;
-	}
-
-	if(isCircularQueueFull(queueHandle))
+	if(queueHandle == NULL || getWritableSpace(queueHandle) == 0)
 	{
 		return false;
 	}
 
-	queueHandle->data[queueHandle->headIndex++] = data;
-	queueHandle->headIndex = queueHandle->headIndex%queueHandle->maxSize;
+	uint32_t head = queueHandle->headIndex;
+	queueHandle->data[head & (queueHandle->maxSize - 1)] = data;
+	CQ_STORE_RELEASE(queueHandle->headIndex, head + 1);
 	return true;
 }
 
@@ -151,35 +155,29 @@ bool CircularQueueWriteByte(CircularQueue_t* queueHandle, uint8_t data)
  * @param queueHandle
  * @param data
  * @param size
- * @return true:success
- * false:failure
+ * @return bytes written, what does not fit is left out
  */
-uint32_t CircularQueueWriteBytes(CircularQueue_t* queueHandle, uint8_t* data, uint32_t size)
+uint32_t CircularQueueWriteBytes(CircularQueue_t* queueHandle, const uint8_t* data, uint32_t size)
 {
-	if(queueHandle == NULL)
+	if(queueHandle == NULL || data == NULL)
 	{
-		return false;
+		return 0;
 	}
 
-	uint32_t spaceAvailable = CircularQueueGetRemainingSpace(queueHandle);
+	uint32_t spaceAvailable = getWritableSpace(queueHandle);
 
 	if(size > spaceAvailable)
 	{
 		size = spaceAvailable;
 	}
 
-	if(queueHandle->headIndex+size < queueHandle->maxSize)
-	{
-		memcpy(&queueHandle->data[queueHandle->headIndex], data, size);
-		queueHandle->headIndex += size;
-	}
-	else
-	{
-		memcpy(&queueHandle->data[queueHandle->headIndex], &data[0], queueHandle->maxSize - queueHandle->headIndex);
-		queueHandle->headIndex = ( queueHandle->headIndex + size ) % queueHandle->maxSize;
-		memcpy(&queueHandle->data[0], &data[size-queueHandle->headIndex], queueHandle->headIndex);
-	}
-	//	queueHandle->remainingDataSizeTobeRead = CircularQueueGetRemainingData(queueHandle);
+	uint32_t head = queueHandle->headIndex;
+	uint32_t offset = head & (queueHandle->maxSize - 1);
+	uint32_t first = (size < queueHandle->maxSize - offset) ? size : queueHandle->maxSize - offset;
+
+	memcpy(&queueHandle->data[offset], data, first);
+	memcpy(&queueHandle->data[0], &data[first], size - first);
+	CQ_STORE_RELEASE(queueHandle->headIndex, head + size);
 
 	return size;
 }
@@ -193,19 +191,14 @@ uint32_t CircularQueueWriteBytes(CircularQueue_t* queueHandle, uint8_t* data, ui
  */
 bool CircularQueueReadByte(CircularQueue_t* queueHandle, uint8_t* data)
 {
-	if(queueHandle == NULL)
-	{
-		return false;
-	}
-
-	if(isCircularQueueEmpty(queueHandle))
+	if(queueHandle == NULL || getReadableData(queueHandle) == 0)
 	{
 		return false;
 	}
 
-	*data = queueHandle->data[queueHandle->tailIndex++];
-	queueHandle->tailIndex = queueHandle->tailIndex%queueHandle->maxSize;
-	//	queueHandle->remainingDataSizeTobeRead = CircularQueueGetRemainingData(queueHandle);
+	uint32_t tail = queueHandle->tailIndex;
+	*data = queueHandle->data[tail & (queueHandle->maxSize - 1)];
+	CQ_STORE_RELEASE(queueHandle->tailIndex, tail + 1);
 	return true;
 }
 
@@ -214,86 +207,159 @@ bool CircularQueueReadByte(CircularQueue_t* queueHandle, uint8_t* data)
  * @param queueHandle
  * @param data
  * @param size
- * @return true:success
- * false:failure
+ * @return bytes read
  */
 uint32_t CircularQueueReadBytes(CircularQueue_t* queueHandle, uint8_t* data, uint32_t size)
 {
-	if(queueHandle == NULL)
+	if(queueHandle == NULL || data == NULL)
 	{
-		return false;
+		return 0;
 	}
 
-	uint32_t dataAvailable = CircularQueueGetRemainingData(queueHandle);
+	uint32_t dataAvailable = getReadableData(queueHandle);
 
 	if(size > dataAvailable)
 	{
 		size = dataAvailable;
 	}
 
-	if(queueHandle->tailIndex+size < queueHandle->maxSize)
+	uint32_t tail = queueHandle->tailIndex;
+	uint32_t offset = tail & (queueHandle->maxSize - 1);
+	uint32_t first = (size < queueHandle->maxSize - offset) ? size : queueHandle->maxSize - offset;
+
+	memcpy(data, &queueHandle->data[offset], first);
+	memcpy(&data[first], &queueHandle->data[0], size - first);
+	CQ_STORE_RELEASE(queueHandle->tailIndex, tail + size);
+
+	return size;
+}
+
+/**
+ * @brief Consumer side, points at the oldest bytes without taking them,
+ * release them with CircularQueueCommitRead
+ * @param queueHandle
+ * @param data set to the first byte
+ * @return bytes readable in place, up to the end of the buffer
+ */
+uint32_t CircularQueuePeekContiguous(CircularQueue_t* queueHandle, uint8_t** data)
+{
+	if(queueHandle == NULL || data == NULL)
 	{
-		memcpy(data, &queueHandle->data[queueHandle->tailIndex], size);
-		queueHandle->tailIndex += size;
+		return 0;
 	}
-	else
+
+	uint32_t dataAvailable = getReadableData(queueHandle);
+	uint32_t offset = queueHandle->tailIndex & (queueHandle->maxSize - 1);
+
+	*data = &queueHandle->data[offset];
+	return (dataAvailable < queueHandle->maxSize - offset) ? dataAvailable : queueHandle->maxSize - offset;
+}
+
+/**
+ * @brief Consumer side, releases bytes read in place
+ * @param queueHandle
+ * @param size
+ * @return false when fewer bytes are queued
+ */
+bool CircularQueueCommitRead(CircularQueue_t* queueHandle, uint32_t size)
+{
+	if(queueHandle == NULL || size > getReadableData(queueHandle))
 	{
-		memcpy(&data[0], &queueHandle->data[queueHandle->tailIndex], queueHandle->maxSize - queueHandle->tailIndex);
-		queueHandle->tailIndex = ( queueHandle->tailIndex + size ) % queueHandle->maxSize;
-		memcpy(&data[size-queueHandle->tailIndex], &queueHandle->data[0], queueHandle->tailIndex);
+		return false;
 	}
-	//	queueHandle->remainingDataSizeTobeRead = CircularQueueGetRemainingData(queueHandle);
 
-	return size;
+	CQ_STORE_RELEASE(queueHandle->tailIndex, queueHandle->tailIndex + size);
+	return true;
 }
 
 /**
- * @brief function to get remaining space in the Queue
+ * @brief Consumer side, drops every queued byte
  * @param queueHandle
- * @return true:success
- * false:failure
  */
-uint32_t CircularQueueGetRemainingSpace(CircularQueue_t* queueHandle)
+bool CircularQueueFlush(CircularQueue_t* queueHandle)
 {
 	if(queueHandle == NULL)
 	{
 		return false;
 	}
 
-	if(queueHandle->tailIndex > queueHandle->headIndex)
+	CQ_STORE_RELEASE(queueHandle->tailIndex, CQ_LOAD_ACQUIRE(queueHandle->headIndex));
+	return true;
+}
+
+/**
+ * @brief Producer side, points at the free space to write in place,
+ * publish it with CircularQueueCommitWrite
+ * @param queueHandle
+ * @param data set to the first free byte
+ * @return bytes writable in place, up to the end of the buffer
+ */
+uint32_t CircularQueueReserveContiguous(CircularQueue_t* queueHandle, uint8_t** data)
+{
+	if(queueHandle == NULL || data == NULL)
 	{
-		return queueHandle->tailIndex - queueHandle->headIndex - 1;
+		return 0;
 	}
-	else
-	{
-		//		return queueHandle->maxSize - queueHandle->tailIndex + queueHandle->headIndex - 1;
-		return queueHandle->maxSize - queueHandle->headIndex + queueHandle->tailIndex;
 
-	}
-}
+	uint32_t spaceAvailable = getWritableSpace(queueHandle);
+	uint32_t offset = queueHandle->headIndex & (queueHandle->maxSize - 1);
 
+	*data = &queueHandle->data[offset];
+	return (spaceAvailable < queueHandle->maxSize - offset) ? spaceAvailable : queueHandle->maxSize - offset;
+}
 
 /**
- * @brief Function to get reminaing data in the Queue
+ * @brief Producer side, publishes bytes written in place. A producer that
+ * cannot wait, a DMA, may commit past the free space, readers then skip
+ * ahead to the newest maxSize bytes.
  * @param queueHandle
- * @return true:success
- * false:failure
+ * @param size
+ * @return false when unread bytes were overwritten
  */
-uint32_t CircularQueueGetRemainingData(CircularQueue_t* queueHandle)
+bool CircularQueueCommitWrite(CircularQueue_t* queueHandle, uint32_t size)
 {
 	if(queueHandle == NULL)
 	{
 		return false;
 	}
 
-	if(queueHandle->headIndex >= queueHandle->tailIndex)
+	bool status = (size <= getWritableSpace(queueHandle));
+	CQ_STORE_RELEASE(queueHandle->headIndex, queueHandle->headIndex + size);
+	return status;
+}
+
+/**
+ * @brief function to get remaining space in the Queue
+ * @param queueHandle
+ * @return free bytes
+ */
+uint32_t CircularQueueGetRemainingSpace(CircularQueue_t* queueHandle)
+{
+	if(queueHandle == NULL)
 	{
-		return queueHandle->headIndex - queueHandle->tailIndex;
+		return 0;
 	}
-	else
+
+	return queueHandle->maxSize - CircularQueueGetRemainingData(queueHandle);
+}
+
+
+/**
+ * @brief Function to get reminaing data in the Queue
+ * @param queueHandle
+ * @return queued bytes
+ */
+uint32_t CircularQueueGetRemainingData(CircularQueue_t* queueHandle)
+{
+	if(queueHandle == NULL)
 	{
-		return queueHandle->maxSize - queueHandle->tailIndex + queueHandle->headIndex;
+		return 0;
 	}
+
+	uint32_t tail = CQ_LOAD_ACQUIRE(queueHandle->tailIndex);
+	uint32_t used = CQ_LOAD_ACQUIRE(queueHandle->headIndex) - tail;
+
+	return (used < queueHandle->maxSize) ? used : queueHandle->maxSize;
 }
 
 /**@}*/ //Public Functions
@@ -303,39 +369,44 @@ uint32_t CircularQueueGetRemainingData(CircularQueue_t* queueHandle)
  * @{
  */
 /**
- * @brief Private Function to check if the Queuue is Full
+ * @brief Private Function to check the size can be masked
+ * @param size
+ * @return true : non zero power of two that fits the free running indices
+ */
+static bool isPowerOfTwo(uint32_t size)
+{
+	return size != 0 && size <= 0x80000000UL && (size & (size - 1)) == 0;
+}
+
+/**
+ * @brief Private consumer function, bytes ready to read. Skips ahead when
+ * the producer lapped the reader.
  * @param queueHandle Pointer to #CircularQueue_t
- * @return true : Full
- * false: not full
+ * @return queued bytes
  */
-bool isCircularQueueFull(CircularQueue_t* queueHandle)
+static uint32_t getReadableData(CircularQueue_t* queueHandle)
 {
-	if(((queueHandle->headIndex+1)%queueHandle->maxSize) == queueHandle->tailIndex)
-	{
-		return true;
-	}
-	else
+	uint32_t head = CQ_LOAD_ACQUIRE(queueHandle->headIndex);
+	uint32_t used = head - queueHandle->tailIndex;
+
+	if(used > queueHandle->maxSize)
 	{
-		return false;
+		CQ_STORE_RELEASE(queueHandle->tailIndex, head - queueHandle->maxSize);
+		used = queueHandle->maxSize;
 	}
+	return used;
 }
 
 /**
- * @brief Private function to check if Circular Queue is empty
- * @param Pointer to #CircularQueue_t
- * @return true : Full
- * false: not full
+ * @brief Private producer function, free bytes
+ * @param queueHandle Pointer to #CircularQueue_t
+ * @return 0 when full or lapped
  */
-bool isCircularQueueEmpty(CircularQueue_t* queueHandle)
+static uint32_t getWritableSpace(CircularQueue_t* queueHandle)
 {
-	if(queueHandle->headIndex == queueHandle->tailIndex)
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	uint32_t used = queueHandle->headIndex - CQ_LOAD_ACQUIRE(queueHandle->tailIndex);
+
+	return (used < queueHandle->maxSize) ? queueHandle->maxSize - used : 0;
 }
 /**@}*/ //Pvt functions
 /**@}*/ //main defgroup Utils
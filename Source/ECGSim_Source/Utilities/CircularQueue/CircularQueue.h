@@ -16,14 +16,16 @@
 
 
 /**
- * Data structure containing Queue params
+ * Data structure containing Queue params. The queue is safe between one
+ * producer and one consumer, either of them may be an interrupt. The indices
+ * run free and are masked on access, so maxSize must be a power of two and
+ * all of it holds data.
  */
 typedef struct{
 	uint8_t* data;
 	uint32_t maxSize;
-	uint32_t headIndex;
-	uint32_t tailIndex;
-//	uint32_t remainingDataSizeTobeRead;
+	volatile uint32_t headIndex;	//written by the producer only
+	volatile uint32_t tailIndex;	//written by the consumer only
 }CircularQueue_t;
 
 
@@ -31,7 +33,7 @@ typedef struct{
  * function to init queue with queueHandle params and checks if th eQueue handle passed is valid
  * @param queueHandle
  * @param pQBuffer
- * @param maxSize
+ * @param maxSize power of two
  * @return true:success
  * false:failure
  */
@@ -49,7 +51,7 @@ bool CircularQueueDeinit(CircularQueue_t* queueHandle);
 bool CircularQueueDeinit_dynMem(CircularQueue_t* queueHandle);
 
 /**
- * function to reset Queue indices
+ * function to reset Queue indices, neither side may be running
  * @param queueHandle
  */
 bool CircularQueueReset(CircularQueue_t* queueHandle);
@@ -68,10 +70,9 @@ bool CircularQueueWriteByte(CircularQueue_t* queueHandle, uint8_t data);
  * @param queueHandle
  * @param data
  * @param size
- * @return true:success
- * false:failure
+ * @return bytes written
  */
-uint32_t CircularQueueWriteBytes(CircularQueue_t* queueHandle, uint8_t* data, uint32_t size);
+uint32_t CircularQueueWriteBytes(CircularQueue_t* queueHandle, const uint8_t* data, uint32_t size);
 
 /**
  * function to read a byte from the Queue
@@ -88,17 +89,55 @@ bool CircularQueueReadByte(CircularQueue_t* queueHandle, uint8_t* data);
  * @param queueHandle
  * @param data
  * @param size
- * @return true:success
- * false:failure
+ * @return bytes read
  */
 uint32_t CircularQueueReadBytes(CircularQueue_t* queueHandle, uint8_t* data, uint32_t size);
 
+/**
+ * Consumer side, points at the oldest bytes without taking them
+ * @param queueHandle
+ * @param data set to the first byte
+ * @return bytes readable in place, up to the end of the buffer
+ */
+uint32_t CircularQueuePeekContiguous(CircularQueue_t* queueHandle, uint8_t** data);
+
+/**
+ * Consumer side, releases bytes read in place
+ * @param queueHandle
+ * @param size
+ * @return false when fewer bytes are queued
+ */
+bool CircularQueueCommitRead(CircularQueue_t* queueHandle, uint32_t size);
+
+/**
+ * Consumer side, drops every queued byte
+ * @param queueHandle
+ */
+bool CircularQueueFlush(CircularQueue_t* queueHandle);
+
+/**
+ * Producer side, points at the free space to write in place
+ * @param queueHandle
+ * @param data set to the first free byte
+ * @return bytes writable in place, up to the end of the buffer
+ */
+uint32_t CircularQueueReserveContiguous(CircularQueue_t* queueHandle, uint8_t** data);
+
+/**
+ * Producer side, publishes bytes written in place. A producer that cannot
+ * wait, a DMA, may commit past the free space, readers then lose the oldest
+ * bytes.
+ * @param queueHandle
+ * @param size
+ * @return false when unread bytes were overwritten
+ */
+bool CircularQueueCommitWrite(CircularQueue_t* queueHandle, uint32_t size);
+
 
 /**
  * function to get remaining space in the Queue
  * @param queueHandle
- * @return true:success
- * false:failure
+ * @return free bytes
  */
 uint32_t CircularQueueGetRemainingSpace(CircularQueue_t* queueHandle);
 
@@ -106,8 +145,7 @@ uint32_t CircularQueueGetRemainingSpace(CircularQueue_t* queueHandle);
 /**
  * Function to get reminaing data in the Queue
  * @param queueHandle
- * @return true:success
- * false:failure
+ * @return queued bytes
  */
 uint32_t CircularQueueGetRemainingData(CircularQueue_t* queueHandle);
 
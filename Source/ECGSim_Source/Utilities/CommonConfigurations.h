@@ -14,16 +14,20 @@
 #define MAX_PEAKS 5
 
 
-#define DAC_VREF              3.3f
+#define DAC_VREF_UV           3300000LL
 #define DAC_BITS              12
 #define DAC_MAX_CODE          ((1 << DAC_BITS) - 1)
 #define DAC_MID_CODE          (DAC_MAX_CODE / 2)   // 2047 or 2048
-#define DIVIDER_RATIO         (10.0f / (10000.0f + 10.0f))  // ≈ 0.001
+#define DAC_CHANNEL_COUNT     2                    // one MCP4725 per lead, A0 = 0 and A0 = 1
+#define DIVIDER_TOP_OHMS      10000LL
+#define DIVIDER_BOTTOM_OHMS   10LL                 // ratio ≈ 0.001
 
-#define ECG_PP_MV_TARGET      3.0f    // 3 mV p-p at RA–LA
-#define ECG_DAC_PP_VOLTS  (ECG_PP_MV_TARGET * 1e-3f / DIVIDER_RATIO)
-#define ECG_DAC_PP_CODES  ((ECG_DAC_PP_VOLTS / DAC_VREF) * DAC_MAX_CODE)
-#define ECG_DAC_HALF_SWING  (ECG_DAC_PP_CODES / 2.0f)   // ≈ 1863
+/* Microvolts at RA–LA to DAC codes through the divider, integer only */
+#define ECG_UV_TO_DAC_CODES(uv)  (((long long)(uv) * (DIVIDER_TOP_OHMS + DIVIDER_BOTTOM_OHMS) * DAC_MAX_CODE) / \
+                                  (DIVIDER_BOTTOM_OHMS * DAC_VREF_UV))
+
+#define ECG_PP_UV_TARGET      3000    // 3 mV p-p at RA–LA
+#define ECG_DAC_HALF_SWING    (ECG_UV_TO_DAC_CODES(ECG_PP_UV_TARGET) / 2)   // ≈ 1863
 
 #define IS_VALID_PNTR(X) ((NULL != X )?true:false)
 #endif /* UTILITIES_COMMONCONFIGURATIONS_H_ */
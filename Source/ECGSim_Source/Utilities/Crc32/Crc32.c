@@ -0,0 +1,31 @@
+/*
+ * Crc32.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "Crc32.h"
+
+static const uint32_t g_crc32NibbleTable[16] = {
+	0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+	0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+	0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+	0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+};
+
+/**
+ * @brief Continues a CRC over more data. Start with CRC32_INITIAL_VALUE, the
+ * running value is the finished CRC after every call.
+ */
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, uint32_t length)
+{
+	crc = ~crc;
+	while(length--)
+	{
+		crc ^= *data++;
+		crc = (crc >> 4) ^ g_crc32NibbleTable[crc & 0x0F];
+		crc = (crc >> 4) ^ g_crc32NibbleTable[crc & 0x0F];
+	}
+	return ~crc;
+}
@@ -0,0 +1,20 @@
+/*
+ * Crc32.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  CRC-32 as used by zlib/PNG (reflected 0x04C11DB7), so the host can check
+ *  it with zlib.crc32. Nibble table, 64 bytes of flash.
+ */
+
+#ifndef UTILITIES_CRC32_CRC32_H_
+#define UTILITIES_CRC32_CRC32_H_
+
+#include <stdint.h>
+
+#define CRC32_INITIAL_VALUE		0x00000000UL
+
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, uint32_t length);
+
+#endif /* UTILITIES_CRC32_CRC32_H_ */
@@ -0,0 +1,108 @@
+/*
+ * FixedPoint.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "FixedPoint.h"
+
+#define SINE_TABLE_BITS		8
+#define SINE_TABLE_SIZE		(1 << SINE_TABLE_BITS)
+
+/* One full period of sin() in Q15 */
+static const int16_t g_sineTable[SINE_TABLE_SIZE] = {
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+	6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+	32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571,
+	30273, 29956, 29621, 29268, 28898, 28510, 28105, 27683,
+	27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+	23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868,
+	18204, 17530, 16846, 16151, 15446, 14732, 14010, 13279,
+	12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+	6393, 5602, 4808, 4011, 3212, 2410, 1608, 804,
+	0, -804, -1608, -2410, -3212, -4011, -4808, -5602,
+	-6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179,
+	-6393, -5602, -4808, -4011, -3212, -2410, -1608, -804,
+};
+
+/**
+ * @brief Sine of a 32 bit phase, linearly interpolated between table entries
+ * @return Q15 value in -32767..32767
+ */
+int16_t FixedPointSin(uint32_t phase)
+{
+	uint32_t index = phase >> (32 - SINE_TABLE_BITS);
+	int32_t fraction = (int32_t)((phase >> (16 - SINE_TABLE_BITS)) & 0xFFFF);
+	int32_t a = g_sineTable[index];
+	int32_t b = g_sineTable[(index + 1) & (SINE_TABLE_SIZE - 1)];
+
+	return (int16_t)(a + (((b - a) * fraction) >> 16));
+}
+
+/**
+ * @brief Numerical Recipes LCG, shared by the HRV jitter and the artifact noise
+ */
+uint32_t FixedPointRandom(uint32_t* state)
+{
+	*state = 1664525UL * *state + 1013904223UL;
+	return *state;
+}
+
+/**
+ * @brief Uniform random value in Q15, -1.0 to just under +1.0. Uses the
+ * high bits, the low bits of an LCG have short periods.
+ */
+int16_t FixedPointRandomQ15(uint32_t* state)
+{
+	return (int16_t)(FixedPointRandom(state) >> 16);
+}
+
+/**
+ * @brief Integer square root, rounded down. Meant for configuration time.
+ */
+uint32_t FixedPointSqrt(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while(bit > value)
+	{
+		bit >>= 2;
+	}
+
+	while(bit != 0)
+	{
+		if(value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
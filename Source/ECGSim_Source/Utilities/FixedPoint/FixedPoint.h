@@ -0,0 +1,26 @@
+/*
+ * FixedPoint.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Integer helpers for the sample path. The Cortex-M3 has no FPU, so
+ *  anything that runs per sample or per beat uses these instead of float.
+ */
+
+#ifndef UTILITIES_FIXEDPOINT_FIXEDPOINT_H_
+#define UTILITIES_FIXEDPOINT_FIXEDPOINT_H_
+
+#include <stdint.h>
+
+#define FIXED_POINT_Q15_ONE			32768L
+
+/* Phases are unsigned 32 bit fractions of a full turn, wrapping is free */
+#define FIXED_POINT_PHASE_PER_MS(periodMs)	((uint32_t)(0x100000000ULL / (periodMs)))
+
+int16_t FixedPointSin(uint32_t phase);
+uint32_t FixedPointRandom(uint32_t* state);
+int16_t FixedPointRandomQ15(uint32_t* state);
+uint32_t FixedPointSqrt(uint32_t value);
+
+#endif /* UTILITIES_FIXEDPOINT_FIXEDPOINT_H_ */
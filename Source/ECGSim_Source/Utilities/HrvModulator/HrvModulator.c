@@ -0,0 +1,82 @@
+/*
+ * HrvModulator.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "HrvModulator.h"
+#include "FixedPoint/FixedPoint.h"
+
+/* Mayer wave centre frequency, 0.1 Hz */
+#define HRV_LF_PERIOD_MS			10000UL
+
+/* Per beat phase jitter, +-1/8 turn for LF and +-1/64 turn for respiration */
+#define HRV_LF_JITTER_SHIFT			14
+#define HRV_RESP_JITTER_SHIFT		11
+
+#define HRV_RANDOM_SEED				1
+
+/**
+ * @brief Derives the oscillator amplitudes from the configuration. The LF
+ * and HF powers split SDNN^2 by the LF/HF ratio, and a sine of amplitude
+ * A has a standard deviation of A/sqrt(2).
+ * @return false when the configuration is out of range
+ */
+bool HrvModulatorInit(hrvModulator_t* modulator, const hrvConfig_t* config)
+{
+	if(config->sdnnMs > HRV_MAX_SDNN_MS ||
+			config->lfHfRatio < HRV_MIN_LF_HF_RATIO || config->lfHfRatio > HRV_MAX_LF_HF_RATIO ||
+			config->respRate < HRV_MIN_RESP_RATE || config->respRate > HRV_MAX_RESP_RATE ||
+			config->amplitudeDepth > HRV_MAX_AMPLITUDE_DEPTH)
+	{
+		return false;
+	}
+
+	uint32_t variance = (uint32_t)config->sdnnMs * config->sdnnMs;
+	uint32_t lfVariance = (variance * config->lfHfRatio) / (100UL + config->lfHfRatio);
+	uint32_t hfVariance = variance - lfVariance;
+
+	//Q4 amplitude is sqrt(2 * variance * 16^2)
+	modulator->lfAmplitude = (int32_t)FixedPointSqrt(lfVariance * 512UL);
+	modulator->hfAmplitude = (int32_t)FixedPointSqrt(hfVariance * 512UL);
+	modulator->amplitudeDepth = ((int32_t)config->amplitudeDepth * FIXED_POINT_Q15_ONE) / 100;
+	modulator->respPhasePerMs = (uint32_t)(((uint64_t)config->respRate << 32) / 60000UL);
+	modulator->lfPhase = 0;
+	modulator->respPhase = 0;
+	modulator->gain = FIXED_POINT_Q15_ONE;
+	modulator->randomState = HRV_RANDOM_SEED;
+	return true;
+}
+
+/**
+ * @brief Starts the next beat
+ * @param rrMs nominal RR interval of the beat
+ * @return RR offset in ms to add to the nominal interval
+ */
+int32_t HrvModulatorNextBeat(hrvModulator_t* modulator, uint32_t rrMs)
+{
+	int32_t respiration = FixedPointSin(modulator->respPhase);
+
+	//Inspiration (positive half) shortens RR and lowers the beat amplitude
+	int32_t offset = modulator->lfAmplitude * FixedPointSin(modulator->lfPhase) -
+			modulator->hfAmplitude * respiration;
+	offset = (offset + (1L << 18)) >> 19;
+
+	modulator->gain = FIXED_POINT_Q15_ONE - ((modulator->amplitudeDepth * respiration) >> 15);
+
+	uint32_t elapsedMs = (uint32_t)((int32_t)rrMs + offset);
+	modulator->lfPhase += elapsedMs * FIXED_POINT_PHASE_PER_MS(HRV_LF_PERIOD_MS);
+	modulator->lfPhase += (uint32_t)(FixedPointRandomQ15(&modulator->randomState) * (1L << HRV_LF_JITTER_SHIFT));
+	modulator->respPhase += elapsedMs * modulator->respPhasePerMs;
+	modulator->respPhase += (uint32_t)(FixedPointRandomQ15(&modulator->randomState) * (1L << HRV_RESP_JITTER_SHIFT));
+	return offset;
+}
+
+/**
+ * @brief Amplitude gain of the current beat in Q15
+ */
+int32_t HrvModulatorGetGain(const hrvModulator_t* modulator)
+{
+	return modulator->gain;
+}
@@ -0,0 +1,53 @@
+/*
+ * HrvModulator.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Beat to beat heart rate variability and respiratory modulation. RR
+ *  variability is the sum of a Mayer wave band around 0.1 Hz (LF) and
+ *  respiratory sinus arrhythmia at the breathing rate (HF). Each band is a
+ *  table sine whose phase is jittered every beat by an LCG, which spreads
+ *  its line into a narrow band like the ECGSYN RR spectrum. Respiration also
+ *  scales the amplitude of each beat. Runs once per beat, integer only.
+ */
+
+#ifndef UTILITIES_HRVMODULATOR_HRVMODULATOR_H_
+#define UTILITIES_HRVMODULATOR_HRVMODULATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HRV_MAX_SDNN_MS				250
+#define HRV_MIN_LF_HF_RATIO			10		//0.1
+#define HRV_MAX_LF_HF_RATIO			1000	//10.0
+#define HRV_MIN_RESP_RATE			6
+#define HRV_MAX_RESP_RATE			40
+#define HRV_MAX_AMPLITUDE_DEPTH		50
+
+#define HRV_DEFAULT_LF_HF_RATIO		150
+#define HRV_DEFAULT_RESP_RATE		15
+
+typedef struct{
+	uint16_t sdnnMs;			//target standard deviation of RR
+	uint16_t lfHfRatio;			//LF/HF power ratio in hundredths
+	uint16_t respRate;			//breaths per minute
+	uint8_t amplitudeDepth;		//respiratory amplitude modulation in percent
+}hrvConfig_t;
+
+typedef struct{
+	uint32_t lfPhase;
+	uint32_t respPhase;
+	uint32_t respPhasePerMs;
+	int32_t lfAmplitude;		//ms in Q4
+	int32_t hfAmplitude;		//ms in Q4
+	int32_t amplitudeDepth;		//Q15
+	int32_t gain;				//Q15, current beat
+	uint32_t randomState;
+}hrvModulator_t;
+
+bool HrvModulatorInit(hrvModulator_t* modulator, const hrvConfig_t* config);
+int32_t HrvModulatorNextBeat(hrvModulator_t* modulator, uint32_t rrMs);
+int32_t HrvModulatorGetGain(const hrvModulator_t* modulator);
+
+#endif /* UTILITIES_HRVMODULATOR_HRVMODULATOR_H_ */
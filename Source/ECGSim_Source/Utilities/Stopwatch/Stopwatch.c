@@ -68,6 +68,19 @@ void startStopwatch(stopwatch_t* swInstance)
 	swInstance->currentValue = __HAL_TIM_GET_COUNTER(swInstance->timerInstance);
 }
 
+/**
+ * @brief Starts a new lap even if the previous one was never closed
+ * @return true when an open lap was dropped
+ */
+bool restartStopwatch(stopwatch_t* swInstance)
+{
+	bool dropped = swInstance->state;
+
+	swInstance->state = true;
+	swInstance->currentValue = __HAL_TIM_GET_COUNTER(swInstance->timerInstance);
+	return dropped;
+}
+
 
 bool getLapTime(stopwatch_t* swInstance, uint8_t lapNumber, float* lapTime)
 {
@@ -33,6 +33,7 @@ extern stopwatch_t triggerSw;
 bool createStopwatch(stopwatch_t* swInstance, TIM_HandleTypeDef* timer, uint32_t frequency, uint8_t lapCount);
 bool lapStopwatch(stopwatch_t* swInstance);
 void startStopwatch(stopwatch_t* swInstance);
+bool restartStopwatch(stopwatch_t* swInstance);
 bool getLapTime(stopwatch_t* swInstance, uint8_t lapNumber, float* lapTime);
 void getAverageLapTime(stopwatch_t* swInstance, uint32_t* averageLapTime);
 
@@ -0,0 +1,343 @@
+/*
+ * WaveformCodec.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+#include "WaveformCodec.h"
+#include <string.h>
+
+/* Delta codec: nibbles 0..13 are a zigzag coded delta of -7..+6,
+ * 14 escapes to a signed 8 bit delta and 15 to an absolute 12 bit sample */
+#define DELTA_SHORT_MAX_CODE		13
+#define DELTA_BYTE_ESCAPE			14
+#define DELTA_ABSOLUTE_ESCAPE		15
+
+#define ADPCM_HEADER_NIBBLES		6
+#define ADPCM_STEP_INDEX_MAX		88
+
+/* 12 bit samples are centred and shifted up to use the full IMA step table */
+#define ADPCM_SAMPLE_SHIFT			4
+#define ADPCM_SAMPLE_OFFSET			2048
+
+static const int16_t g_adpcmStepTable[ADPCM_STEP_INDEX_MAX + 1] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t g_adpcmIndexTable[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const char* const g_codecNames[WAVEFORM_CODEC_COUNT] = {
+	"raw", "pack12", "delta", "adpcm"
+};
+
+static inline uint8_t readNibble(const uint8_t* data, uint32_t position)
+{
+	return (data[position >> 1] >> ((position & 1) << 2)) & 0x0F;
+}
+
+static inline void writeNibble(uint8_t* data, uint32_t position, uint8_t nibble)
+{
+	uint8_t shift = (position & 1) << 2;
+	data[position >> 1] = (data[position >> 1] & ~(0x0F << shift)) | ((nibble & 0x0F) << shift);
+}
+
+static bool putNibbles(waveformEncoder_t* encoder, uint32_t value, uint8_t count)
+{
+	if(encoder->nibbleCount + count > encoder->capacityNibbles)
+	{
+		return false;
+	}
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		writeNibble(encoder->data, encoder->nibbleCount++, (uint8_t)(value >> (i << 2)));
+	}
+	return true;
+}
+
+static uint32_t getNibbles(waveformDecoder_t* decoder, uint8_t count)
+{
+	uint32_t value = 0;
+	for(uint8_t i = 0; i < count; i++)
+	{
+		value |= (uint32_t)readNibble(decoder->data, decoder->nibblePosition++) << (i << 2);
+	}
+	return value;
+}
+
+static inline int32_t clampSample(int32_t sample)
+{
+	if(sample < 0) return 0;
+	if(sample > WAVEFORM_CODEC_SAMPLE_MAX) return WAVEFORM_CODEC_SAMPLE_MAX;
+	return sample;
+}
+
+/**
+ * @brief One IMA-ADPCM decode step, shared by the encoder so both sides
+ * track the same predictor
+ */
+static void adpcmStep(int32_t* predictor, int8_t* stepIndex, uint8_t code)
+{
+	int32_t step = g_adpcmStepTable[*stepIndex];
+	int32_t diff = step >> 3;
+
+	if(code & 4) diff += step;
+	if(code & 2) diff += step >> 1;
+	if(code & 1) diff += step >> 2;
+
+	*predictor += (code & 8) ? -diff : diff;
+	if(*predictor > INT16_MAX) *predictor = INT16_MAX;
+	if(*predictor < INT16_MIN) *predictor = INT16_MIN;
+
+	*stepIndex += g_adpcmIndexTable[code];
+	if(*stepIndex < 0) *stepIndex = 0;
+	if(*stepIndex > ADPCM_STEP_INDEX_MAX) *stepIndex = ADPCM_STEP_INDEX_MAX;
+}
+
+static uint8_t adpcmEncode(int32_t predictor, int8_t stepIndex, int32_t target)
+{
+	int32_t step = g_adpcmStepTable[stepIndex];
+	int32_t diff = target - predictor;
+	uint8_t code = 0;
+
+	if(diff < 0)
+	{
+		code = 8;
+		diff = -diff;
+	}
+	if(diff >= step)
+	{
+		code |= 4;
+		diff -= step;
+	}
+	step >>= 1;
+	if(diff >= step)
+	{
+		code |= 2;
+		diff -= step;
+	}
+	step >>= 1;
+	if(diff >= step)
+	{
+		code |= 1;
+	}
+	return code;
+}
+
+bool WaveformEncoderInit(waveformEncoder_t* encoder, waveformCodec_t codec, uint8_t* buffer, uint32_t capacity)
+{
+	if(encoder == NULL || buffer == NULL || codec >= WAVEFORM_CODEC_COUNT)
+	{
+		return false;
+	}
+
+	encoder->codec = codec;
+	encoder->data = buffer;
+	encoder->capacityNibbles = capacity * 2;
+	encoder->nibbleCount = 0;
+	encoder->sampleCount = 0;
+	encoder->previous = 0;
+	encoder->stepIndex = 0;
+	return true;
+}
+
+/**
+ * @brief Appends one sample to the stream
+ * @return false when the sample does not fit in the buffer
+ */
+bool WaveformEncoderPut(waveformEncoder_t* encoder, uint16_t sample)
+{
+	bool status = false;
+	int32_t value = clampSample(sample);
+
+	switch(encoder->codec)
+	{
+	case WAVEFORM_CODEC_RAW16:
+		status = putNibbles(encoder, (uint32_t)value, 4);
+		break;
+
+	case WAVEFORM_CODEC_PACK12:
+		status = putNibbles(encoder, (uint32_t)value, 3);
+		break;
+
+	case WAVEFORM_CODEC_DELTA:
+	{
+		int32_t delta = value - encoder->previous;
+
+		if(encoder->sampleCount != 0 && delta >= -7 && delta <= 6)
+		{
+			status = putNibbles(encoder, (delta < 0) ? (uint32_t)(-2 * delta - 1) : (uint32_t)(2 * delta), 1);
+		}
+		else if(encoder->sampleCount != 0 && delta >= INT8_MIN && delta <= INT8_MAX)
+		{
+			status = (encoder->nibbleCount + 3 <= encoder->capacityNibbles) &&
+					putNibbles(encoder, DELTA_BYTE_ESCAPE, 1) &&
+					putNibbles(encoder, (uint8_t)(int8_t)delta, 2);
+		}
+		else
+		{
+			status = (encoder->nibbleCount + 4 <= encoder->capacityNibbles) &&
+					putNibbles(encoder, DELTA_ABSOLUTE_ESCAPE, 1) &&
+					putNibbles(encoder, (uint32_t)value, 3);
+		}
+
+		if(status)
+		{
+			encoder->previous = value;
+		}
+		break;
+	}
+
+	case WAVEFORM_CODEC_ADPCM:
+	{
+		int32_t target = (value - ADPCM_SAMPLE_OFFSET) << ADPCM_SAMPLE_SHIFT;
+
+		if(encoder->sampleCount == 0)
+		{
+			//Header: initial predictor (16 bit) and step index (8 bit)
+			encoder->previous = target;
+			encoder->stepIndex = 0;
+			if(!putNibbles(encoder, (uint16_t)target, 4) || !putNibbles(encoder, 0, 2))
+			{
+				return false;
+			}
+		}
+
+		uint8_t code = adpcmEncode(encoder->previous, encoder->stepIndex, target);
+		status = putNibbles(encoder, code, 1);
+		if(status)
+		{
+			adpcmStep(&encoder->previous, &encoder->stepIndex, code);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	if(status)
+	{
+		encoder->sampleCount++;
+	}
+	return status;
+}
+
+/**
+ * @brief Number of bytes used by the stream so far
+ */
+uint32_t WaveformEncoderGetLength(waveformEncoder_t* encoder)
+{
+	return (encoder->nibbleCount + 1) >> 1;
+}
+
+/**
+ * @brief Rewinds the decoder to the first sample of a stream
+ */
+void WaveformDecoderReset(waveformDecoder_t* decoder, waveformCodec_t codec, const uint8_t* data)
+{
+	decoder->codec = codec;
+	decoder->data = data;
+	decoder->nibblePosition = 0;
+	decoder->previous = 0;
+	decoder->stepIndex = 0;
+
+	if(codec == WAVEFORM_CODEC_ADPCM)
+	{
+		decoder->previous = (int16_t)getNibbles(decoder, 4);
+		decoder->stepIndex = (int8_t)getNibbles(decoder, 2);
+	}
+}
+
+/**
+ * @brief Decodes the next sample, reads at most 4 nibbles
+ */
+uint16_t WaveformDecoderNext(waveformDecoder_t* decoder)
+{
+	switch(decoder->codec)
+	{
+	case WAVEFORM_CODEC_RAW16:
+		return (uint16_t)getNibbles(decoder, 4);
+
+	case WAVEFORM_CODEC_PACK12:
+		return (uint16_t)getNibbles(decoder, 3);
+
+	case WAVEFORM_CODEC_DELTA:
+	{
+		uint8_t code = (uint8_t)getNibbles(decoder, 1);
+
+		if(code <= DELTA_SHORT_MAX_CODE)
+		{
+			decoder->previous += (code & 1) ? -(int32_t)((code + 1) >> 1) : (int32_t)(code >> 1);
+		}
+		else if(code == DELTA_BYTE_ESCAPE)
+		{
+			decoder->previous += (int8_t)getNibbles(decoder, 2);
+		}
+		else
+		{
+			decoder->previous = (int32_t)getNibbles(decoder, 3);
+		}
+		return (uint16_t)decoder->previous;
+	}
+
+	case WAVEFORM_CODEC_ADPCM:
+		adpcmStep(&decoder->previous, &decoder->stepIndex, (uint8_t)getNibbles(decoder, 1));
+		return (uint16_t)clampSample((decoder->previous >> ADPCM_SAMPLE_SHIFT) + ADPCM_SAMPLE_OFFSET);
+
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Upper bound on the samples a buffer of the given size can hold.
+ * The delta codec is variable rate, so its bound assumes the shortest code.
+ */
+uint32_t WaveformCodecMaxSamples(waveformCodec_t codec, uint32_t capacity)
+{
+	uint32_t nibbles = capacity * 2;
+
+	switch(codec)
+	{
+	case WAVEFORM_CODEC_RAW16:	return nibbles / 4;
+	case WAVEFORM_CODEC_PACK12:	return nibbles / 3;
+	case WAVEFORM_CODEC_DELTA:	return (nibbles > 3) ? nibbles - 3 : 0;
+	case WAVEFORM_CODEC_ADPCM:	return (nibbles > ADPCM_HEADER_NIBBLES) ? nibbles - ADPCM_HEADER_NIBBLES : 0;
+	default:					return 0;
+	}
+}
+
+bool WaveformCodecFromName(const char* name, waveformCodec_t* codec)
+{
+	for(int i = 0; i < WAVEFORM_CODEC_COUNT; i++)
+	{
+		if(!strcmp(name, g_codecNames[i]))
+		{
+			*codec = (waveformCodec_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* WaveformCodecGetName(waveformCodec_t codec)
+{
+	if(codec >= WAVEFORM_CODEC_COUNT)
+	{
+		return "unknown";
+	}
+	return g_codecNames[codec];
+}
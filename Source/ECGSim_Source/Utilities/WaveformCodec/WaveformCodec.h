@@ -0,0 +1,58 @@
+/*
+ * WaveformCodec.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ *
+ *  Sample codecs for the in-RAM waveform store. Every codec is a stream of
+ *  4-bit nibbles (LSB nibble of a byte first), so the encoder runs one
+ *  sample at a time during upload and the decoder produces one sample per
+ *  call in constant time from the sample clock interrupt.
+ */
+
+#ifndef UTILITIES_WAVEFORMCODEC_WAVEFORMCODEC_H_
+#define UTILITIES_WAVEFORMCODEC_WAVEFORMCODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WAVEFORM_CODEC_SAMPLE_MAX		4095
+
+typedef enum{
+	WAVEFORM_CODEC_RAW16,		//4 nibbles per sample, plain little endian uint16
+	WAVEFORM_CODEC_PACK12,		//3 nibbles per sample, 2 samples per 3 bytes
+	WAVEFORM_CODEC_DELTA,		//first order delta, 1, 3 or 4 nibbles per sample
+	WAVEFORM_CODEC_ADPCM,		//IMA-ADPCM, 1 nibble per sample after a 6 nibble header
+	WAVEFORM_CODEC_COUNT
+}waveformCodec_t;
+
+typedef struct{
+	waveformCodec_t codec;
+	uint8_t* data;
+	uint32_t capacityNibbles;
+	uint32_t nibbleCount;
+	uint32_t sampleCount;
+	int32_t previous;
+	int8_t stepIndex;
+}waveformEncoder_t;
+
+typedef struct{
+	waveformCodec_t codec;
+	const uint8_t* data;
+	uint32_t nibblePosition;
+	int32_t previous;
+	int8_t stepIndex;
+}waveformDecoder_t;
+
+bool WaveformEncoderInit(waveformEncoder_t* encoder, waveformCodec_t codec, uint8_t* buffer, uint32_t capacity);
+bool WaveformEncoderPut(waveformEncoder_t* encoder, uint16_t sample);
+uint32_t WaveformEncoderGetLength(waveformEncoder_t* encoder);
+
+void WaveformDecoderReset(waveformDecoder_t* decoder, waveformCodec_t codec, const uint8_t* data);
+uint16_t WaveformDecoderNext(waveformDecoder_t* decoder);
+
+uint32_t WaveformCodecMaxSamples(waveformCodec_t codec, uint32_t capacity);
+bool WaveformCodecFromName(const char* name, waveformCodec_t* codec);
+const char* WaveformCodecGetName(waveformCodec_t codec);
+
+#endif /* UTILITIES_WAVEFORMCODEC_WAVEFORMCODEC_H_ */
@@ -46,16 +46,6 @@ static const float bi[5] = {
     0.40f
 };
 
-/* ========================= RNG (optional noise) ============ */
-
-static uint32_t rng_state = 1;
-
-static float rand_uniform(void)
-{
-    rng_state = 1664525UL * rng_state + 1013904223UL;
-    return ((rng_state >> 8) & 0xFFFFFF) / 16777216.0f;
-}
-
 /* ========================= ECG DERIVATIVE ================= */
 
 static void ecg_derivative(
@@ -154,14 +144,7 @@ int ecg_generate_beats(
     for (int i = 0; i < total_samples; i++) {
         rk4_step(x, h, w);
 
-        float z = x[2];
-
-        /* optional noise */
-        if (cfg->noise > 0.0f) {
-            z += cfg->noise * (2.0f*rand_uniform() - 1.0f);
-        }
-
-        ecg_out[i] = z;
+        ecg_out[i] = x[2];
 
         /* R-peak detection (theta crossing 0) */
         float theta = atan2f(x[1], x[0]);
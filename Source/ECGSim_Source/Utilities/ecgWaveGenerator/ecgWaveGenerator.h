@@ -11,7 +11,6 @@
 typedef struct {
     float fs;      /* Sampling rate (Hz) */
     float hr;      /* Heart rate (bpm) */
-    float noise;   /* Uniform noise amplitude (mV), 0 to disable */
 } ecg_config_t;
 
 int ecg_generate_beats(
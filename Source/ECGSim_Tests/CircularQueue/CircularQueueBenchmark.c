@@ -0,0 +1,158 @@
+/*
+ * CircularQueueBenchmark.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/*
+ * Host throughput of CircularQueue through a 1024 byte queue, the size of the
+ * debug UART receive ring: byte, bulk and span calls in one thread, then the
+ * same bulk transfer between a producer and a consumer thread.
+ * Usage: CircularQueueBenchmark [megabytes]
+ */
+
+#include "CircularQueue/CircularQueue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_QUEUE_SIZE		1024
+#define BENCH_CHUNK_SIZE		64
+#define BENCH_DEFAULT_MEGABYTES	64
+
+uint8_t g_buffer[BENCH_QUEUE_SIZE];
+CircularQueue_t g_queue;
+uint64_t g_length;
+volatile uint8_t g_sink;
+
+static double seconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void report(const char* name, uint64_t length, double start)
+{
+	printf("%-24s %8.1f MB/s\n", name, length / (seconds() - start) / 1e6);
+}
+
+static void benchBytes(uint64_t length)
+{
+	uint8_t data = 0;
+	double start = seconds();
+
+	for(uint64_t i = 0; i < length; i += BENCH_CHUNK_SIZE)
+	{
+		for(uint32_t j = 0; j < BENCH_CHUNK_SIZE; j++)
+		{
+			CircularQueueWriteByte(&g_queue, (uint8_t)j);
+		}
+		for(uint32_t j = 0; j < BENCH_CHUNK_SIZE; j++)
+		{
+			CircularQueueReadByte(&g_queue, &data);
+			g_sink = data;
+		}
+	}
+	report("byte", length, start);
+}
+
+static void benchBulk(uint64_t length)
+{
+	uint8_t chunk[BENCH_CHUNK_SIZE] = {0};
+	double start = seconds();
+
+	for(uint64_t i = 0; i < length; i += BENCH_CHUNK_SIZE)
+	{
+		CircularQueueWriteBytes(&g_queue, chunk, sizeof(chunk));
+		CircularQueueReadBytes(&g_queue, chunk, sizeof(chunk));
+	}
+	g_sink = chunk[0];
+	report("bulk 64", length, start);
+}
+
+static void benchSpans(uint64_t length)
+{
+	double start = seconds();
+	uint64_t moved = 0;
+	uint8_t* span;
+	uint32_t size;
+
+	while(moved < length)
+	{
+		size = CircularQueueReserveContiguous(&g_queue, &span);
+		memset(span, (uint8_t)moved, size);
+		CircularQueueCommitWrite(&g_queue, size);
+		size = CircularQueuePeekContiguous(&g_queue, &span);
+		g_sink = span[size - 1];
+		CircularQueueCommitRead(&g_queue, size);
+		moved += size;
+	}
+	report("span", length, start);
+}
+
+static void* producerThread(void* argument)
+{
+	uint8_t chunk[BENCH_CHUNK_SIZE] = {0};
+	uint64_t moved = 0;
+	uint32_t size;
+
+	(void)argument;
+	while(moved < g_length)
+	{
+		size = CircularQueueWriteBytes(&g_queue, chunk, sizeof(chunk));
+		moved += size;
+		if(size == 0)
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void benchThreads(uint64_t length)
+{
+	uint8_t chunk[BENCH_CHUNK_SIZE];
+	pthread_t producer;
+	uint64_t moved = 0;
+	uint32_t size;
+	double start = seconds();
+
+	g_length = length;
+	if(pthread_create(&producer, NULL, producerThread, NULL) != 0)
+	{
+		printf("pthread_create failed\n");
+		exit(1);
+	}
+	while(moved < length)
+	{
+		size = CircularQueueReadBytes(&g_queue, chunk, sizeof(chunk));
+		moved += size;
+		if(size == 0)
+		{
+			sched_yield();
+		}
+	}
+	pthread_join(producer, NULL);
+	g_sink = chunk[0];
+	report("bulk 64, two threads", length, start);
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t megabytes = (argc > 1) ? strtoull(argv[1], NULL, 10) : BENCH_DEFAULT_MEGABYTES;
+	uint64_t length = megabytes << 20;
+
+	CircularQueueInit(&g_queue, g_buffer, sizeof(g_buffer));
+	benchBytes(length);
+	benchBulk(length);
+	benchSpans(length);
+	benchThreads(length);
+	return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * CircularQueueTest.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/*
+ * Host test of CircularQueue: the single threaded API cases, then a producer
+ * and a consumer thread mixing every read and write call. The indices start
+ * just below 2^32 so the free running counters wrap during the run.
+ * Usage: CircularQueueTest [megabytes]
+ */
+
+#include "CircularQueue/CircularQueue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_QUEUE_SIZE			256
+#define TEST_INDEX_START		0xFFFFF000UL
+#define TEST_DEFAULT_MEGABYTES	32
+
+#define CHECK(condition)	do{ if(!(condition)) { \
+	printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); exit(1); } }while(0)
+
+uint8_t g_buffer[TEST_QUEUE_SIZE];
+CircularQueue_t g_queue;
+uint64_t g_streamLength;
+
+/**
+ * @brief Byte number index of the stream, not periodic in the queue size so a
+ * byte out of order or read twice shows up
+ */
+static uint8_t streamByte(uint64_t index)
+{
+	return (uint8_t)((index * 2654435761ULL) >> 24);
+}
+
+/**
+ * @brief Empty queue with both indices at start
+ */
+static void initQueue(uint32_t start)
+{
+	CHECK(CircularQueueInit(&g_queue, g_buffer, sizeof(g_buffer)));
+	g_queue.headIndex = start;
+	g_queue.tailIndex = start;
+}
+
+static void testInit()
+{
+	CircularQueue_t queue;
+
+	CHECK(!CircularQueueInit(&queue, g_buffer, 0));
+	CHECK(!CircularQueueInit(&queue, g_buffer, 200));
+	CHECK(!CircularQueueInit(&queue, NULL, 256));
+	CHECK(!CircularQueueInit(NULL, g_buffer, 256));
+	CHECK(CircularQueueInit(&queue, g_buffer, 1));
+	CHECK(CircularQueueInit(&queue, g_buffer, 256));
+	CHECK(CircularQueueGetRemainingData(&queue) == 0);
+	CHECK(CircularQueueGetRemainingSpace(&queue) == 256);
+}
+
+/**
+ * @brief Fills and drains byte by byte across the end of the buffer and the
+ * 2^32 index wrap, space and data always add up to the size
+ */
+static void testBytes()
+{
+	uint8_t data;
+
+	initQueue(0xFFFFFFFFUL - TEST_QUEUE_SIZE / 2);
+	for(uint32_t round = 0; round < 4; round++)
+	{
+		for(uint32_t i = 0; i < TEST_QUEUE_SIZE; i++)
+		{
+			CHECK(CircularQueueGetRemainingData(&g_queue) + CircularQueueGetRemainingSpace(&g_queue) == TEST_QUEUE_SIZE);
+			CHECK(CircularQueueWriteByte(&g_queue, streamByte(i + round)));
+		}
+		CHECK(!CircularQueueWriteByte(&g_queue, 0));
+		CHECK(CircularQueueGetRemainingSpace(&g_queue) == 0);
+
+		for(uint32_t i = 0; i < TEST_QUEUE_SIZE; i++)
+		{
+			CHECK(CircularQueueReadByte(&g_queue, &data));
+			CHECK(data == streamByte(i + round));
+		}
+		CHECK(!CircularQueueReadByte(&g_queue, &data));
+		CHECK(CircularQueueGetRemainingSpace(&g_queue) == TEST_QUEUE_SIZE);
+	}
+}
+
+/**
+ * @brief Bulk calls clip to the space and data there is and split at the
+ * end of the buffer
+ */
+static void testBulk()
+{
+	uint8_t in[TEST_QUEUE_SIZE + 10];
+	uint8_t out[TEST_QUEUE_SIZE + 10];
+
+	for(uint32_t i = 0; i < sizeof(in); i++)
+	{
+		in[i] = streamByte(i);
+	}
+
+	initQueue(TEST_INDEX_START + 200);
+	CHECK(CircularQueueWriteBytes(&g_queue, in, 100) == 100);
+	CHECK(CircularQueueWriteBytes(&g_queue, &in[100], sizeof(in) - 100) == TEST_QUEUE_SIZE - 100);
+	CHECK(CircularQueueWriteBytes(&g_queue, in, 1) == 0);
+	CHECK(CircularQueueReadBytes(&g_queue, out, sizeof(out)) == TEST_QUEUE_SIZE);
+	CHECK(memcmp(in, out, TEST_QUEUE_SIZE) == 0);
+	CHECK(CircularQueueReadBytes(&g_queue, out, sizeof(out)) == 0);
+}
+
+/**
+ * @brief Zero copy spans stop at the end of the buffer, commits past what
+ * is there are refused
+ */
+static void testSpans()
+{
+	uint8_t* span;
+
+	initQueue(TEST_INDEX_START + 250);
+	CHECK(CircularQueueReserveContiguous(&g_queue, &span) == 6);
+	CHECK(span == &g_buffer[250]);
+	memset(span, 0xA5, 6);
+	CHECK(CircularQueueCommitWrite(&g_queue, 6));
+	CHECK(CircularQueueReserveContiguous(&g_queue, &span) == TEST_QUEUE_SIZE - 6);
+	CHECK(span == &g_buffer[0]);
+	CHECK(CircularQueueCommitWrite(&g_queue, 10));
+
+	CHECK(CircularQueuePeekContiguous(&g_queue, &span) == 6);
+	CHECK(span == &g_buffer[250] && span[5] == 0xA5);
+	CHECK(!CircularQueueCommitRead(&g_queue, 17));
+	CHECK(CircularQueueCommitRead(&g_queue, 6));
+	CHECK(CircularQueuePeekContiguous(&g_queue, &span) == 10);
+	CHECK(span == &g_buffer[0]);
+	CHECK(CircularQueueFlush(&g_queue));
+	CHECK(CircularQueuePeekContiguous(&g_queue, &span) == 0);
+}
+
+/**
+ * @brief A producer that cannot wait laps the reader, the reader skips to
+ * the newest bytes
+ */
+static void testLap()
+{
+	uint8_t out[TEST_QUEUE_SIZE];
+
+	initQueue(TEST_INDEX_START);
+	for(uint32_t i = 0; i < TEST_QUEUE_SIZE + 44; i++)
+	{
+		g_buffer[(TEST_INDEX_START + i) & (TEST_QUEUE_SIZE - 1)] = streamByte(i);
+	}
+	CHECK(!CircularQueueCommitWrite(&g_queue, TEST_QUEUE_SIZE + 44));
+	CHECK(CircularQueueGetRemainingData(&g_queue) == TEST_QUEUE_SIZE);
+	CHECK(CircularQueueGetRemainingSpace(&g_queue) == 0);
+	CHECK(CircularQueueReadBytes(&g_queue, out, sizeof(out)) == TEST_QUEUE_SIZE);
+	for(uint32_t i = 0; i < TEST_QUEUE_SIZE; i++)
+	{
+		CHECK(out[i] == streamByte(i + 44));
+	}
+}
+
+static void* producerThread(void* argument)
+{
+	uint8_t chunk[97];
+	uint64_t index = 0;
+	uint32_t call = 0;
+
+	(void)argument;
+	while(index < g_streamLength)
+	{
+		uint64_t left = g_streamLength - index;
+		uint32_t written = 0;
+		uint8_t* span;
+
+		switch(call++ % 3)
+		{
+		case 0:
+			written = CircularQueueReserveContiguous(&g_queue, &span);
+			written = (written < left) ? written : (uint32_t)left;
+			for(uint32_t i = 0; i < written; i++)
+			{
+				span[i] = streamByte(index + i);
+			}
+			if(written != 0)
+			{
+				CHECK(CircularQueueCommitWrite(&g_queue, written));
+			}
+			break;
+		case 1:
+			written = 1 + call % sizeof(chunk);
+			written = (written < left) ? written : (uint32_t)left;
+			for(uint32_t i = 0; i < written; i++)
+			{
+				chunk[i] = streamByte(index + i);
+			}
+			written = CircularQueueWriteBytes(&g_queue, chunk, written);
+			break;
+		default:
+			written = CircularQueueWriteByte(&g_queue, streamByte(index)) ? 1 : 0;
+			break;
+		}
+
+		index += written;
+		if(written == 0)
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief The consumer side of the two thread run, checks every byte
+ */
+static void testConcurrent(uint64_t length)
+{
+	pthread_t producer;
+	uint8_t chunk[61];
+	uint64_t index = 0;
+	uint32_t call = 0;
+
+	initQueue(TEST_INDEX_START);
+	g_streamLength = length;
+	CHECK(pthread_create(&producer, NULL, producerThread, NULL) == 0);
+
+	while(index < length)
+	{
+		uint32_t read = 0;
+		uint8_t* span;
+
+		switch(call++ % 3)
+		{
+		case 0:
+			read = CircularQueuePeekContiguous(&g_queue, &span);
+			for(uint32_t i = 0; i < read; i++)
+			{
+				CHECK(span[i] == streamByte(index + i));
+			}
+			if(read != 0)
+			{
+				CHECK(CircularQueueCommitRead(&g_queue, read));
+			}
+			break;
+		case 1:
+			read = CircularQueueReadBytes(&g_queue, chunk, 1 + call % sizeof(chunk));
+			for(uint32_t i = 0; i < read; i++)
+			{
+				CHECK(chunk[i] == streamByte(index + i));
+			}
+			break;
+		default:
+			if(CircularQueueReadByte(&g_queue, chunk))
+			{
+				CHECK(chunk[0] == streamByte(index));
+				read = 1;
+			}
+			break;
+		}
+
+		CHECK(CircularQueueGetRemainingData(&g_queue) <= TEST_QUEUE_SIZE);
+		index += read;
+		if(read == 0)
+		{
+			sched_yield();
+		}
+	}
+
+	CHECK(pthread_join(producer, NULL) == 0);
+	CHECK(CircularQueueGetRemainingData(&g_queue) == 0);
+	CHECK(g_queue.headIndex == (uint32_t)(TEST_INDEX_START + length));
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t megabytes = (argc > 1) ? strtoull(argv[1], NULL, 10) : TEST_DEFAULT_MEGABYTES;
+
+	testInit();
+	testBytes();
+	testBulk();
+	testSpans();
+	testLap();
+	testConcurrent(megabytes << 20);
+
+	printf("CircularQueue: all tests passed, %llu MB through two threads\n", (unsigned long long)megabytes);
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * ECGGeneratorApplicationTest.c
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/*
+ * Host test of the upload paths of ECGGeneratorApplication, driven the way
+ * the CLI drives them. The sample clock is the test calling exportEcg, the
+ * flash library and stopwatch are stand ins below.
+ */
+
+#include "ECGGeneratorApplication.h"
+#include "Stopwatch.h"
+#include "SampleClock/SampleClock.h"
+#include "WaveformLibrary/WaveformLibrary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_SAMPLES			512
+#define TEST_BLOCK_SAMPLES		64
+#define TEST_PLAY_LIMIT			(4 * TEST_SAMPLES)
+
+#define CHECK(condition)	do{ if(!(condition)) { \
+	printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); exit(1); } }while(0)
+
+extern volatile bool g_bankSwapPending;
+
+stopwatch_t triggerSw;
+
+void startStopwatch(stopwatch_t* swInstance)
+{
+	(void)swInstance;
+}
+
+bool restartStopwatch(stopwatch_t* swInstance)
+{
+	(void)swInstance;
+	return false;
+}
+
+uint32_t SampleClockGetRate(void)
+{
+	return 1000;
+}
+
+bool SampleClockSetRate(uint32_t rateHz)
+{
+	return rateHz >= SAMPLE_CLOCK_MIN_RATE_HZ && rateHz <= SAMPLE_CLOCK_MAX_RATE_HZ;
+}
+
+uint8_t WaveformLibraryGetSelected(void)
+{
+	return WAVEFORM_LIBRARY_NO_SELECTION;
+}
+
+const waveformLibraryHeader_t* WaveformLibraryGetEntry(uint8_t slot)
+{
+	(void)slot;
+	return NULL;
+}
+
+const uint8_t* WaveformLibraryGetPayload(uint8_t slot)
+{
+	(void)slot;
+	return NULL;
+}
+
+bool WaveformLibraryBeginSave(uint8_t slot)
+{
+	(void)slot;
+	return false;
+}
+
+bool WaveformLibraryWrite(const uint8_t* data, uint32_t length)
+{
+	(void)data;
+	(void)length;
+	return false;
+}
+
+bool WaveformLibraryEndSave(const waveformLibraryHeader_t* header)
+{
+	(void)header;
+	return false;
+}
+
+static uint16_t waveformA(uint32_t index)
+{
+	return (uint16_t)(1500 + index % 100);
+}
+
+static uint16_t waveformB(uint32_t index)
+{
+	return (uint16_t)(1800 + (index * 7) % 300);
+}
+
+/**
+ * @brief B with its third block edited, what a delta upload sends
+ */
+static uint16_t waveformC(uint32_t index)
+{
+	if(index / TEST_BLOCK_SAMPLES == 2)
+	{
+		return (uint16_t)(3000 + index);
+	}
+	return waveformB(index);
+}
+
+static void upload(uint16_t (*waveform)(uint32_t))
+{
+	CHECK(initiateEcgDownload(TEST_SAMPLES, WAVEFORM_CODEC_RAW16));
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		CHECK(downloadEcgData((uint16_t)i, waveform(i)));
+	}
+}
+
+/**
+ * @brief Runs the sample clock until the waiting upload takes over at its
+ * loop boundary
+ */
+static void playUntilSwapped()
+{
+	uint16_t frame[ECG_CHANNEL_COUNT];
+
+	for(int i = 0; i < TEST_PLAY_LIMIT && g_bankSwapPending; i++)
+	{
+		exportEcg(frame);
+	}
+	CHECK(!g_bankSwapPending);
+}
+
+static void checkLatest(uint16_t (*waveform)(uint32_t))
+{
+	uint16_t samples[TEST_SAMPLES];
+
+	CHECK(getEcgSampleCount() == TEST_SAMPLES);
+	CHECK(readEcgSamples(0, samples, TEST_SAMPLES));
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		CHECK(samples[i] == waveform(i));
+	}
+}
+
+/**
+ * @brief Upload, a second upload before the first takes over, then a delta
+ * upload. The delta blocks come from the waveform GetBlockCrcs reported.
+ */
+static void testDeltaAfterPendingUpload()
+{
+	upload(waveformA);
+	playUntilSwapped();
+
+	upload(waveformB);
+	CHECK(g_bankSwapPending);
+	checkLatest(waveformB);
+
+	//B waits in the shadow bank, a new upload would overwrite it
+	CHECK(!initiateEcgDownload(TEST_SAMPLES, WAVEFORM_CODEC_RAW16));
+	CHECK(!keepEcgData(TEST_BLOCK_SAMPLES));
+	checkLatest(waveformB);
+
+	playUntilSwapped();
+	CHECK(initiateEcgDownload(TEST_SAMPLES, WAVEFORM_CODEC_RAW16));
+	for(uint32_t block = 0; block < TEST_SAMPLES / TEST_BLOCK_SAMPLES; block++)
+	{
+		if(block != 2)
+		{
+			CHECK(keepEcgData(TEST_BLOCK_SAMPLES));
+			continue;
+		}
+		for(uint32_t i = block * TEST_BLOCK_SAMPLES; i < (block + 1) * TEST_BLOCK_SAMPLES; i++)
+		{
+			CHECK(downloadEcgData((uint16_t)i, waveformC(i)));
+		}
+	}
+	checkLatest(waveformC);
+	playUntilSwapped();
+	checkLatest(waveformC);
+}
+
+/**
+ * @brief Readbacks during an upload see the bank being written, never the
+ * waveform before it, and only a finished upload can be verified
+ */
+static void testReadbackDuringUpload()
+{
+	uint16_t sample;
+
+	playUntilSwapped();
+	CHECK(initiateEcgDownload(TEST_SAMPLES, WAVEFORM_CODEC_RAW16));
+	CHECK(isEcgUploadInProgress());
+	for(uint32_t i = 0; i < TEST_SAMPLES / 2; i++)
+	{
+		CHECK(downloadEcgData((uint16_t)i, waveformA(i)));
+	}
+	CHECK(getEcgSampleCount() == 0);
+	CHECK(!readEcgSamples(0, &sample, 1));
+
+	for(uint32_t i = TEST_SAMPLES / 2; i < TEST_SAMPLES; i++)
+	{
+		CHECK(downloadEcgData((uint16_t)i, waveformA(i)));
+	}
+	CHECK(!isEcgUploadInProgress());
+	checkLatest(waveformA);
+}
+
+int main()
+{
+	ecgGeneratorAppInit();
+	CHECK(!isEcgUploadInProgress());
+	CHECK(getEcgSampleCount() == 0);
+
+	testDeltaAfterPendingUpload();
+	testReadbackDuringUpload();
+
+	printf("ECGGeneratorApplication: all tests passed\n");
+	return 0;
+}
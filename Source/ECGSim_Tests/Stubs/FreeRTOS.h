@@ -0,0 +1,13 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/* Host stand in, the tests run the application code in one thread */
+
+#ifndef STUBS_FREERTOS_H_
+#define STUBS_FREERTOS_H_
+
+#endif /* STUBS_FREERTOS_H_ */
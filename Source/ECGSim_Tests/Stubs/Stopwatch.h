@@ -0,0 +1,26 @@
+/*
+ * Stopwatch.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/* Host stand in for the timer backed stopwatch, the test provides the functions */
+
+#ifndef STUBS_STOPWATCH_H_
+#define STUBS_STOPWATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct{
+	bool state;
+	uint32_t currentValue;
+}stopwatch_t;
+
+extern stopwatch_t triggerSw;
+
+void startStopwatch(stopwatch_t* swInstance);
+bool restartStopwatch(stopwatch_t* swInstance);
+
+#endif /* STUBS_STOPWATCH_H_ */
@@ -0,0 +1,16 @@
+/*
+ * task.h
+ *
+ *  Created on: 17-Oct-2026
+ *      Author: Mohammed Bin Saleem
+ */
+
+/* Host stand in, no interrupt preempts the tests so critical sections are empty */
+
+#ifndef STUBS_TASK_H_
+#define STUBS_TASK_H_
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif /* STUBS_TASK_H_ */